@@ -0,0 +1,109 @@
+#!/bin/sh
+#
+# bench.sh - run the karmen-stress scenarios against karmen on Xvfb
+#
+# usage: bench.sh [karmen] [karmen-stress] [output]
+#
+# Writes a JSON array with one object per scenario and metric to
+# output (bench.json by default).  BENCH_N sets the size of each
+# scenario, BENCH_SCENARIOS which ones are run, BENCH_DISPLAY the
+# display number used for Xvfb.
+#
+# Afterwards the X traffic of the scenarios listed in the budgets
+# file is checked, and the run fails if one is over budget.
+#
+
+KARMEN=${1:-./karmen}
+STRESS=${2:-./karmen-stress}
+OUTPUT=${3:-bench.json}
+BUDGETS=${BENCH_BUDGETS:-$(dirname "$0")/budgets}
+N=${BENCH_N:-100}
+SCENARIOS=${BENCH_SCENARIOS:-"map icons title configure flood spam hints fight activate click drag cycle"}
+DPY=:${BENCH_DISPLAY:-77}
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+	echo "bench.sh: Xvfb not found" >&2
+	exit 1
+fi
+
+Xvfb $DPY -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+XVFB=$!
+KARMENPID=
+cleanup() {
+	[ -n "$KARMENPID" ] && kill $KARMENPID 2>/dev/null
+	kill $XVFB 2>/dev/null
+	wait 2>/dev/null
+}
+trap cleanup EXIT INT TERM
+
+# wait for the server socket
+i=0
+while [ ! -S /tmp/.X11-unix/X${DPY#:} ]; do
+	i=$((i + 1))
+	if [ $i -gt 100 ]; then
+		echo "bench.sh: Xvfb did not start" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+$KARMEN -display $DPY 2>karmen-bench.log &
+KARMENPID=$!
+sleep 1
+
+{
+	echo "["
+	printf '{"karmen": "%s", "date": "%s", "n": %d}' \
+	    "$($KARMEN -version 2>&1 | head -n 1)" "$(date -u +%FT%TZ)" $N
+	for s in $SCENARIOS; do
+		$STRESS -display $DPY -p $KARMENPID -n $N $s |
+		    while read -r line; do
+			printf ',\n%s' "$line"
+		done
+	done
+	echo
+	echo "]"
+} >"$OUTPUT"
+
+if ! kill -0 $KARMENPID 2>/dev/null; then
+	echo "bench.sh: karmen exited during the run" >&2
+	exit 1
+fi
+cat "$OUTPUT"
+
+# print "calls requests roundtrips" of a subsystem from the last dump
+xcount() {
+	kill -USR2 $KARMENPID
+	sleep 0.2
+	grep "^xcount $1 " karmen-bench.log | tail -n 1 |
+	    sed 's/.*calls=\([0-9]*\) requests=\([0-9]*\).*roundtrips=\([0-9]*\).*/\1 \2 \3/'
+}
+
+# karmen built with --disable-xcount would die of SIGUSR2
+if ! grep -q -a "xcount %s calls" "$KARMEN"; then
+	echo "bench.sh: karmen does not count X traffic, budgets not checked" >&2
+	exit 0
+fi
+
+status=0
+grep -v '^#' "$BUDGETS" | while read -r scenario subsys maxreq maxrt; do
+	[ -z "$scenario" ] && continue
+	xcount "$subsys" >/dev/null
+	$STRESS -display $DPY -n 20 $scenario >/dev/null
+	set -- $(xcount "$subsys")
+	calls=${1:-0}
+	if [ "$calls" -eq 0 ]; then
+		echo "budget $scenario $subsys: never called" >&2
+		continue
+	fi
+	req=$(( $2 / calls ))
+	rt=$(( $3 / calls ))
+	if [ -n "$BENCH_RECORD" ]; then
+		printf '%s\t%s\t%d\t%d\n' $scenario $subsys $req $rt
+	elif [ $req -gt $maxreq ] || [ $rt -gt $maxrt ]; then
+		echo "budget $scenario $subsys: $req requests, $rt round trips" \
+		    "per call, budget is $maxreq and $maxrt" >&2
+		exit 1
+	fi
+done || status=1
+exit $status
@@ -31,6 +31,7 @@
 #include "global.h"
 #include "lib.h"
 #include "menu.h"
+#include "stats.h"
 #include "window.h"
 
 static void setcolors(struct button *bp)
@@ -64,7 +65,7 @@ static void repaint(struct widget *widget)
 	xftBgPixel = getXftBgPixel(bp);
 
 	/* clear */
-	XftDrawRect(bp->xftdraw,&xftBgPixel, 0, 0, WIDGET_WIDTH(bp), WIDGET_HEIGHT(bp));
+	fillrect(bp->xftdraw, &xftBgPixel, 0, 0, WIDGET_WIDTH(bp), WIDGET_HEIGHT(bp));
 
 	/* draw */
 		int x, y;
@@ -126,13 +127,15 @@ static void buttonevent(struct widget *widget, XEvent *ep)
 		if (bp->acting)
 			bp->depressed = 1;
 		bp->hover = 1;
-		REPAINT(bp);
+		if (!overloaded)
+			REPAINT(bp);
 		break;
 	case LeaveNotify:
 		if (bp->acting)
 			bp->depressed = 0;
 		bp->hover = 0;
-		REPAINT(bp);
+		if (!overloaded)
+			REPAINT(bp);
 		break;
 	}
 }
@@ -150,11 +153,13 @@ struct button *create_button(struct window *window, int x, int y,
 	bp->pixmap = XCreatePixmap(display, WIDGET_XWINDOW(bp),
 	    WIDGET_WIDTH(bp), WIDGET_HEIGHT(bp),
 	    bp->widget.depth);
+	XRES_HOLD(XRES_PIXMAP);
 	
 	bp->xftdraw = XftDrawCreate(display, bp->pixmap, bp->widget.visual, bp->widget.colormap); 
 	gcval.graphics_exposures = False;
 	bp->gc = XCreateGC(display, WIDGET_XWINDOW(bp),
 	    GCGraphicsExposures, &gcval);
+	XRES_HOLD(XRES_GC);
 	//bp->image = NULL;
 
 	bp->window = window;
@@ -183,6 +188,8 @@ void destroy_button(struct button *bp)
 	XFreePixmap(display, bp->pixmap);
 	XftDrawDestroy(bp->xftdraw);
 	XFreeGC(display, bp->gc);
+	XRES_DROP(XRES_PIXMAP);
+	XRES_DROP(XRES_GC);
 	destroy_widget(&bp->widget);
 	FREE(bp);
 }
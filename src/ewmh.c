@@ -47,6 +47,8 @@ enum {
 	NET_SUPPORTING_WM_CHECK,
 	NET_WM_NAME,
 	NET_CLOSE_WINDOW,
+	NET_WM_ICON,
+	NET_WM_ICON_NAME,
 
 	NATOM
 };
@@ -66,6 +68,9 @@ static Atom UTF8_STRING;
 /* List of managed clients, oldest first */
 static struct winlist clientlist = { NULL, 0, 0 };
 
+/* Nonzero if _NET_CLIENT_LIST is out of date, see ewmh_commit() */
+static int clientlistdirty = 0;
+
 /* Geometry of the workarea (x, y, width, height) */
 static long workarea[4];
 
@@ -78,7 +83,9 @@ static void ewmh_manage(struct window *);
 static void ewmh_unmanage(struct window *);
 static void ewmh_activate(struct window *);
 static void ewmh_restack(void);
+static void ewmh_commit(void);
 static int ewmh_clientmessage(struct window *, XClientMessageEvent *);
+static int ewmh_propertynotify(struct window *, XPropertyEvent *);
 static void addclient(Window);
 static void delclient(Window);
 
@@ -89,7 +96,9 @@ struct hints ewmh_hints = {
 	.unmanage = ewmh_unmanage,
 	.activate = ewmh_activate,
 	.restack = ewmh_restack,
+	.commit = ewmh_commit,
 	.clientmessage = ewmh_clientmessage,
+	.propertynotify = ewmh_propertynotify,
 };
 
 static void ewmh_init(void)
@@ -144,6 +153,10 @@ static void ewmh_init(void)
 	    "_NET_WM_NAME", False);
 	atom[NET_CLOSE_WINDOW] = XInternAtom(display,
 	    "_NET_CLOSE_WINDOW", False);
+	atom[NET_WM_ICON] = XInternAtom(display,
+	    "_NET_WM_ICON", False);
+	atom[NET_WM_ICON_NAME] = XInternAtom(display,
+	    "_NET_WM_ICON_NAME", False);
 
 	XChangeProperty(display, root, atom[NET_CLIENT_LIST],
 	    XA_WINDOW, 32, PropModeReplace, NULL, 0);
@@ -196,15 +209,26 @@ static void ewmh_fini(void)
 
 static void ewmh_manage(struct window *win)
 {
+	fetch_wm_icon(win);
 	addclient(win->client);
-	XChangeProperty(display, root, atom[NET_CLIENT_LIST],
-	    XA_WINDOW, 32, PropModeReplace,
-	    (unsigned char *)clientlist.win, clientlist.len);
+	clientlistdirty = 1;
 }
 
 static void ewmh_unmanage(struct window *win)
 {
 	delclient(win->client);
+	clientlistdirty = 1;
+}
+
+/*
+ * The client list is written once per batch of manages and
+ * unmanages rather than once per window.
+ */
+static void ewmh_commit(void)
+{
+	if (!clientlistdirty)
+		return;
+	clientlistdirty = 0;
 	XChangeProperty(display, root, atom[NET_CLIENT_LIST],
 	    XA_WINDOW, 32, PropModeReplace,
 	    (unsigned char *)clientlist.win, clientlist.len);
@@ -255,6 +279,21 @@ static int ewmh_clientmessage(struct window *win, XClientMessageEvent *ep)
 	return 1;
 }
 
+static int ewmh_propertynotify(struct window *win, XPropertyEvent *ep)
+{
+	if (ep->atom == atom[NET_WM_ICON]) {
+		mark_property_dirty(win, PROP_ICON);
+		return 1;
+	} else if (ep->atom == atom[NET_WM_NAME]) {
+		mark_property_dirty(win, PROP_NAME);
+		return 1;
+	} else if (ep->atom == atom[NET_WM_ICON_NAME]) {
+		mark_property_dirty(win, PROP_ICONNAME);
+		return 1;
+	}
+	return 0;
+}
+
 static void addclient(Window w)
 {
 	if (clientlist.len == clientlist.lim) {
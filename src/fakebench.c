@@ -0,0 +1,547 @@
+/*
+ * fakebench.c - window management benchmarks against the fake X server
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs the window management code on a fakex.c display with
+ * thousands of clients, which no real server handles comfortably,
+ * and prints one JSON object per scenario with the time taken and
+ * the X requests and round trips that it would have cost.  With -v
+ * the calls behind those are listed on standard error.
+ *
+ * The "soak" scenario instead puts count windows through their whole
+ * life, a batch at a time, and fails if the heap or the resources
+ * alive in the server grow from one batch to the next.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xft/Xft.h>
+
+#include "fakex.h"
+#include "global.h"
+#include "hints.h"
+#include "lib.h"
+#include "menu.h"
+#include "stats.h"
+#include "text.h"
+#if CONFIG_THUMBNAILS
+#include "thumb.h"
+#endif
+#include "timer.h"
+#include "widget.h"
+#include "window.h"
+
+#if CONFIG_THUMBNAILS
+#define SCENARIOS \
+	"manage place activate ontop repaint menu switch unmanage soak"
+#else
+#define SCENARIOS \
+	"manage place activate ontop repaint menu unmanage soak"
+#endif
+
+/* Windows placed without a position by the "place" scenario */
+#define NPLACE		100
+
+/* Most windows activated or toggled by one scenario */
+#define NACTIVATE	1000
+
+/* Times the menu is shown */
+#define NMENU		10
+
+#if CONFIG_THUMBNAILS
+/* Windows cycled through and Tab presses in the "switch" scenario */
+#define NSWITCH		8
+#define NTAB		1000
+
+/* Before one Tab in this many, a window in the cycle draws */
+#define DAMAGEEVERY	4
+
+/* Memory for the thumbnails */
+#define THUMBBUDGET	(16L << 20)
+#endif
+
+/* Windows alive at once in the soak */
+#define SOAKBATCH	16
+
+/* Times the soak compares usage with the first batch */
+#define NCHECK		10
+
+/* Most kinds of server resource compared */
+#define MAXALIVE	8
+
+struct usage {
+	long blocks;
+	long bytes;
+	long alive[MAXALIVE];
+};
+
+/* What main.c would have defined */
+Display *display;
+int screen;
+Window root;
+struct menu *winmenu;
+XftFont *xftfont;
+int border_width = 1;
+int button_size;
+int title_pad;
+int overloaded = 0;
+XftColor bgColorTitleActive;
+XftColor bgColorTitleActiveBright;
+XftColor fgColorTitleActive;
+XftColor bgColorTitleInactive;
+XftColor bgColorTitleInactiveBright;
+XftColor fgColorTitleInactive;
+XftColor bgColorMenu;
+XftColor fgColorMenu;
+XftColor bgColorMenuSelection;
+XftColor fgColorMenuSelection;
+
+static XftFont font = { 11, 3, 14, 7, NULL, NULL };
+static int errlev = 0;
+static int verbose = 0;
+
+static struct window **wins = NULL;
+static int nwins = 0;
+
+static long long t0;
+static unsigned long ops;
+
+void clerr(void)
+{
+	assert(errlev >= 0);
+
+	if (errlev++ == 0)
+		XGrabServer(display);
+}
+
+void sterr(void)
+{
+	assert(errlev >= 1);
+
+	if (--errlev == 0) {
+		XSync(display, False);
+		XUngrabServer(display);
+	}
+}
+
+/*
+ * What the main loop does between batches of events.
+ */
+static void settle(void)
+{
+	fetch_dirty_properties();
+	run_deferred();
+	restack_all_windows();
+	repaint_widgets(NULL);
+}
+
+static void begin(void)
+{
+	fakex_reset();
+	ops = 0;
+	t0 = now_us();
+}
+
+static void report(const char *scenario, int n)
+{
+	unsigned long requests, roundtrips;
+	double wall = (now_us() - t0) / 1e3;
+
+	fakex_count(&requests, &roundtrips);
+	printf("{\"scenario\": \"%s\", \"n\": %d, \"ops\": %lu, "
+	    "\"wall_ms\": %.1f, \"us_per_op\": %.2f, "
+	    "\"requests\": %lu, \"roundtrips\": %lu, "
+	    "\"requests_per_op\": %.1f, \"roundtrips_per_op\": %.1f}\n",
+	    scenario, n, ops, wall, ops ? 1e3 * wall / ops : 0.0,
+	    requests, roundtrips,
+	    ops ? (double)requests / ops : 0.0,
+	    ops ? (double)roundtrips / ops : 0.0);
+	fflush(stdout);
+	if (verbose) {
+		fprintf(stderr, "%s:\n", scenario);
+		fakex_dump(stderr);
+	}
+}
+
+static void refresh(void)
+{
+	FREE(wins);
+	get_window_stack(&wins, &nwins);
+}
+
+static void manage(const char *scenario, int n, unsigned flags)
+{
+	char name[32];
+	Window client;
+	int i;
+
+	begin();
+	for (i = 0; i < n; i++) {
+		snprintf(name, sizeof name, "%s %d", scenario, i);
+		client = fakex_client(name, rand() % 1000, rand() % 700,
+		    200 + rand() % 400, 100 + rand() % 300, flags);
+		manage_window(client, 0);
+		settle();
+		ops++;
+	}
+	report(scenario, n);
+	refresh();
+}
+
+static void activate(int n)
+{
+	int i, k = MIN(n, NACTIVATE);
+
+	begin();
+	for (i = 0; i < k; i++) {
+		set_active_window(wins[rand() % nwins]);
+		settle();
+		ops++;
+	}
+	report("activate", n);
+}
+
+static void ontop(int n)
+{
+	int i, k = MIN(n, NACTIVATE);
+
+	begin();
+	for (i = 0; i < k; i++) {
+		toggle_window_ontop(wins[rand() % nwins]);
+		settle();
+		ops++;
+	}
+	report("ontop", n);
+}
+
+static void repaint(int n)
+{
+	int i;
+
+	begin();
+	for (i = 0; i < nwins; i++) {
+		repaint_window(wins[i]);
+		ops++;
+	}
+	settle();
+	report("repaint", n);
+}
+
+static void menu(int n)
+{
+	int i;
+
+	begin();
+	for (i = 0; i < NMENU; i++) {
+		show_menu(winmenu, 0, 0, Button3);
+		settle();
+		hide_menu(winmenu);
+		settle();
+		ops++;
+	}
+	report("menu", n);
+}
+
+#if CONFIG_THUMBNAILS
+/*
+ * Alt-Tab through a few windows with thumbnails, some of them
+ * drawing in between.  The thumbnails were rendered on an earlier
+ * round, so a Tab should only render the windows that drew.
+ */
+static void switcher(int n)
+{
+	XEvent e;
+	int i, k = MIN(nwins, NSWITCH);
+
+	for (i = 0; i < k; i++) {
+		show_thumbnail(wins[i], &winmenu->widget);
+		settle();
+	}
+	hide_thumbnail();
+
+	begin();
+	for (i = 0; i < NTAB; i++) {
+		if (i % DAMAGEEVERY == 0
+		    && fakex_damage(wins[rand() % k]->client, &e))
+			thumbnail_event(&e);
+		show_thumbnail(wins[i % k], &winmenu->widget);
+		settle();
+		ops++;
+	}
+	hide_thumbnail();
+	settle();
+	report("switch", n);
+}
+#endif
+
+static void unmanage(int n)
+{
+	int i;
+
+	refresh();
+	begin();
+	for (i = 0; i < nwins; i++) {
+		unmanage_window(wins[i], 0);
+		settle();
+		ops++;
+	}
+	report("unmanage", n);
+	FREE(wins);
+	wins = NULL;
+	nwins = 0;
+}
+
+static void sample(struct usage *up)
+{
+	const struct heapstats *hp = heap_stats();
+	const char *name;
+	int i;
+
+	/* bounded, but slow to fill with the clock in the active title */
+	text_fini();
+	up->blocks = hp->blocks;
+	up->bytes = hp->bytes;
+	for (i = 0; i < MAXALIVE; i++)
+		if (!fakex_alive(i, &name, &up->alive[i]))
+			up->alive[i] = 0;
+}
+
+/*
+ * Report what grew since the baseline, and whether anything did.
+ */
+static int grown(const struct usage *base, const struct usage *up,
+    int batch)
+{
+	const char *name;
+	long count;
+	int i, n = 0;
+
+	if (up->blocks > base->blocks || up->bytes > base->bytes) {
+		fprintf(stderr, "karmen-fakebench: batch %d: heap grew from "
+		    "%ld blocks, %ld bytes to %ld blocks, %ld bytes\n", batch,
+		    base->blocks, base->bytes, up->blocks, up->bytes);
+		n++;
+	}
+	for (i = 0; i < MAXALIVE && fakex_alive(i, &name, &count); i++)
+		if (up->alive[i] > base->alive[i]) {
+			fprintf(stderr, "karmen-fakebench: batch %d: %s alive "
+			    "grew from %ld to %ld\n", batch, name,
+			    base->alive[i], up->alive[i]);
+			n++;
+		}
+	return n > 0;
+}
+
+/*
+ * One batch of windows from creation to destruction, with most of
+ * what can happen to them in between.  The names repeat from batch
+ * to batch, so the caches are full after the first.
+ */
+static void soakbatch(int batch)
+{
+	static Atom NET_WM_ICON = None;
+	struct window *win[SOAKBATCH];
+	Window client[SOAKBATCH];
+	unsigned long icon[2 + 32 * 32];
+	char name[32];
+	int i;
+
+	if (NET_WM_ICON == None)
+		NET_WM_ICON = XInternAtom(display, "_NET_WM_ICON", False);
+	icon[0] = 32;
+	icon[1] = 32;
+	for (i = 2; i < NELEM(icon); i++)
+		icon[i] = 0xff000000 | (i * 0x010203);
+
+	for (i = 0; i < SOAKBATCH; i++) {
+		snprintf(name, sizeof name, "soak %d", i);
+		client[i] = fakex_client(name, rand() % 1000, rand() % 700,
+		    200 + rand() % 400, 100 + rand() % 300,
+		    i % 8 == 7 ? FAKEX_DOCK : FAKEX_POSITION);
+		XChangeProperty(display, client[i], NET_WM_ICON, XA_CARDINAL,
+		    32, PropModeReplace, (unsigned char *)icon,
+		    i % 2 == 0 ? NELEM(icon) : 0);
+		/* docks are let go of at once */
+		win[i] = manage_window(client[i], 0);
+		settle();
+	}
+	for (i = 0; i < SOAKBATCH; i++) {
+		if (win[i] == NULL)
+			continue;
+		snprintf(name, sizeof name, "soak %d renamed",
+		    (batch + i) % SOAKBATCH);
+		XChangeProperty(display, client[i], XA_WM_NAME, XA_STRING, 8,
+		    PropModeReplace, (unsigned char *)name, strlen(name));
+		mark_property_dirty(win[i], PROP_NAME | PROP_ICONNAME |
+		    PROP_CLASS | PROP_HINTS | PROP_NORMALHINTS | PROP_ICON);
+		set_active_window(win[i]);
+		toggle_window_ontop(win[i]);
+		maximize_window(win[i]);
+		settle();
+		maximize_window(win[i]);
+		settle();
+	}
+	show_menu(winmenu, 0, 0, Button3);
+	settle();
+	hide_menu(winmenu);
+	settle();
+
+	/* as when the clients quit */
+	for (i = 0; i < SOAKBATCH; i++) {
+		XDestroyWindow(display, client[i]);
+		if (win[i] != NULL)
+			unmanage_window(win[i], 1);
+		settle();
+	}
+}
+
+static int soak(int n)
+{
+	struct usage base, now;
+	int batch, nbatch, failed = 0;
+
+	nbatch = MAX(2, n / SOAKBATCH);
+	begin();
+
+	/* the first batch fills the caches */
+	soakbatch(0);
+	ops += SOAKBATCH;
+	sample(&base);
+	for (batch = 1; batch < nbatch; batch++) {
+		soakbatch(batch);
+		ops += SOAKBATCH;
+		if (batch % MAX(1, nbatch / NCHECK) == 0
+		    || batch == nbatch - 1) {
+			sample(&now);
+			if (grown(&base, &now, batch)) {
+				failed = 1;
+				break;
+			}
+		}
+	}
+	report("soak", n);
+	return failed;
+}
+
+static int known(const char *scenario)
+{
+	char word[32];
+
+	snprintf(word, sizeof word, " %s ", scenario);
+	return strstr(" " SCENARIOS " ", word) != NULL;
+}
+
+static void usage(FILE *fp)
+{
+	fprintf(fp,
+"usage: karmen-fakebench [-n count] [-v] scenario...\n"
+"scenarios: " SCENARIOS "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int i, j, n = 10000;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			n = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[i], "-help") == 0) {
+			usage(stdout);
+			return 0;
+		} else {
+			usage(stderr);
+			return 2;
+		}
+	}
+	if (i == argc || n <= 0) {
+		usage(stderr);
+		return 2;
+	}
+
+	for (j = i; j < argc; j++)
+		if (!known(argv[j])) {
+			fprintf(stderr, "karmen-fakebench: unknown scenario %s\n",
+			    argv[j]);
+			return 2;
+		}
+
+	srand(1);
+	display = fakex_open(1280, 1024);
+	screen = DefaultScreen(display);
+	root = RootWindow(display, screen);
+	xftfont = &font;
+	title_pad = 1 + MAX(1, (xftfont->ascent + xftfont->descent) / 10);
+	button_size = xftfont->ascent + xftfont->descent + 2 * title_pad;
+
+	timer_init();
+	widget_init();
+	winmenu = create_menu();
+	hints_init();
+#if CONFIG_THUMBNAILS
+	thumbnail_init(THUMBBUDGET);
+#endif
+	window_init();
+
+	for (; i < argc; i++) {
+		if (strcmp(argv[i], "manage") == 0) {
+			manage("manage", n, FAKEX_POSITION);
+			continue;
+		} else if (strcmp(argv[i], "place") == 0) {
+			manage("place", NPLACE, 0);
+			continue;
+		} else if (strcmp(argv[i], "soak") == 0) {
+			if (soak(n))
+				return 1;
+			continue;
+		}
+
+		/* everything else needs windows to work on */
+		if (nwins == 0)
+			manage("manage", n, FAKEX_POSITION);
+		if (strcmp(argv[i], "activate") == 0)
+			activate(n);
+		else if (strcmp(argv[i], "ontop") == 0)
+			ontop(n);
+		else if (strcmp(argv[i], "repaint") == 0)
+			repaint(n);
+		else if (strcmp(argv[i], "menu") == 0)
+			menu(n);
+#if CONFIG_THUMBNAILS
+		else if (strcmp(argv[i], "switch") == 0)
+			switcher(n);
+#endif
+		else if (strcmp(argv[i], "unmanage") == 0)
+			unmanage(n);
+	}
+	return 0;
+}
@@ -0,0 +1,1749 @@
+/*
+ * fakex.c - in-memory X server for benchmarks
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xresource.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xrender.h>
+#if CONFIG_THUMBNAILS
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#endif
+#include <X11/Xft/Xft.h>
+
+#include "fakex.h"
+#include "lib.h"
+#include "list.h"
+
+/* What a call costs on a real connection */
+enum { LOCAL, REQUEST, ROUNDTRIP };
+
+/* Resources that are counted while alive */
+enum {
+	RES_WINDOW, RES_PIXMAP, RES_GC, RES_PICTURE, RES_COLORMAP,
+	RES_DAMAGE, NRES
+};
+
+static const char *resname[NRES] = {
+	"windows", "pixmaps", "gcs", "pictures", "colormaps", "damages"
+};
+
+/* Damage objects are kept in the table under this context */
+#define DAMAGECONTEXT	((XContext)-1)
+
+/* What XDamageQueryExtension() reports */
+#define DAMAGEEVENTBASE	100
+
+#define MAXCALLS	128
+
+struct call {
+	const char *name;
+	int kind;
+	unsigned long calls;
+	unsigned long cost;		/* requests or round trips */
+};
+
+struct prop {
+	Atom name;
+	Atom type;
+	int format;
+	unsigned long nitems;
+	unsigned char *data;		/* 32-bit items are longs */
+	struct prop *next;
+};
+
+struct fwin {
+	Window id;
+	struct fwin *parent;
+	LIST children;			/* bottom to top */
+	LIST sibling;
+	int x, y;
+	int width, height;
+	int border;
+	int mapped;
+	int override;
+	int depth;
+	unsigned class;
+	long eventmask;
+	struct prop *props;
+	XID damage;			/* None if not watched */
+	int damaged;			/* reported, not yet subtracted */
+};
+
+/* Windows and context data, keyed by id and context (0 for windows) */
+struct entry {
+	XID id;
+	XContext context;
+	void *data;
+	struct entry *next;
+};
+
+struct _XftDraw {
+	Drawable drawable;
+	Visual *visual;
+	Colormap colormap;
+	Picture picture;
+};
+
+static Display *fakedisplay = NULL;
+static Screen fakescreen;
+static Visual fakevisual;
+static XRenderPictFormat fakeformat;
+static struct fwin *rootwin = NULL;
+
+static struct call calls[MAXCALLS];
+static int ncalls = 0;
+static long live[NRES];
+static unsigned long errors = 0;
+
+static struct entry **table = NULL;
+static size_t tablesize = 0;
+static size_t tablecount = 0;
+
+static XID lastid = 0x200000;
+static XrmQuark lastquark = 0;
+
+static char **atoms = NULL;
+static int natoms = 0;
+
+static const char *predefined[] = {
+	"PRIMARY", "SECONDARY", "ARC", "ATOM", "BITMAP", "CARDINAL",
+	"COLORMAP", "CURSOR", "CUT_BUFFER0", "CUT_BUFFER1", "CUT_BUFFER2",
+	"CUT_BUFFER3", "CUT_BUFFER4", "CUT_BUFFER5", "CUT_BUFFER6",
+	"CUT_BUFFER7", "DRAWABLE", "FONT", "INTEGER", "PIXMAP", "POINT",
+	"RECTANGLE", "RESOURCE_MANAGER", "RGB_COLOR_MAP", "RGB_BEST_MAP",
+	"RGB_BLUE_MAP", "RGB_DEFAULT_MAP", "RGB_GRAY_MAP", "RGB_GREEN_MAP",
+	"RGB_RED_MAP", "STRING", "VISUALID", "WINDOW", "WM_COMMAND",
+	"WM_HINTS", "WM_CLIENT_MACHINE", "WM_ICON_NAME", "WM_ICON_SIZE",
+	"WM_NAME", "WM_NORMAL_HINTS", "WM_SIZE_HINTS", "WM_ZOOM_HINTS",
+	"MIN_SPACE", "NORM_SPACE", "MAX_SPACE", "END_SPACE",
+	"SUPERSCRIPT_X", "SUPERSCRIPT_Y", "SUBSCRIPT_X", "SUBSCRIPT_Y",
+	"UNDERLINE_POSITION", "UNDERLINE_THICKNESS", "STRIKEOUT_ASCENT",
+	"STRIKEOUT_DESCENT", "ITALIC_ANGLE", "X_HEIGHT", "QUAD_WIDTH",
+	"WEIGHT", "POINT_SIZE", "RESOLUTION", "COPYRIGHT", "NOTICE",
+	"FONT_NAME", "FAMILY_NAME", "FULL_NAME", "CAP_HEIGHT", "WM_CLASS",
+	"WM_TRANSIENT_FOR",
+};
+
+/*
+ * Charge the calling function n requests or round trips.  Each
+ * function finds its counter once and keeps it.
+ */
+#define COUNTN(kind, n) do { \
+	static struct call *cp_ = NULL; \
+	if (cp_ == NULL) \
+		cp_ = newcall(__func__, (kind)); \
+	cp_->calls++; \
+	cp_->cost += (n); \
+} while (0)
+#define COUNT(kind)	COUNTN((kind), (kind) == LOCAL ? 0 : 1)
+
+static struct call *newcall(const char *name, int kind)
+{
+	static struct call overflow = { "(other)", LOCAL, 0, 0 };
+
+	if (ncalls == MAXCALLS)
+		return &overflow;
+	calls[ncalls].name = name;
+	calls[ncalls].kind = kind;
+	return &calls[ncalls++];
+}
+
+static XID newid(void)
+{
+	return ++lastid;
+}
+
+static size_t hash(XID id, XContext context)
+{
+	return (id * 2654435761UL ^ context * 40503UL) & (tablesize - 1);
+}
+
+static struct entry **lookup(XID id, XContext context)
+{
+	struct entry **epp;
+
+	if (tablesize == 0)
+		return NULL;
+	for (epp = &table[hash(id, context)]; *epp != NULL;
+	    epp = &(*epp)->next)
+		if ((*epp)->id == id && (*epp)->context == context)
+			return epp;
+	return NULL;
+}
+
+static void grow(void)
+{
+	struct entry **old = table;
+	struct entry *ep, *next;
+	size_t oldsize = tablesize;
+	size_t i, h;
+
+	tablesize = tablesize == 0 ? 1024 : 2 * tablesize;
+	table = MALLOC(tablesize * sizeof *table);
+	memset(table, 0, tablesize * sizeof *table);
+	for (i = 0; i < oldsize; i++)
+		for (ep = old[i]; ep != NULL; ep = next) {
+			next = ep->next;
+			h = hash(ep->id, ep->context);
+			ep->next = table[h];
+			table[h] = ep;
+		}
+	FREE(old);
+}
+
+static void insert(XID id, XContext context, void *data)
+{
+	struct entry **epp;
+	struct entry *ep;
+	size_t h;
+
+	if ((epp = lookup(id, context)) != NULL) {
+		(*epp)->data = data;
+		return;
+	}
+	if (tablecount >= tablesize)
+		grow();
+	ep = MALLOC(sizeof *ep);
+	ep->id = id;
+	ep->context = context;
+	ep->data = data;
+	h = hash(id, context);
+	ep->next = table[h];
+	table[h] = ep;
+	tablecount++;
+}
+
+static int delete(XID id, XContext context)
+{
+	struct entry **epp;
+	struct entry *ep;
+
+	if ((epp = lookup(id, context)) == NULL)
+		return 0;
+	ep = *epp;
+	*epp = ep->next;
+	FREE(ep);
+	tablecount--;
+	return 1;
+}
+
+/*
+ * Find a window.  Asking for one that does not exist is what would
+ * have been a BadWindow error.
+ */
+static struct fwin *findwin(Window id)
+{
+	struct entry **epp;
+
+	if ((epp = lookup(id, 0)) == NULL) {
+		errors++;
+		return NULL;
+	}
+	return (*epp)->data;
+}
+
+static struct fwin *newwin(struct fwin *parent, int x, int y,
+    int width, int height, int border, int depth, unsigned class)
+{
+	struct fwin *fw;
+
+	fw = MALLOC(sizeof *fw);
+	memset(fw, 0, sizeof *fw);
+	fw->id = newid();
+	fw->parent = parent;
+	LIST_INIT(&fw->children);
+	LIST_INIT(&fw->sibling);
+	if (parent != NULL)
+		LIST_INSERT_TAIL(&parent->children, &fw->sibling);
+	fw->x = x;
+	fw->y = y;
+	fw->width = width;
+	fw->height = height;
+	fw->border = border;
+	fw->depth = depth;
+	fw->class = class;
+	insert(fw->id, 0, fw);
+	live[RES_WINDOW]++;
+	return fw;
+}
+
+static void freewin(struct fwin *fw)
+{
+	struct prop *pp;
+	LIST *lp;
+
+	while ((lp = LIST_TAIL(&fw->children)) != NULL)
+		freewin(LIST_ITEM(lp, struct fwin, sibling));
+	LIST_REMOVE(&fw->sibling);
+	while ((pp = fw->props) != NULL) {
+		fw->props = pp->next;
+		FREE(pp->data);
+		FREE(pp);
+	}
+	/* the server frees a drawable's damage along with it */
+	if (fw->damage != None) {
+		delete(fw->damage, DAMAGECONTEXT);
+		live[RES_DAMAGE]--;
+	}
+	delete(fw->id, 0);
+	FREE(fw);
+	live[RES_WINDOW]--;
+}
+
+static int itemsize(int format)
+{
+	return format == 32 ? sizeof (long) : format / 8;
+}
+
+static struct prop *findprop(struct fwin *fw, Atom name)
+{
+	struct prop *pp;
+
+	for (pp = fw->props; pp != NULL; pp = pp->next)
+		if (pp->name == name)
+			return pp;
+	return NULL;
+}
+
+static void setprop(struct fwin *fw, Atom name, Atom type, int format,
+    int mode, const void *data, unsigned long n)
+{
+	struct prop *pp;
+	size_t size = itemsize(format);
+	size_t old;
+
+	if ((pp = findprop(fw, name)) == NULL) {
+		pp = MALLOC(sizeof *pp);
+		pp->name = name;
+		pp->nitems = 0;
+		pp->data = NULL;
+		pp->next = fw->props;
+		fw->props = pp;
+		mode = PropModeReplace;
+	} else if (pp->type != type || pp->format != format)
+		mode = PropModeReplace;
+	pp->type = type;
+	pp->format = format;
+
+	switch (mode) {
+	case PropModeReplace:
+		FREE(pp->data);
+		pp->data = MALLOC(n * size + 1);
+		if (n > 0)
+			memcpy(pp->data, data, n * size);
+		pp->nitems = n;
+		break;
+	case PropModePrepend:
+	case PropModeAppend:
+		old = pp->nitems * size;
+		pp->data = REALLOC(pp->data, old + n * size + 1);
+		if (mode == PropModePrepend) {
+			memmove(pp->data + n * size, pp->data, old);
+			memcpy(pp->data, data, n * size);
+		} else
+			memcpy(pp->data + old, data, n * size);
+		pp->nitems += n;
+		break;
+	}
+	pp->data[pp->nitems * size] = '\0';
+}
+
+/*
+ * A copy of a whole property, NUL terminated like Xlib's, or NULL.
+ */
+static void *copyprop(Window w, Atom name, Atom type, unsigned long *np)
+{
+	struct fwin *fw;
+	struct prop *pp;
+	void *data;
+	size_t size;
+
+	if ((fw = findwin(w)) == NULL || (pp = findprop(fw, name)) == NULL
+	    || (type != AnyPropertyType && pp->type != type))
+		return NULL;
+	size = pp->nitems * itemsize(pp->format);
+	data = MALLOC(size + 1);
+	memcpy(data, pp->data, size + 1);
+	if (np != NULL)
+		*np = pp->nitems;
+	return data;
+}
+
+static void absolute(struct fwin *fw, int *xp, int *yp)
+{
+	*xp = 0;
+	*yp = 0;
+	for (; fw != NULL; fw = fw->parent) {
+		*xp += fw->x + fw->border;
+		*yp += fw->y + fw->border;
+	}
+}
+
+static int viewable(struct fwin *fw)
+{
+	for (; fw != NULL; fw = fw->parent)
+		if (!fw->mapped)
+			return 0;
+	return 1;
+}
+
+Display *fakex_open(int width, int height)
+{
+	_XPrivDisplay dpy;
+	size_t i;
+
+	if (fakedisplay != NULL)
+		return fakedisplay;
+
+	for (i = 0; i < NELEM(predefined); i++)
+		XInternAtom(NULL, predefined[i], False);
+
+	fakevisual.visualid = newid();
+	fakevisual.class = TrueColor;
+	fakevisual.red_mask = 0xff0000;
+	fakevisual.green_mask = 0x00ff00;
+	fakevisual.blue_mask = 0x0000ff;
+	fakevisual.bits_per_rgb = 8;
+	fakevisual.map_entries = 256;
+
+	rootwin = newwin(NULL, 0, 0, width, height, 0, 24, InputOutput);
+	rootwin->mapped = 1;
+
+	dpy = MALLOC(sizeof *dpy);
+	memset(dpy, 0, sizeof *dpy);
+	dpy->fd = -1;
+	dpy->nscreens = 1;
+	dpy->default_screen = 0;
+	dpy->screens = &fakescreen;
+
+	fakescreen.display = (Display *)dpy;
+	fakescreen.root = rootwin->id;
+	fakescreen.width = width;
+	fakescreen.height = height;
+	fakescreen.mwidth = width / 4;
+	fakescreen.mheight = height / 4;
+	fakescreen.root_depth = 24;
+	fakescreen.root_visual = &fakevisual;
+	fakescreen.cmap = newid();
+	fakescreen.white_pixel = 0xffffff;
+	fakescreen.black_pixel = 0;
+
+	fakeformat.id = newid();
+	fakeformat.type = PictTypeDirect;
+	fakeformat.depth = 32;
+
+	fakedisplay = (Display *)dpy;
+	return fakedisplay;
+}
+
+/*
+ * Create a client window the way an application would, with a name,
+ * class and size hints, but without counting any of it.  It is left
+ * unmapped for the window manager to manage.
+ */
+Window fakex_client(const char *name, int x, int y, int width, int height,
+    unsigned flags)
+{
+	struct fwin *fw;
+	long hints[18];
+	long wmhints[9];
+	long type;
+	char class[64];
+	int len;
+
+	fw = newwin(rootwin, x, y, width, height, 0, 24, InputOutput);
+	setprop(fw, XA_WM_NAME, XA_STRING, 8, PropModeReplace,
+	    name, strlen(name));
+	len = snprintf(class, sizeof class, "%s%cFake", name, '\0');
+	setprop(fw, XA_WM_CLASS, XA_STRING, 8, PropModeReplace,
+	    class, MIN(len + 1, (int)sizeof class));
+
+	memset(hints, 0, sizeof hints);
+	hints[0] = PMinSize | PResizeInc;
+	if (flags & FAKEX_POSITION)
+		hints[0] |= PPosition;
+	hints[5] = 16;
+	hints[6] = 16;
+	hints[9] = 1;
+	hints[10] = 1;
+	setprop(fw, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 32,
+	    PropModeReplace, hints, NELEM(hints));
+
+	memset(wmhints, 0, sizeof wmhints);
+	wmhints[0] = InputHint | StateHint;
+	wmhints[1] = True;
+	wmhints[2] = flags & FAKEX_ICONIC ? IconicState : NormalState;
+	setprop(fw, XA_WM_HINTS, XA_WM_HINTS, 32, PropModeReplace,
+	    wmhints, NELEM(wmhints));
+
+	if (flags & FAKEX_DOCK) {
+		type = XInternAtom(NULL, "_NET_WM_WINDOW_TYPE_DOCK", False);
+		setprop(fw, XInternAtom(NULL, "_NET_WM_WINDOW_TYPE", False),
+		    XA_ATOM, 32, PropModeReplace, &type, 1);
+	}
+	return fw->id;
+}
+
+int fakex_mapped(Window w)
+{
+	struct entry **epp;
+
+	if ((epp = lookup(w, 0)) == NULL)
+		return 0;
+	return viewable((*epp)->data);
+}
+
+void fakex_count(unsigned long *requests, unsigned long *roundtrips)
+{
+	int i;
+
+	*requests = 0;
+	*roundtrips = 0;
+	for (i = 0; i < ncalls; i++) {
+		if (calls[i].kind == REQUEST)
+			*requests += calls[i].cost;
+		else if (calls[i].kind == ROUNDTRIP)
+			*roundtrips += calls[i].cost;
+	}
+}
+
+void fakex_reset(void)
+{
+	int i;
+
+	for (i = 0; i < ncalls; i++) {
+		calls[i].calls = 0;
+		calls[i].cost = 0;
+	}
+	errors = 0;
+}
+
+static int bycost(const void *a, const void *b)
+{
+	const struct call *x = a;
+	const struct call *y = b;
+
+	if (x->cost != y->cost)
+		return x->cost < y->cost ? 1 : -1;
+	if (x->calls != y->calls)
+		return x->calls < y->calls ? 1 : -1;
+	return strcmp(x->name, y->name);
+}
+
+#if CONFIG_THUMBNAILS
+/*
+ * Have a client draw into window w.  If that reports damage, on w or
+ * the nearest ancestor watched, the DamageNotify is stored in *ep and
+ * 1 returned.
+ */
+int fakex_damage(Window w, XEvent *ep)
+{
+	XDamageNotifyEvent *dp = (XDamageNotifyEvent *)ep;
+	struct fwin *fw;
+
+	for (fw = findwin(w); fw != NULL; fw = fw->parent)
+		if (fw->damage != None)
+			break;
+	if (fw == NULL || fw->damaged)
+		return 0;
+	fw->damaged = 1;
+	memset(ep, 0, sizeof *ep);
+	dp->type = DAMAGEEVENTBASE + XDamageNotify;
+	dp->display = fakedisplay;
+	dp->drawable = fw->id;
+	dp->damage = fw->damage;
+	dp->level = XDamageReportNonEmpty;
+	dp->area.width = dp->geometry.width = fw->width;
+	dp->area.height = dp->geometry.height = fw->height;
+	return 1;
+}
+#endif
+
+/*
+ * The i'th kind of resource counted while alive, and how many there
+ * are, or 0 past the last kind.
+ */
+int fakex_alive(int i, const char **namep, long *countp)
+{
+	if (i < 0 || i >= NRES)
+		return 0;
+	*namep = resname[i];
+	*countp = live[i];
+	return 1;
+}
+
+void fakex_dump(FILE *fp)
+{
+	static const char *kindname[] = { "local", "requests", "roundtrips" };
+	struct call sorted[MAXCALLS];
+	int i;
+
+	memcpy(sorted, calls, ncalls * sizeof calls[0]);
+	qsort(sorted, ncalls, sizeof sorted[0], bycost);
+	for (i = 0; i < ncalls; i++)
+		if (sorted[i].calls > 0)
+			fprintf(fp, "%-28s %10lu calls %10lu %s\n",
+			    sorted[i].name, sorted[i].calls, sorted[i].cost,
+			    kindname[sorted[i].kind]);
+	for (i = 0; i < NRES; i++)
+		fprintf(fp, "%-28s %10ld alive\n", resname[i], live[i]);
+	fprintf(fp, "%-28s %10lu\n", "errors", errors);
+}
+
+/*
+ * Xlib
+ */
+
+Atom XInternAtom(Display *display, const char *name, Bool only_if_exists)
+{
+	int i;
+
+	if (display != NULL)
+		COUNT(ROUNDTRIP);
+	for (i = 0; i < natoms; i++)
+		if (strcmp(atoms[i], name) == 0)
+			return i + 1;
+	if (only_if_exists)
+		return None;
+	atoms = REALLOC(atoms, (natoms + 1) * sizeof atoms[0]);
+	atoms[natoms++] = STRDUP(name);
+	return natoms;
+}
+
+XrmQuark XrmUniqueQuark(void)
+{
+	return --lastquark;
+}
+
+int XSaveContext(Display *display, XID rid, XContext context,
+    const char *data)
+{
+	COUNT(LOCAL);
+	insert(rid, context, (void *)data);
+	return 0;
+}
+
+int XFindContext(Display *display, XID rid, XContext context,
+    XPointer *data_return)
+{
+	struct entry **epp;
+
+	COUNT(LOCAL);
+	if ((epp = lookup(rid, context)) == NULL)
+		return XCNOENT;
+	*data_return = (*epp)->data;
+	return 0;
+}
+
+int XDeleteContext(Display *display, XID rid, XContext context)
+{
+	COUNT(LOCAL);
+	return delete(rid, context) ? 0 : XCNOENT;
+}
+
+/* Everything handed out comes from MALLOC, so that it is counted */
+int XFree(void *data)
+{
+	FREE(data);
+	return 1;
+}
+
+void XFreeStringList(char **list)
+{
+	if (list != NULL) {
+		FREE(list[0]);
+		FREE(list);
+	}
+}
+
+int XSync(Display *display, Bool discard)
+{
+	COUNT(ROUNDTRIP);
+	return 1;
+}
+
+int XGrabServer(Display *display)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XUngrabServer(Display *display)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XEventsQueued(Display *display, int mode)
+{
+	COUNT(LOCAL);
+	return 0;
+}
+
+Window XCreateWindow(Display *display, Window parent, int x, int y,
+    unsigned width, unsigned height, unsigned border_width, int depth,
+    unsigned class, Visual *visual, unsigned long valuemask,
+    XSetWindowAttributes *attributes)
+{
+	struct fwin *pw, *fw;
+
+	COUNT(REQUEST);
+	if ((pw = findwin(parent)) == NULL)
+		return None;
+	if (depth == CopyFromParent)
+		depth = pw->depth;
+	if (class == CopyFromParent)
+		class = pw->class;
+	fw = newwin(pw, x, y, width, height, border_width, depth, class);
+	if (valuemask & CWOverrideRedirect)
+		fw->override = attributes->override_redirect;
+	if (valuemask & CWEventMask)
+		fw->eventmask = attributes->event_mask;
+	return fw->id;
+}
+
+int XDestroyWindow(Display *display, Window w)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL && fw != rootwin)
+		freewin(fw);
+	return 1;
+}
+
+int XChangeWindowAttributes(Display *display, Window w,
+    unsigned long valuemask, XSetWindowAttributes *attributes)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) == NULL)
+		return 1;
+	if (valuemask & CWOverrideRedirect)
+		fw->override = attributes->override_redirect;
+	if (valuemask & CWEventMask)
+		fw->eventmask = attributes->event_mask;
+	return 1;
+}
+
+int XSelectInput(Display *display, Window w, long event_mask)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL)
+		fw->eventmask = event_mask;
+	return 1;
+}
+
+Status XGetWindowAttributes(Display *display, Window w,
+    XWindowAttributes *attr)
+{
+	struct fwin *fw;
+
+	/* GetWindowAttributes and GetGeometry */
+	COUNTN(ROUNDTRIP, 2);
+	if ((fw = findwin(w)) == NULL)
+		return 0;
+	memset(attr, 0, sizeof *attr);
+	attr->x = fw->x;
+	attr->y = fw->y;
+	attr->width = fw->width;
+	attr->height = fw->height;
+	attr->border_width = fw->border;
+	attr->depth = fw->depth;
+	attr->visual = &fakevisual;
+	attr->root = rootwin->id;
+	attr->class = fw->class;
+	attr->colormap = fakescreen.cmap;
+	attr->map_installed = True;
+	attr->map_state = !fw->mapped ? IsUnmapped :
+	    viewable(fw) ? IsViewable : IsUnviewable;
+	attr->your_event_mask = fw->eventmask;
+	attr->all_event_masks = fw->eventmask;
+	attr->override_redirect = fw->override;
+	attr->screen = &fakescreen;
+	return 1;
+}
+
+Status XQueryTree(Display *display, Window w, Window *root_return,
+    Window *parent_return, Window **children_return,
+    unsigned *nchildren_return)
+{
+	struct fwin *fw;
+	LIST *lp;
+	unsigned n;
+
+	COUNT(ROUNDTRIP);
+	if ((fw = findwin(w)) == NULL)
+		return 0;
+	n = 0;
+	LIST_FOREACH(lp, &fw->children)
+		n++;
+	*root_return = rootwin->id;
+	*parent_return = fw->parent == NULL ? None : fw->parent->id;
+	*children_return = NULL;
+	*nchildren_return = n;
+	if (n > 0) {
+		*children_return = MALLOC(n * sizeof (Window));
+		n = 0;
+		LIST_FOREACH(lp, &fw->children)
+			(*children_return)[n++] =
+			    LIST_ITEM(lp, struct fwin, sibling)->id;
+	}
+	return 1;
+}
+
+Bool XTranslateCoordinates(Display *display, Window src, Window dest,
+    int src_x, int src_y, int *dest_x, int *dest_y, Window *child)
+{
+	struct fwin *sw, *dw;
+	int sx, sy, dx, dy;
+
+	COUNT(ROUNDTRIP);
+	*child = None;
+	if ((sw = findwin(src)) == NULL || (dw = findwin(dest)) == NULL)
+		return False;
+	absolute(sw, &sx, &sy);
+	absolute(dw, &dx, &dy);
+	*dest_x = src_x + sx - dx;
+	*dest_y = src_y + sy - dy;
+	return True;
+}
+
+int XMapWindow(Display *display, Window w)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL)
+		fw->mapped = 1;
+	return 1;
+}
+
+int XUnmapWindow(Display *display, Window w)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL)
+		fw->mapped = 0;
+	return 1;
+}
+
+int XMoveWindow(Display *display, Window w, int x, int y)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL) {
+		fw->x = x;
+		fw->y = y;
+	}
+	return 1;
+}
+
+int XResizeWindow(Display *display, Window w, unsigned width,
+    unsigned height)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL) {
+		fw->width = width;
+		fw->height = height;
+	}
+	return 1;
+}
+
+int XMoveResizeWindow(Display *display, Window w, int x, int y,
+    unsigned width, unsigned height)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL) {
+		fw->x = x;
+		fw->y = y;
+		fw->width = width;
+		fw->height = height;
+	}
+	return 1;
+}
+
+int XSetWindowBorderWidth(Display *display, Window w, unsigned width)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL)
+		fw->border = width;
+	return 1;
+}
+
+int XRaiseWindow(Display *display, Window w)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL && fw->parent != NULL) {
+		LIST_REMOVE(&fw->sibling);
+		LIST_INSERT_TAIL(&fw->parent->children, &fw->sibling);
+	}
+	return 1;
+}
+
+int XLowerWindow(Display *display, Window w)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL && fw->parent != NULL) {
+		LIST_REMOVE(&fw->sibling);
+		LIST_INSERT_HEAD(&fw->parent->children, &fw->sibling);
+	}
+	return 1;
+}
+
+int XConfigureWindow(Display *display, Window w, unsigned mask,
+    XWindowChanges *wc)
+{
+	struct fwin *fw, *sw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) == NULL)
+		return 1;
+	if (mask & CWX)
+		fw->x = wc->x;
+	if (mask & CWY)
+		fw->y = wc->y;
+	if (mask & CWWidth)
+		fw->width = wc->width;
+	if (mask & CWHeight)
+		fw->height = wc->height;
+	if (mask & CWBorderWidth)
+		fw->border = wc->border_width;
+	if (!(mask & CWStackMode) || fw->parent == NULL)
+		return 1;
+	sw = mask & CWSibling ? findwin(wc->sibling) : NULL;
+	if (sw == NULL || sw == fw || sw->parent != fw->parent)
+		sw = NULL;
+	LIST_REMOVE(&fw->sibling);
+	if (wc->stack_mode == Below && sw != NULL)
+		LIST_INSERT_BEFORE(&sw->sibling, &fw->sibling);
+	else if (wc->stack_mode == Above && sw != NULL)
+		LIST_INSERT_AFTER(&sw->sibling, &fw->sibling);
+	else if (wc->stack_mode == Below)
+		LIST_INSERT_HEAD(&fw->parent->children, &fw->sibling);
+	else
+		LIST_INSERT_TAIL(&fw->parent->children, &fw->sibling);
+	return 1;
+}
+
+int XReparentWindow(Display *display, Window w, Window parent,
+    int x, int y)
+{
+	struct fwin *fw, *pw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) == NULL || (pw = findwin(parent)) == NULL)
+		return 1;
+	LIST_REMOVE(&fw->sibling);
+	fw->parent = pw;
+	LIST_INSERT_TAIL(&pw->children, &fw->sibling);
+	fw->x = x;
+	fw->y = y;
+	return 1;
+}
+
+int XAddToSaveSet(Display *display, Window w)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XRemoveFromSaveSet(Display *display, Window w)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XKillClient(Display *display, XID resource)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XSetInputFocus(Display *display, Window focus, int revert_to,
+    Time time)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XAllowEvents(Display *display, int event_mode, Time time)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+Status XSendEvent(Display *display, Window w, Bool propagate,
+    long event_mask, XEvent *event)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XGrabButton(Display *display, unsigned button, unsigned modifiers,
+    Window grab_window, Bool owner_events, unsigned event_mask,
+    int pointer_mode, int keyboard_mode, Window confine_to, Cursor cursor)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XUngrabButton(Display *display, unsigned button, unsigned modifiers,
+    Window grab_window)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XGrabKey(Display *display, int keycode, unsigned modifiers,
+    Window grab_window, Bool owner_events, int pointer_mode,
+    int keyboard_mode)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XUngrabKey(Display *display, int keycode, unsigned modifiers,
+    Window grab_window)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XGrabPointer(Display *display, Window grab_window, Bool owner_events,
+    unsigned event_mask, int pointer_mode, int keyboard_mode,
+    Window confine_to, Cursor cursor, Time time)
+{
+	COUNT(ROUNDTRIP);
+	return GrabSuccess;
+}
+
+int XUngrabPointer(Display *display, Time time)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XGrabKeyboard(Display *display, Window grab_window, Bool owner_events,
+    int pointer_mode, int keyboard_mode, Time time)
+{
+	COUNT(ROUNDTRIP);
+	return GrabSuccess;
+}
+
+int XUngrabKeyboard(Display *display, Time time)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XLookupString(XKeyEvent *event, char *buffer, int bytes,
+    KeySym *keysym, XComposeStatus *status)
+{
+	if (keysym != NULL)
+		*keysym = NoSymbol;
+	return 0;
+}
+
+KeySym XLookupKeysym(XKeyEvent *event, int index)
+{
+	return NoSymbol;
+}
+
+Cursor XCreateFontCursor(Display *display, unsigned shape)
+{
+	COUNT(REQUEST);
+	return newid();
+}
+
+int XDefineCursor(Display *display, Window w, Cursor cursor)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+Colormap XCreateColormap(Display *display, Window w, Visual *visual,
+    int alloc)
+{
+	COUNT(REQUEST);
+	live[RES_COLORMAP]++;
+	return newid();
+}
+
+int XFreeColormap(Display *display, Colormap colormap)
+{
+	COUNT(REQUEST);
+	live[RES_COLORMAP]--;
+	return 1;
+}
+
+int XInstallColormap(Display *display, Colormap colormap)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XUninstallColormap(Display *display, Colormap colormap)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+Status XMatchVisualInfo(Display *display, int screen, int depth,
+    int class, XVisualInfo *vinfo)
+{
+	/* there is only the default visual */
+	COUNT(LOCAL);
+	return 0;
+}
+
+Pixmap XCreatePixmap(Display *display, Drawable d, unsigned width,
+    unsigned height, unsigned depth)
+{
+	COUNT(REQUEST);
+	live[RES_PIXMAP]++;
+	return newid();
+}
+
+int XFreePixmap(Display *display, Pixmap pixmap)
+{
+	COUNT(REQUEST);
+	live[RES_PIXMAP]--;
+	return 1;
+}
+
+/*
+ * GCs are opaque pointers; the only thing kept is the id.
+ */
+GC XCreateGC(Display *display, Drawable d, unsigned long valuemask,
+    XGCValues *values)
+{
+	GC gc;
+
+	COUNT(REQUEST);
+	gc = MALLOC(sizeof (XID));
+	*(XID *)gc = newid();
+	live[RES_GC]++;
+	return gc;
+}
+
+int XFreeGC(Display *display, GC gc)
+{
+	COUNT(REQUEST);
+	FREE(gc);
+	live[RES_GC]--;
+	return 1;
+}
+
+int XSetForeground(Display *display, GC gc, unsigned long foreground)
+{
+	/* sent along with the next drawing request */
+	COUNT(LOCAL);
+	return 1;
+}
+
+int XCopyArea(Display *display, Drawable src, Drawable dest, GC gc,
+    int src_x, int src_y, unsigned width, unsigned height,
+    int dest_x, int dest_y)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XFillRectangle(Display *display, Drawable d, GC gc, int x, int y,
+    unsigned width, unsigned height)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+static int putpixel(XImage *image, int x, int y, unsigned long pixel)
+{
+	((unsigned int *)image->data)[y * image->width + x] = pixel;
+	return 1;
+}
+
+static int destroyimage(XImage *image)
+{
+	FREE(image->data);
+	FREE(image);
+	return 1;
+}
+
+/*
+ * Only 32-bit ZPixmaps, which is all icon.c makes.
+ */
+XImage *XCreateImage(Display *display, Visual *visual, unsigned depth,
+    int format, int offset, char *data, unsigned width, unsigned height,
+    int bitmap_pad, int bytes_per_line)
+{
+	XImage *image;
+
+	COUNT(LOCAL);
+	image = MALLOC(sizeof *image);
+	memset(image, 0, sizeof *image);
+	image->width = width;
+	image->height = height;
+	image->format = format;
+	image->data = data;
+	image->depth = depth;
+	image->bitmap_pad = bitmap_pad;
+	image->bits_per_pixel = 32;
+	image->bytes_per_line = bytes_per_line ? bytes_per_line : 4 * width;
+	image->f.put_pixel = putpixel;
+	image->f.destroy_image = destroyimage;
+	return image;
+}
+
+int XPutImage(Display *display, Drawable d, GC gc, XImage *image,
+    int src_x, int src_y, int dest_x, int dest_y,
+    unsigned width, unsigned height)
+{
+	COUNT(REQUEST);
+	return 1;
+}
+
+int XChangeProperty(Display *display, Window w, Atom property, Atom type,
+    int format, int mode, const unsigned char *data, int n)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) != NULL)
+		setprop(fw, property, type, format, mode, data, n);
+	return 1;
+}
+
+int XDeleteProperty(Display *display, Window w, Atom property)
+{
+	struct fwin *fw;
+	struct prop **ppp, *pp;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(w)) == NULL)
+		return 1;
+	for (ppp = &fw->props; (pp = *ppp) != NULL; ppp = &pp->next)
+		if (pp->name == property) {
+			*ppp = pp->next;
+			FREE(pp->data);
+			FREE(pp);
+			break;
+		}
+	return 1;
+}
+
+int XGetWindowProperty(Display *display, Window w, Atom property,
+    long offset, long length, Bool delete, Atom req_type,
+    Atom *actual_type, int *actual_format, unsigned long *nitems,
+    unsigned long *bytes_after, unsigned char **prop)
+{
+	struct fwin *fw;
+	struct prop *pp;
+	unsigned long total, start, len;
+	int unit;
+
+	COUNT(ROUNDTRIP);
+	*actual_type = None;
+	*actual_format = 0;
+	*nitems = 0;
+	*bytes_after = 0;
+	*prop = NULL;
+	if ((fw = findwin(w)) == NULL)
+		return BadWindow;
+	if ((pp = findprop(fw, property)) == NULL)
+		return Success;
+
+	*actual_type = pp->type;
+	*actual_format = pp->format;
+	unit = pp->format / 8;
+	total = pp->nitems * unit;
+	if (req_type != AnyPropertyType && req_type != pp->type) {
+		*bytes_after = total;
+		return Success;
+	}
+	start = 4 * offset;
+	if (start > total)
+		return BadValue;
+	len = MIN(total - start, 4 * (unsigned long)length);
+	*nitems = len / unit;
+	*bytes_after = total - start - len;
+	*prop = MALLOC(*nitems * itemsize(pp->format) + 1);
+	memcpy(*prop, pp->data + start / unit * itemsize(pp->format),
+	    *nitems * itemsize(pp->format));
+	(*prop)[*nitems * itemsize(pp->format)] = '\0';
+	return Success;
+}
+
+/*
+ * Xutil.  Each of these reads one property, so it is one round trip.
+ */
+
+XSizeHints *XAllocSizeHints(void)
+{
+	XSizeHints *sz;
+
+	sz = MALLOC(sizeof *sz);
+	memset(sz, 0, sizeof *sz);
+	return sz;
+}
+
+static Status textprop(Window w, Atom name, XTextProperty *tp)
+{
+	struct fwin *fw;
+	struct prop *pp;
+
+	tp->value = NULL;
+	tp->encoding = None;
+	tp->format = 0;
+	tp->nitems = 0;
+	if ((fw = findwin(w)) == NULL || (pp = findprop(fw, name)) == NULL)
+		return 0;
+	tp->value = copyprop(w, name, AnyPropertyType, &tp->nitems);
+	tp->encoding = pp->type;
+	tp->format = pp->format;
+	return 1;
+}
+
+Status XGetWMName(Display *display, Window w, XTextProperty *tp)
+{
+	COUNT(ROUNDTRIP);
+	return textprop(w, XA_WM_NAME, tp);
+}
+
+Status XGetWMIconName(Display *display, Window w, XTextProperty *tp)
+{
+	COUNT(ROUNDTRIP);
+	return textprop(w, XA_WM_ICON_NAME, tp);
+}
+
+/*
+ * Everything is taken to be UTF-8 already.
+ */
+int Xutf8TextPropertyToTextList(Display *display, const XTextProperty *tp,
+    char ***list, int *count)
+{
+	COUNT(LOCAL);
+	*list = NULL;
+	*count = 0;
+	if (tp->format != 8)
+		return XConverterNotFound;
+	*list = MALLOC(sizeof (char *));
+	(*list)[0] = MALLOC(tp->nitems + 1);
+	memcpy((*list)[0], tp->value, tp->nitems);
+	(*list)[0][tp->nitems] = '\0';
+	*count = 1;
+	return Success;
+}
+
+Status XGetClassHint(Display *display, Window w, XClassHint *ch)
+{
+	unsigned long n;
+	char *s;
+	size_t len;
+
+	COUNT(ROUNDTRIP);
+	if ((s = copyprop(w, XA_WM_CLASS, XA_STRING, &n)) == NULL)
+		return 0;
+	len = strlen(s);
+	ch->res_name = STRDUP(s);
+	ch->res_class = STRDUP(len < n ? s + len + 1 : "");
+	FREE(s);
+	return 1;
+}
+
+XWMHints *XGetWMHints(Display *display, Window w)
+{
+	XWMHints *hints;
+	unsigned long n;
+	long *v;
+
+	COUNT(ROUNDTRIP);
+	if ((v = copyprop(w, XA_WM_HINTS, XA_WM_HINTS, &n)) == NULL)
+		return NULL;
+	if (n < 8) {
+		FREE(v);
+		return NULL;
+	}
+	hints = MALLOC(sizeof *hints);
+	hints->flags = v[0];
+	hints->input = v[1];
+	hints->initial_state = v[2];
+	hints->icon_pixmap = v[3];
+	hints->icon_window = v[4];
+	hints->icon_x = v[5];
+	hints->icon_y = v[6];
+	hints->icon_mask = v[7];
+	hints->window_group = n > 8 ? v[8] : None;
+	FREE(v);
+	return hints;
+}
+
+Status XGetWMNormalHints(Display *display, Window w, XSizeHints *hints,
+    long *supplied)
+{
+	unsigned long n;
+	long *v;
+
+	COUNT(ROUNDTRIP);
+	if ((v = copyprop(w, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, &n))
+	    == NULL)
+		return 0;
+	if (n < 18) {
+		FREE(v);
+		return 0;
+	}
+	hints->flags = v[0];
+	hints->x = v[1];
+	hints->y = v[2];
+	hints->width = v[3];
+	hints->height = v[4];
+	hints->min_width = v[5];
+	hints->min_height = v[6];
+	hints->max_width = v[7];
+	hints->max_height = v[8];
+	hints->width_inc = v[9];
+	hints->height_inc = v[10];
+	hints->min_aspect.x = v[11];
+	hints->min_aspect.y = v[12];
+	hints->max_aspect.x = v[13];
+	hints->max_aspect.y = v[14];
+	hints->base_width = v[15];
+	hints->base_height = v[16];
+	hints->win_gravity = v[17];
+	*supplied = v[0];
+	FREE(v);
+	return 1;
+}
+
+Status XGetTransientForHint(Display *display, Window w, Window *wp)
+{
+	unsigned long n;
+	long *v;
+
+	COUNT(ROUNDTRIP);
+	if ((v = copyprop(w, XA_WM_TRANSIENT_FOR, XA_WINDOW, &n)) == NULL)
+		return 0;
+	*wp = n > 0 ? (Window)v[0] : None;
+	FREE(v);
+	return n > 0;
+}
+
+Status XGetWMProtocols(Display *display, Window w, Atom **protocols,
+    int *count)
+{
+	unsigned long n;
+	long *v;
+
+	COUNT(ROUNDTRIP);
+	*protocols = NULL;
+	*count = 0;
+	if ((v = copyprop(w, XInternAtom(NULL, "WM_PROTOCOLS", False),
+	    XA_ATOM, &n)) == NULL)
+		return 0;
+	*protocols = (Atom *)v;
+	*count = n;
+	return 1;
+}
+
+/*
+ * Xrender
+ */
+
+XRenderPictFormat *XRenderFindStandardFormat(Display *display, int format)
+{
+	COUNT(LOCAL);
+	return &fakeformat;
+}
+
+Picture XRenderCreatePicture(Display *display, Drawable drawable,
+    const XRenderPictFormat *format, unsigned long valuemask,
+    const XRenderPictureAttributes *attributes)
+{
+	COUNT(REQUEST);
+	live[RES_PICTURE]++;
+	return newid();
+}
+
+void XRenderFreePicture(Display *display, Picture picture)
+{
+	COUNT(REQUEST);
+	live[RES_PICTURE]--;
+}
+
+void XRenderComposite(Display *display, int op, Picture src, Picture mask,
+    Picture dst, int src_x, int src_y, int mask_x, int mask_y,
+    int dst_x, int dst_y, unsigned width, unsigned height)
+{
+	COUNT(REQUEST);
+}
+
+#if CONFIG_THUMBNAILS
+Bool XRenderQueryExtension(Display *display, int *event_basep,
+    int *error_basep)
+{
+	COUNT(ROUNDTRIP);
+	*event_basep = 0;
+	*error_basep = 0;
+	return True;
+}
+
+XRenderPictFormat *XRenderFindVisualFormat(Display *display,
+    const Visual *visual)
+{
+	COUNT(LOCAL);
+	return &fakeformat;
+}
+
+void XRenderSetPictureTransform(Display *display, Picture picture,
+    XTransform *transform)
+{
+	COUNT(REQUEST);
+}
+
+void XRenderSetPictureFilter(Display *display, Picture picture,
+    const char *filter, XFixed *params, int nparams)
+{
+	COUNT(REQUEST);
+}
+
+/*
+ * Composite.  Redirection changes nothing here; a window's contents
+ * are just another pixmap id.
+ */
+
+Bool XCompositeQueryExtension(Display *display, int *event_basep,
+    int *error_basep)
+{
+	COUNT(ROUNDTRIP);
+	*event_basep = 0;
+	*error_basep = 0;
+	return True;
+}
+
+Status XCompositeQueryVersion(Display *display, int *major, int *minor)
+{
+	COUNT(ROUNDTRIP);
+	*major = 0;
+	*minor = 4;
+	return 1;
+}
+
+void XCompositeRedirectSubwindows(Display *display, Window w, int update)
+{
+	COUNT(REQUEST);
+}
+
+void XCompositeUnredirectSubwindows(Display *display, Window w,
+    int update)
+{
+	COUNT(REQUEST);
+}
+
+Pixmap XCompositeNameWindowPixmap(Display *display, Window w)
+{
+	COUNT(REQUEST);
+	live[RES_PIXMAP]++;
+	return newid();
+}
+
+/*
+ * Damage, at XDamageReportNonEmpty level only: one event when a
+ * window is drawn to, then none until the damage is subtracted.
+ */
+
+Bool XDamageQueryExtension(Display *display, int *event_basep,
+    int *error_basep)
+{
+	COUNT(ROUNDTRIP);
+	*event_basep = DAMAGEEVENTBASE;
+	*error_basep = 0;
+	return True;
+}
+
+Damage XDamageCreate(Display *display, Drawable d, int level)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = findwin(d)) == NULL)
+		return None;
+	fw->damage = newid();
+	fw->damaged = 0;
+	insert(fw->damage, DAMAGECONTEXT, fw);
+	live[RES_DAMAGE]++;
+	return fw->damage;
+}
+
+static struct fwin *finddamage(Damage damage)
+{
+	struct entry **epp;
+
+	if ((epp = lookup(damage, DAMAGECONTEXT)) == NULL) {
+		errors++;
+		return NULL;
+	}
+	return (*epp)->data;
+}
+
+void XDamageDestroy(Display *display, Damage damage)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = finddamage(damage)) == NULL)
+		return;
+	fw->damage = None;
+	delete(damage, DAMAGECONTEXT);
+	live[RES_DAMAGE]--;
+}
+
+void XDamageSubtract(Display *display, Damage damage,
+    XserverRegion repair, XserverRegion parts)
+{
+	struct fwin *fw;
+
+	COUNT(REQUEST);
+	if ((fw = finddamage(damage)) != NULL)
+		fw->damaged = 0;
+}
+#endif
+
+/*
+ * Xft.  Fonts are monospaced and have every character; glyphs are
+ * taken to be loaded already.
+ */
+
+XftDraw *XftDrawCreate(Display *display, Drawable drawable, Visual *visual,
+    Colormap colormap)
+{
+	XftDraw *draw;
+
+	COUNT(LOCAL);
+	draw = MALLOC(sizeof *draw);
+	draw->drawable = drawable;
+	draw->visual = visual;
+	draw->colormap = colormap;
+	draw->picture = None;
+	return draw;
+}
+
+void XftDrawDestroy(XftDraw *draw)
+{
+	if (draw->picture != None)
+		XRenderFreePicture(fakedisplay, draw->picture);
+	FREE(draw);
+}
+
+Drawable XftDrawDrawable(XftDraw *draw)
+{
+	return draw->drawable;
+}
+
+Visual *XftDrawVisual(XftDraw *draw)
+{
+	return draw->visual;
+}
+
+Picture XftDrawPicture(XftDraw *draw)
+{
+	if (draw->picture == None)
+		draw->picture = XRenderCreatePicture(fakedisplay,
+		    draw->drawable, &fakeformat, 0, NULL);
+	return draw->picture;
+}
+
+void XftDrawRect(XftDraw *draw, const XftColor *color, int x, int y,
+    unsigned width, unsigned height)
+{
+	COUNT(REQUEST);
+	XftDrawPicture(draw);
+}
+
+void XftDrawGlyphFontSpec(XftDraw *draw, const XftColor *color,
+    const XftGlyphFontSpec *glyphs, int len)
+{
+	COUNT(REQUEST);
+	XftDrawPicture(draw);
+}
+
+FcBool XftCharExists(Display *display, XftFont *font, FcChar32 ucs4)
+{
+	return FcTrue;
+}
+
+FT_UInt XftCharIndex(Display *display, XftFont *font, FcChar32 ucs4)
+{
+	return ucs4;
+}
+
+void XftGlyphExtents(Display *display, XftFont *font, const FT_UInt *glyphs,
+    int nglyphs, XGlyphInfo *extents)
+{
+	COUNT(LOCAL);
+	extents->x = 0;
+	extents->y = font->ascent;
+	extents->width = nglyphs * font->max_advance_width;
+	extents->height = font->ascent + font->descent;
+	extents->xOff = extents->width;
+	extents->yOff = 0;
+}
+
+FcPattern *XftFontMatch(Display *display, int screen,
+    const FcPattern *pattern, FcResult *result)
+{
+	*result = FcResultNoMatch;
+	return NULL;
+}
+
+XftFont *XftFontOpenPattern(Display *display, FcPattern *pattern)
+{
+	return NULL;
+}
+
+void XftFontClose(Display *display, XftFont *font)
+{
+}
@@ -0,0 +1,59 @@
+#if !defined(FAKEX_H)
+#define FAKEX_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <X11/Xlib.h>
+
+/*
+ * An in-memory stand-in for the X server, for benchmarking the window
+ * management code without one.  fakex.c defines the part of Xlib, Xft
+ * and Xrender that karmen uses; a program linked with it instead of
+ * those libraries runs window.c, widget.c, menu.c and the hint modules
+ * unchanged against a window tree kept in the same process.
+ *
+ * Windows keep their geometry, stacking order, map state and
+ * properties; other resources are only handed out ids.  Every call is
+ * counted, as the requests and round trips it would have cost on a
+ * real connection.  No events are generated, except DamageNotify by
+ * fakex_damage().
+ */
+
+/* Client window flags for fakex_client() */
+#define FAKEX_POSITION	(1 << 0)	/* program specified position */
+#define FAKEX_ICONIC	(1 << 1)	/* start iconified */
+#define FAKEX_DOCK	(1 << 2)	/* _NET_WM_WINDOW_TYPE_DOCK */
+
+Display *fakex_open(int, int);
+Window fakex_client(const char *, int, int, int, int, unsigned);
+int fakex_mapped(Window);
+void fakex_count(unsigned long *, unsigned long *);
+void fakex_reset(void);
+int fakex_alive(int, const char **, long *);
+#if CONFIG_THUMBNAILS
+int fakex_damage(Window, XEvent *);
+#endif
+void fakex_dump(FILE *);
+
+#endif /* !defined(FAKEX_H) */
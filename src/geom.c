@@ -0,0 +1,205 @@
+/*
+ * geom.c - frame geometry
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "geom.h"
+#include "lib.h"
+
+/*
+ * Where the reference point of each gravity (ICCCM 4.1.2.3) lies
+ * across the frame, in halves: 0 at the left or top edge, 1 in the
+ * middle, 2 at the right or bottom edge.  Static gravity keeps the
+ * client where it is and puts the frame around it instead.
+ */
+static const struct {
+	signed char x;
+	signed char y;
+	signed char stat;
+} gravity[StaticGravity + 1] = {
+	[ForgetGravity]		= { 0, 0, 0 },
+	[NorthWestGravity]	= { 0, 0, 0 },
+	[NorthGravity]		= { 1, 0, 0 },
+	[NorthEastGravity]	= { 2, 0, 0 },
+	[WestGravity]		= { 0, 1, 0 },
+	[CenterGravity]		= { 1, 1, 0 },
+	[EastGravity]		= { 2, 1, 0 },
+	[SouthWestGravity]	= { 0, 2, 0 },
+	[SouthGravity]		= { 1, 2, 0 },
+	[SouthEastGravity]	= { 2, 2, 0 },
+	[StaticGravity]		= { 0, 0, 1 },
+};
+
+#define VALIDGRAVITY(g) \
+	((unsigned)(g) <= StaticGravity ? (g) : NorthWestGravity)
+
+/*
+ * The decoration of a frame with the given border width and title
+ * height; undecorated frames have a title height of 0.
+ */
+void get_extents(struct extents *ep, int border, int title)
+{
+	ep->left = border;
+	ep->right = border;
+	ep->top = border + title;
+	ep->bottom = border;
+}
+
+int hint_gravity(const XSizeHints *hints)
+{
+	if (hints == NULL || (hints->flags & PWinGravity) == 0)
+		return NorthWestGravity;
+	return VALIDGRAVITY(hints->win_gravity);
+}
+
+/*
+ * The frame for a client of the given geometry and border width,
+ * placed so that the reference point of the gravity stays put.
+ */
+void client_to_frame(const struct extents *ep, int grav, int cborder,
+    const struct dim *client, struct dim *frame)
+{
+	int gx = gravity[VALIDGRAVITY(grav)].x;
+	int gy = gravity[VALIDGRAVITY(grav)].y;
+	int st = gravity[VALIDGRAVITY(grav)].stat;
+	int ew = EXTENTS_WIDTH(ep);
+	int eh = EXTENTS_HEIGHT(ep);
+
+	frame->x = client->x + (gx + st) * cborder - st * ep->left
+	    + gx * client->width / 2 - gx * (client->width + ew) / 2;
+	frame->y = client->y + (gy + st) * cborder - st * ep->top
+	    + gy * client->height / 2 - gy * (client->height + eh) / 2;
+	frame->width = client->width + ew;
+	frame->height = client->height + eh;
+}
+
+/*
+ * The inverse of client_to_frame().
+ */
+void frame_to_client(const struct extents *ep, int grav, int cborder,
+    const struct dim *frame, struct dim *client)
+{
+	int gx = gravity[VALIDGRAVITY(grav)].x;
+	int gy = gravity[VALIDGRAVITY(grav)].y;
+	int st = gravity[VALIDGRAVITY(grav)].stat;
+	int ew = EXTENTS_WIDTH(ep);
+	int eh = EXTENTS_HEIGHT(ep);
+
+	client->x = frame->x - (gx + st) * cborder + st * ep->left
+	    + gx * frame->width / 2 - gx * (frame->width - ew) / 2;
+	client->y = frame->y - (gy + st) * cborder + st * ep->top
+	    + gy * frame->height / 2 - gy * (frame->height - eh) / 2;
+	client->width = frame->width - ew;
+	client->height = frame->height - eh;
+}
+
+/*
+ * Frames always have room for at least one pixel of client.
+ */
+void limit_frame_size(const struct extents *ep, int *width, int *height)
+{
+	*width = MAX(*width, EXTENTS_WIDTH(ep) + 1);
+	*height = MAX(*height, EXTENTS_HEIGHT(ep) + 1);
+}
+
+/*
+ * Round a client size down to base + n * inc, keeping it at least min
+ * and 1.  Returns the size; n goes to *dim, or the size itself if
+ * there is no increment.
+ */
+static int fitinc(int size, int base, int min, int inc, int *dim)
+{
+	if (inc <= 0) {
+		*dim = size;
+		return size;
+	}
+	size -= base;
+	size -= size % inc;
+	size = MAX(size, min - base);
+	if (base + size < 1)
+		size += (1 - base - size + inc - 1) / inc * inc;
+	*dim = size / inc;
+	return base + size;
+}
+
+/*
+ * The frame size closest to width x height that the client's size
+ * hints allow.  The size in resize increments, as xterm would show
+ * it, goes to *xdim and *ydim.  Any of the results may be NULL.
+ */
+void frame_calcsize(const struct extents *ep, const XSizeHints *hints,
+    int width, int height, int *rwidth, int *rheight, int *xdim, int *ydim)
+{
+	long flags = hints->flags;
+	int minw = 0, minh = 0;
+	int basew = 0, baseh = 0;
+	int incw = 0, inch = 0;
+	int dx, dy;
+
+	limit_frame_size(ep, &width, &height);
+	width -= EXTENTS_WIDTH(ep);
+	height -= EXTENTS_HEIGHT(ep);
+
+	if (flags & PMaxSize) {
+		width = MIN(width, hints->max_width);
+		height = MIN(height, hints->max_height);
+	}
+
+	/* the base size stands in for a missing minimum, and vice versa */
+	if (flags & PMinSize) {
+		minw = hints->min_width;
+		minh = hints->min_height;
+	} else if (flags & PBaseSize) {
+		minw = hints->base_width;
+		minh = hints->base_height;
+	}
+	width = MAX(width, minw);
+	height = MAX(height, minh);
+	if (flags & PBaseSize) {
+		basew = hints->base_width;
+		baseh = hints->base_height;
+	} else if (flags & PMinSize) {
+		basew = hints->min_width;
+		baseh = hints->min_height;
+	}
+
+	if (flags & PResizeInc) {
+		incw = hints->width_inc;
+		inch = hints->height_inc;
+	}
+	width = fitinc(width, basew, minw, incw, &dx);
+	height = fitinc(height, baseh, minh, inch, &dy);
+
+	if (rwidth != NULL)
+		*rwidth = width + EXTENTS_WIDTH(ep);
+	if (rheight != NULL)
+		*rheight = height + EXTENTS_HEIGHT(ep);
+	if (xdim != NULL)
+		*xdim = dx;
+	if (ydim != NULL)
+		*ydim = dy;
+}
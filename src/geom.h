@@ -0,0 +1,58 @@
+#if !defined(GEOM_H)
+#define GEOM_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "widget.h"
+
+/*
+ * Frame geometry.  Everything here is arithmetic on its arguments:
+ * no X calls, no globals, no allocation, so it can be benchmarked
+ * and checked on its own.
+ */
+
+/* The decoration around a client, in pixels */
+struct extents {
+	int left;
+	int right;
+	int top;
+	int bottom;
+};
+
+#define EXTENTS_WIDTH(ep)	((ep)->left + (ep)->right)
+#define EXTENTS_HEIGHT(ep)	((ep)->top + (ep)->bottom)
+
+void get_extents(struct extents *, int, int);
+int hint_gravity(const XSizeHints *);
+void client_to_frame(const struct extents *, int, int,
+    const struct dim *, struct dim *);
+void frame_to_client(const struct extents *, int, int,
+    const struct dim *, struct dim *);
+void limit_frame_size(const struct extents *, int *, int *);
+void frame_calcsize(const struct extents *, const XSizeHints *, int, int,
+    int *, int *, int *, int *);
+
+#endif /* !defined(GEOM_H) */
@@ -0,0 +1,246 @@
+/*
+ * geombench.c - frame geometry microbenchmark
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Times the functions of geom.c on a table of inputs that covers every
+ * gravity, size hint combination and decoration, and prints one JSON
+ * object per function with the time per call.  Before timing, the
+ * results for the whole table are checked for what callers rely on:
+ * frame_to_client() undoes client_to_frame(), and frame_calcsize()
+ * returns sizes that the hints allow and that it leaves alone when
+ * asked again.  A failed check is reported and exits with status 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "geom.h"
+#include "lib.h"
+
+/* Hint flags that frame_calcsize() looks at */
+#define HINTFLAGS	(PMinSize | PMaxSize | PBaseSize | PResizeInc)
+
+/* Gravities, including a bad one and none at all */
+#define NGRAVITY	(StaticGravity + 3)
+
+/* Inputs of each combination */
+#define NSAMPLE		16
+
+struct input {
+	struct extents e;
+	XSizeHints hints;
+	int grav;
+	int cborder;
+	struct dim client;
+	int width;
+	int height;
+};
+
+static struct input *inputs;
+static int ninputs = 0;
+static int failed = 0;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void fail(const struct input *ip, const char *what)
+{
+	if (failed++ < 10)
+		fprintf(stderr, "karmen-geombench: %s "
+		    "(gravity %d, flags 0x%lx, extents %d %d %d %d, "
+		    "client %dx%d%+d%+d, size %dx%d)\n",
+		    what, ip->grav, ip->hints.flags,
+		    ip->e.left, ip->e.right, ip->e.top, ip->e.bottom,
+		    ip->client.width, ip->client.height,
+		    ip->client.x, ip->client.y, ip->width, ip->height);
+}
+
+/*
+ * Every gravity, every combination of hint flags, decorated or not,
+ * with random sizes.
+ */
+static void makeinputs(void)
+{
+	struct input *ip;
+	int g, flags, deco, i;
+
+	inputs = malloc(NGRAVITY * (HINTFLAGS + 1) * 2 * NSAMPLE
+	    * sizeof inputs[0]);
+	for (g = 0; g < NGRAVITY; g++)
+	for (flags = 0; flags <= HINTFLAGS; flags++) {
+		if (flags & ~HINTFLAGS)
+			continue;
+		for (deco = 0; deco < 2; deco++)
+		for (i = 0; i < NSAMPLE; i++) {
+			ip = &inputs[ninputs++];
+			memset(ip, 0, sizeof *ip);
+			get_extents(&ip->e, rand() % 4,
+			    deco ? 10 + rand() % 20 : 0);
+			ip->hints.flags = flags;
+			if (g < NGRAVITY - 1) {
+				ip->hints.flags |= PWinGravity;
+				ip->hints.win_gravity = g;
+			}
+			ip->hints.min_width = rand() % 200;
+			ip->hints.min_height = rand() % 200;
+			ip->hints.max_width = 1 + rand() % 1500;
+			ip->hints.max_height = 1 + rand() % 1500;
+			ip->hints.base_width = rand() % 50;
+			ip->hints.base_height = rand() % 50;
+			ip->hints.width_inc = rand() % 20;
+			ip->hints.height_inc = rand() % 20;
+			ip->grav = hint_gravity(&ip->hints);
+			ip->cborder = rand() % 4;
+			ip->client.x = rand() % 3000 - 1000;
+			ip->client.y = rand() % 3000 - 1000;
+			ip->client.width = 1 + rand() % 2000;
+			ip->client.height = 1 + rand() % 2000;
+			ip->width = rand() % 3000 - 100;
+			ip->height = rand() % 3000 - 100;
+		}
+	}
+}
+
+static void check(const struct input *ip)
+{
+	const XSizeHints *hp = &ip->hints;
+	struct dim frame, client;
+	int w, h, w2, h2, cw, ch;
+	int incw = hp->flags & PResizeInc ? hp->width_inc : 0;
+	int inch = hp->flags & PResizeInc ? hp->height_inc : 0;
+	int xdim, ydim;
+
+	client_to_frame(&ip->e, ip->grav, ip->cborder, &ip->client, &frame);
+	frame_to_client(&ip->e, ip->grav, ip->cborder, &frame, &client);
+	if (memcmp(&client, &ip->client, sizeof client) != 0)
+		fail(ip, "frame_to_client does not undo client_to_frame");
+	if (ip->grav == NorthWestGravity
+	    && (frame.x != ip->client.x || frame.y != ip->client.y))
+		fail(ip, "north west gravity moved the frame");
+	if (ip->grav == StaticGravity
+	    && (frame.x + ip->e.left != ip->client.x + ip->cborder
+	    || frame.y + ip->e.top != ip->client.y + ip->cborder))
+		fail(ip, "static gravity moved the client");
+
+	frame_calcsize(&ip->e, hp, ip->width, ip->height,
+	    &w, &h, &xdim, &ydim);
+	cw = w - EXTENTS_WIDTH(&ip->e);
+	ch = h - EXTENTS_HEIGHT(&ip->e);
+	if (cw < 1 || ch < 1)
+		fail(ip, "no room for the client");
+	if ((hp->flags & PMinSize)
+	    && (cw < hp->min_width || ch < hp->min_height))
+		fail(ip, "smaller than the minimum size");
+	/* a maximum below one increment is rounded up to it */
+	if ((hp->flags & PMaxSize) && !(hp->flags & PMinSize)
+	    && !(hp->flags & PBaseSize)
+	    && (cw > MAX(hp->max_width, MAX(incw, 1))
+	    || ch > MAX(hp->max_height, MAX(inch, 1))))
+		fail(ip, "larger than the maximum size");
+	if ((hp->flags & PResizeInc) && hp->width_inc > 0
+	    && !(hp->flags & PMinSize) && !(hp->flags & PBaseSize)
+	    && cw % hp->width_inc != 0)
+		fail(ip, "width not a multiple of the increment");
+	frame_calcsize(&ip->e, hp, w, h, &w2, &h2, NULL, NULL);
+	if (w2 != w || h2 != h)
+		fail(ip, "size changes when asked again");
+}
+
+static void report(const char *name, double ns, long sum)
+{
+	printf("{\"benchmark\": \"%s\", \"inputs\": %d, \"ns_per_op\": %.2f, "
+	    "\"sum\": %ld}\n", name, ninputs, ns, sum);
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+	struct dim frame, client;
+	double t;
+	long sum;
+	int rounds = 200;
+	int r, i, w, h, xdim, ydim;
+
+	if (argc > 1)
+		rounds = atoi(argv[1]);
+	if (rounds <= 0) {
+		fprintf(stderr, "usage: karmen-geombench [rounds]\n");
+		return 2;
+	}
+
+	srand(1);
+	makeinputs();
+	for (i = 0; i < ninputs; i++)
+		check(&inputs[i]);
+	if (failed) {
+		fprintf(stderr, "karmen-geombench: %d of %d checks failed\n",
+		    failed, ninputs);
+		return 1;
+	}
+
+	sum = 0;
+	t = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < ninputs; i++) {
+			client_to_frame(&inputs[i].e, inputs[i].grav,
+			    inputs[i].cborder, &inputs[i].client, &frame);
+			sum += frame.x + frame.y;
+		}
+	report("client_to_frame", (now() - t) / rounds / ninputs, sum);
+
+	sum = 0;
+	t = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < ninputs; i++) {
+			frame_to_client(&inputs[i].e, inputs[i].grav,
+			    inputs[i].cborder, &inputs[i].client, &client);
+			sum += client.x + client.y;
+		}
+	report("frame_to_client", (now() - t) / rounds / ninputs, sum);
+
+	sum = 0;
+	t = now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < ninputs; i++) {
+			frame_calcsize(&inputs[i].e, &inputs[i].hints,
+			    inputs[i].width, inputs[i].height,
+			    &w, &h, &xdim, &ydim);
+			sum += w + h + xdim + ydim;
+		}
+	report("frame_calcsize", (now() - t) / rounds / ninputs, sum);
+
+	return 0;
+}
@@ -27,6 +27,7 @@
 #include <X11/Xft/Xft.h>
 
 #include "lib.h"
+#include "text.h"
 
 #define DEFAULT_FONT	"sans:pixelsize=12"
 
@@ -53,6 +54,8 @@ extern int title_pad;
 
 extern struct window *active;
 
+extern int overloaded;
+
 extern struct menu *winmenu;
 
 #endif /* !defined(GLOBAL_H) */
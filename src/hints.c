@@ -29,6 +29,8 @@
 
 #include "hints.h"
 #include "lib.h"
+#include "trace.h"
+#include "xcount.h"
 
 extern struct hints icccm_hints;
 
@@ -44,13 +46,30 @@ static struct hints *hints[] = {
 #endif
 };
 
+/* What the X traffic of each of the above is charged to */
+static const int subsys[] = {
+	XC_ICCCM,
+
+#if CONFIG_EWMH
+	XC_EWMH,
+#endif
+};
+
+#define CALL(i, call)	do { \
+	XC_ENTER(subsys[i]); \
+	TRACE_BEGIN(TR_HINT, i); \
+	call; \
+	TRACE_END(TR_HINT); \
+	XC_LEAVE(); \
+} while (0)
+
 void hints_init(void)
 {
 	int i;
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->init != NULL)
-			hints[i]->init();
+			CALL(i, hints[i]->init());
 }
 
 void hints_fini(void)
@@ -59,7 +78,7 @@ void hints_fini(void)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->fini != NULL)
-			hints[i]->fini();
+			CALL(i, hints[i]->fini());
 }
 
 void hints_manage(struct window *win)
@@ -68,7 +87,7 @@ void hints_manage(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->manage != NULL)
-			hints[i]->manage(win);
+			CALL(i, hints[i]->manage(win));
 }
 
 void hints_unmanage(struct window *win)
@@ -77,7 +96,7 @@ void hints_unmanage(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->unmanage != NULL)
-			hints[i]->unmanage(win);
+			CALL(i, hints[i]->unmanage(win));
 }
 
 void hints_map(struct window *win)
@@ -86,7 +105,7 @@ void hints_map(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->map != NULL)
-			hints[i]->map(win);
+			CALL(i, hints[i]->map(win));
 }
 
 void hints_unmap(struct window *win)
@@ -95,7 +114,7 @@ void hints_unmap(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->unmap != NULL)
-			hints[i]->unmap(win);
+			CALL(i, hints[i]->unmap(win));
 }
 
 void hints_withdraw(struct window *win)
@@ -104,7 +123,7 @@ void hints_withdraw(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->withdraw != NULL)
-			hints[i]->withdraw(win);
+			CALL(i, hints[i]->withdraw(win));
 }
 
 void hints_activate(struct window *win)
@@ -113,7 +132,7 @@ void hints_activate(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->activate != NULL)
-			hints[i]->activate(win);
+			CALL(i, hints[i]->activate(win));
 }
 
 void hints_deactivate(struct window *win)
@@ -122,7 +141,7 @@ void hints_deactivate(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->deactivate != NULL)
-			hints[i]->deactivate(win);
+			CALL(i, hints[i]->deactivate(win));
 }
 
 void hints_move(struct window *win)
@@ -131,7 +150,7 @@ void hints_move(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->move != NULL)
-			hints[i]->move(win);
+			CALL(i, hints[i]->move(win));
 }
 
 void hints_resize(struct window *win)
@@ -140,7 +159,7 @@ void hints_resize(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->resize != NULL)
-			hints[i]->resize(win);
+			CALL(i, hints[i]->resize(win));
 }
 
 void hints_moveresize(struct window *win)
@@ -149,37 +168,43 @@ void hints_moveresize(struct window *win)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->moveresize != NULL)
-			hints[i]->moveresize(win);
+			CALL(i, hints[i]->moveresize(win));
 }
 
 void hints_clientmessage(struct window *win, XClientMessageEvent *ep)
 {
-	int i;
+	int i, done;
 
 	for (i = 0; i < NELEM(hints); i++)
-		if (hints[i]->clientmessage != NULL)
-			if (hints[i]->clientmessage(win, ep))
+		if (hints[i]->clientmessage != NULL) {
+			CALL(i, done = hints[i]->clientmessage(win, ep));
+			if (done)
 				return;
+		}
 }
 
 void hints_propertynotify(struct window *win, XPropertyEvent *ep)
 {
-	int i;
+	int i, done;
 
 	for (i = 0; i < NELEM(hints); i++)
-		if (hints[i]->propertynotify != NULL)
-			if (hints[i]->propertynotify(win, ep))
+		if (hints[i]->propertynotify != NULL) {
+			CALL(i, done = hints[i]->propertynotify(win, ep));
+			if (done)
 				return;
+		}
 }
 
 int hints_delete(struct window *win)
 {
-	int i;
+	int i, done;
 
 	for (i = 0; i < NELEM(hints); i++)
-		if (hints[i]->delete != NULL)
-			if (hints[i]->delete(win))
+		if (hints[i]->delete != NULL) {
+			CALL(i, done = hints[i]->delete(win));
+			if (done)
 				return 1;
+		}
 	return 0;
 }
 
@@ -189,5 +214,14 @@ void hints_restack(void)
 
 	for (i = 0; i < NELEM(hints); i++)
 		if (hints[i]->restack != NULL)
-			hints[i]->restack();
+			CALL(i, hints[i]->restack());
+}
+
+void hints_commit(void)
+{
+	int i;
+
+	for (i = 0; i < NELEM(hints); i++)
+		if (hints[i]->commit != NULL)
+			CALL(i, hints[i]->commit());
 }
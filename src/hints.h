@@ -86,6 +86,9 @@ struct hints {
 
 	/* Called after restacking windows */
 	void (*restack)(void);
+
+	/* Called when a batch of manages and unmanages is complete */
+	void (*commit)(void);
 };
 
 void hints_init(void);
@@ -104,5 +107,6 @@ void hints_clientmessage(struct window *, XClientMessageEvent *);
 void hints_propertynotify(struct window *, XPropertyEvent *);
 int hints_delete(struct window *);
 void hints_restack(void);
+void hints_commit(void);
 
 #endif /* !defined(HINTS_H) */
@@ -0,0 +1,96 @@
+/*
+ * hist.c - log-linear histograms
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "hist.h"
+
+static int bucketof(unsigned long v)
+{
+	int e;
+
+	if (v < HISTSUB)
+		return v;
+	if (v > 0xffffffffUL)
+		return HISTBUCKETS - 1;
+	for (e = 0; (v >> e) >= 2 * HISTSUB; e++)
+		;
+	/* e is now the shift that leaves HISTSUB..2*HISTSUB-1 */
+	return ((e + 1) << HISTSUBBITS) | ((v >> e) & (HISTSUB - 1));
+}
+
+/* The largest value that falls into bucket i */
+static unsigned long bucketmax(int i)
+{
+	int e;
+
+	if (i < HISTSUB)
+		return i;
+	e = (i >> HISTSUBBITS) - 1;
+	return (((unsigned long)(HISTSUB | (i & (HISTSUB - 1))) + 1) << e) - 1;
+}
+
+void hist_add(struct hist *hp, unsigned long v)
+{
+	hp->count++;
+	hp->sum += v;
+	if (v > hp->max)
+		hp->max = v;
+	hp->bucket[bucketof(v)]++;
+}
+
+/*
+ * Return the value below which the fraction q of all recorded values
+ * lie, rounded up to the top of its bucket but never above the maximum.
+ */
+unsigned long hist_percentile(const struct hist *hp, double q)
+{
+	unsigned long want, seen;
+	int i;
+
+	if (hp->count == 0)
+		return 0;
+	want = q * hp->count + 0.5;
+	if (want < 1)
+		want = 1;
+	seen = 0;
+	for (i = 0; i < HISTBUCKETS; i++) {
+		seen += hp->bucket[i];
+		if (seen >= want)
+			return bucketmax(i) < hp->max ? bucketmax(i) : hp->max;
+	}
+	return hp->max;
+}
+
+unsigned long hist_mean(const struct hist *hp)
+{
+	return hp->count == 0 ? 0 : hp->sum / hp->count;
+}
+
+void hist_reset(struct hist *hp)
+{
+	memset(hp, 0, sizeof *hp);
+}
@@ -0,0 +1,47 @@
+#if !defined(HIST_H)
+#define HIST_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Log-linear histograms in the style of HdrHistogram: every power of
+ * two is split into HISTSUB buckets, so any recorded value is known to
+ * within 1/HISTSUB of itself however large it is.
+ */
+#define HISTSUBBITS	3
+#define HISTSUB		(1 << HISTSUBBITS)
+#define HISTBUCKETS	((32 - HISTSUBBITS + 2) * HISTSUB)
+
+struct hist {
+	unsigned long count;
+	unsigned long long sum;
+	unsigned long max;
+	unsigned long bucket[HISTBUCKETS];
+};
+
+void hist_add(struct hist *, unsigned long);
+unsigned long hist_percentile(const struct hist *, double);
+unsigned long hist_mean(const struct hist *);
+void hist_reset(struct hist *);
+
+#endif /* !defined(HIST_H) */
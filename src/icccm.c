@@ -36,6 +36,7 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
+#include "geom.h"
 #include "global.h"
 #include "hints.h"
 #include "lib.h"
@@ -144,20 +145,23 @@ static int icccm_propertynotify(struct window *win, XPropertyEvent *ep)
 	switch (ep->atom) {
 	case XA_WM_NAME:
 		if (ep->state != PropertyDelete)
-			fetch_window_name(win);
+			mark_property_dirty(win, PROP_NAME);
 		return 1;
 	case XA_WM_ICON_NAME:
 		if (ep->state != PropertyDelete)
-			fetch_icon_name(win);
+			mark_property_dirty(win, PROP_ICONNAME);
+		return 1;
+	case XA_WM_CLASS:
+		mark_property_dirty(win, PROP_CLASS);
 		return 1;
 	case XA_WM_NORMAL_HINTS:
-		fetch_wm_normal_hints(win);
+		mark_property_dirty(win, PROP_NORMALHINTS);
 		return 1;
 	case XA_WM_HINTS:
-		fetch_wm_hints(win);
+		mark_property_dirty(win, PROP_HINTS);
 		return 1;
 	case XA_WM_TRANSIENT_FOR:
-		fetch_wm_transient_for_hint(win);
+		mark_property_dirty(win, PROP_TRANSIENTFOR);
 		return 1;
 	}
 	return 0;
@@ -212,14 +216,21 @@ static void sendmesg(struct window *win, Atom type, long value)
 static void sendconf(struct window *win)
 {
 	XConfigureEvent conf;
+	struct extents e;
+	struct dim client;
+
+	/* where the client really is, whatever its gravity */
+	window_extents(win, &e);
+	frame_to_client(&e, StaticGravity, win->cborder,
+	    &win->widget.dim, &client);
 
 	conf.type = ConfigureNotify;
 	conf.event = win->client;
 	conf.window = win->client;
-	conf.x = WIDGET_X(win) + border_width - win->cborder;
-	conf.y = WIDGET_Y(win) + border_width + button_size - win->cborder;
-	conf.width = WIDGET_WIDTH(win) - 2 * border_width;
-	conf.height = WIDGET_HEIGHT(win) - (2 * border_width + button_size);
+	conf.x = client.x;
+	conf.y = client.y;
+	conf.width = client.width;
+	conf.height = client.height;
 	conf.border_width = win->cborder;
 	conf.above = None;
 	conf.override_redirect = False;
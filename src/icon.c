@@ -0,0 +1,319 @@
+/*
+ * icon.c - _NET_WM_ICON cache
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xft/Xft.h>
+#include <X11/extensions/Xrender.h>
+
+#include "global.h"
+#include "icon.h"
+#include "lib.h"
+#include "stats.h"
+
+/* Clients sometimes ship bogus sizes; ignore anything beyond this */
+#define MAXICONSIZE	1024
+
+#define NBUCKET		64
+
+/* Icons by hash of their scaled pixels */
+static LIST bucket[NBUCKET];
+static int initialized = 0;
+static Atom NET_WM_ICON = None;
+
+static struct cachestats stats;
+
+/*
+ * 64-bit FNV-1a over the scaled pixels of an icon.
+ */
+static unsigned long long hashicon(const unsigned *pixels, int size)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	long i, n = (long)size * size;
+	int j;
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < 4; j++) {
+			h ^= (pixels[i] >> (8 * j)) & 0xff;
+			h *= 1099511628211ULL;
+		}
+	return h;
+}
+
+/*
+ * Read 'length' 32-bit items of _NET_WM_ICON at 'offset'.  Returns
+ * the number of items read, and in *after the number of bytes left
+ * beyond them.
+ */
+static long readicon(Window client, long offset, long length,
+    unsigned long **data, unsigned long *after)
+{
+	Atom type;
+	int format;
+	unsigned long n;
+	unsigned char *p = NULL;
+
+	*data = NULL;
+	clerr();
+	if (XGetWindowProperty(display, client, NET_WM_ICON, offset, length,
+	    False, XA_CARDINAL, &type, &format, &n, after, &p) != Success) {
+		sterr();
+		return 0;
+	}
+	sterr();
+	if (type != XA_CARDINAL || format != 32) {
+		if (p != NULL)
+			XFree(p);
+		return 0;
+	}
+	*data = (unsigned long *)p;
+	return n;
+}
+
+/*
+ * Find the offset of the best of the icons in _NET_WM_ICON for
+ * drawing at the given size: the smallest that is not smaller,
+ * or else the largest.  Only the width and height of each icon
+ * are read, not the pixels.
+ */
+static long choosesize(Window client, int size, int *wp, int *hp)
+{
+	unsigned long *hdr;
+	unsigned long after;
+	long offset, best = -1;
+	int w, h, bw = 0, bh = 0;
+
+	for (offset = 0;; offset += 2 + (long)w * h) {
+		if (readicon(client, offset, 2, &hdr, &after) < 2) {
+			if (hdr != NULL)
+				XFree(hdr);
+			break;
+		}
+		w = hdr[0];
+		h = hdr[1];
+		XFree(hdr);
+		if (w <= 0 || h <= 0 || w > MAXICONSIZE || h > MAXICONSIZE ||
+		    (unsigned long)w * h * 4 > after)
+			break;
+		if (best == -1 ||
+		    (MAX(bw, bh) < size && MAX(w, h) > MAX(bw, bh)) ||
+		    (MAX(w, h) >= size && MAX(w, h) < MAX(bw, bh))) {
+			best = offset;
+			bw = w;
+			bh = h;
+		}
+		if ((unsigned long)w * h * 4 == after)
+			break;
+	}
+	*wp = bw;
+	*hp = bh;
+	return best;
+}
+
+/*
+ * Scale the ARGB pixels to a size x size square, box filtered and
+ * with premultiplied alpha as Render wants.
+ */
+static unsigned *scale(unsigned long *data, int width, int height,
+    int size)
+{
+	unsigned long p, sum[4];
+	int x, y, sx, sy, x0, x1, y0, y1, n, i;
+	unsigned a, *pixels;
+
+	pixels = MALLOC(size * size * sizeof pixels[0]);
+	for (y = 0; y < size; y++) {
+		y0 = y * height / size;
+		y1 = MAX(y0 + 1, (y + 1) * height / size);
+		for (x = 0; x < size; x++) {
+			x0 = x * width / size;
+			x1 = MAX(x0 + 1, (x + 1) * width / size);
+			memset(sum, 0, sizeof sum);
+			n = 0;
+			for (sy = y0; sy < y1; sy++)
+				for (sx = x0; sx < x1; sx++) {
+					p = data[sy * width + sx];
+					a = (p >> 24) & 0xff;
+					sum[0] += a;
+					for (i = 1; i < 4; i++)
+						sum[i] += ((p >> (24 - 8 * i))
+						    & 0xff) * a / 255;
+					n++;
+				}
+			pixels[y * size + x] =
+			    (sum[0] / n) << 24 | (sum[1] / n) << 16 |
+			    (sum[2] / n) << 8 | (sum[3] / n);
+		}
+	}
+	return pixels;
+}
+
+static Picture mkpicture(const unsigned *pixels, int size)
+{
+	XRenderPictFormat *format;
+	XImage *image;
+	Picture picture;
+	Pixmap pixmap;
+	GC gc;
+	int x, y;
+	char *buf;
+
+	buf = MALLOC(size * size * 4);
+	image = XCreateImage(display, DefaultVisual(display, screen), 32,
+	    ZPixmap, 0, buf, size, size, 32, 0);
+	for (y = 0; y < size; y++)
+		for (x = 0; x < size; x++)
+			XPutPixel(image, x, y, pixels[y * size + x]);
+
+	pixmap = XCreatePixmap(display, root, size, size, 32);
+	gc = XCreateGC(display, pixmap, 0, NULL);
+	XPutImage(display, pixmap, gc, image, 0, 0, 0, 0, size, size);
+	XFreeGC(display, gc);
+	/* the pixels are ours, so they are not left to XDestroyImage */
+	image->data = NULL;
+	XDestroyImage(image);
+	FREE(buf);
+
+	format = XRenderFindStandardFormat(display, PictStandardARGB32);
+	picture = XRenderCreatePicture(display, pixmap, format, 0, NULL);
+	XFreePixmap(display, pixmap);
+	XRES_HOLD(XRES_PICTURE);
+	return picture;
+}
+
+/*
+ * Get the client's icon for drawing at size x size pixels, or NULL
+ * if it has none.  Only the chosen icon's pixels are transferred,
+ * and windows with identical icons share one picture.
+ */
+struct icon *fetch_icon(Window client, int size)
+{
+	struct icon *icon;
+	unsigned long *data;
+	unsigned long after;
+	unsigned long long hash;
+	unsigned *pixels;
+	long offset;
+	int width, height, i;
+	LIST *lp;
+
+	if (!initialized) {
+		for (i = 0; i < NBUCKET; i++)
+			LIST_INIT(&bucket[i]);
+		NET_WM_ICON = XInternAtom(display, "_NET_WM_ICON", False);
+		initialized = 1;
+	}
+
+	if ((offset = choosesize(client, size, &width, &height)) == -1)
+		return NULL;
+	if (readicon(client, offset + 2, (long)width * height,
+	    &data, &after) < (long)width * height) {
+		if (data != NULL)
+			XFree(data);
+		return NULL;
+	}
+
+	pixels = scale(data, width, height, size);
+	XFree(data);
+
+	/* the hash only picks the candidates, the pixels decide */
+	hash = hashicon(pixels, size);
+	LIST_FOREACH(lp, &bucket[hash % NBUCKET]) {
+		icon = LIST_ITEM(lp, struct icon, link);
+		if (icon->hash == hash && icon->size == size &&
+		    memcmp(icon->pixels, pixels,
+		    size * size * sizeof pixels[0]) == 0) {
+			icon->refs++;
+			FREE(pixels);
+			stats.hits++;
+			return icon;
+		}
+	}
+
+	icon = MALLOC(sizeof (struct icon));
+	icon->hash = hash;
+	icon->size = size;
+	icon->pixels = pixels;
+	icon->picture = mkpicture(pixels, size);
+	icon->refs = 1;
+	LIST_INSERT_HEAD(&bucket[hash % NBUCKET], &icon->link);
+	stats.misses++;
+	stats.entries++;
+	debug("new %dx%d icon (%016llx)", width, height, hash);
+	return icon;
+}
+
+void release_icon(struct icon *icon)
+{
+	if (icon == NULL || --icon->refs > 0)
+		return;
+	LIST_REMOVE(&icon->link);
+	XRenderFreePicture(display, icon->picture);
+	XRES_DROP(XRES_PICTURE);
+	FREE(icon->pixels);
+	FREE(icon);
+	stats.entries--;
+}
+
+/*
+ * Hits are windows that share an icon with another window.
+ */
+const struct cachestats *icon_cache_stats(void)
+{
+	return &stats;
+}
+
+void draw_icon(struct icon *icon, XftDraw *draw, int x, int y)
+{
+	XRenderComposite(display, PictOpOver, icon->picture, None,
+	    XftDrawPicture(draw), 0, 0, 0, 0, x, y, icon->size, icon->size);
+}
+
+/*
+ * Free icons left over by windows that were never unmanaged.
+ */
+void icon_fini(void)
+{
+	struct icon *icon;
+	LIST *lp;
+	int i;
+
+	if (!initialized)
+		return;
+	for (i = 0; i < NBUCKET; i++)
+		while ((lp = LIST_HEAD(&bucket[i])) != NULL) {
+			icon = LIST_ITEM(lp, struct icon, link);
+			LIST_REMOVE(&icon->link);
+			XRenderFreePicture(display, icon->picture);
+			XRES_DROP(XRES_PICTURE);
+			FREE(icon->pixels);
+			FREE(icon);
+			stats.entries--;
+		}
+}
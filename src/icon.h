@@ -0,0 +1,51 @@
+#if !defined(ICON_H)
+#define ICON_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+#include <X11/extensions/Xrender.h>
+
+#include "list.h"
+
+/*
+ * A client icon scaled to the size it is drawn at.  Icons are shared
+ * by every window whose _NET_WM_ICON scales to the same pixels.
+ */
+struct icon {
+	unsigned long long hash;
+	int size;		/* width and height as drawn */
+	unsigned *pixels;	/* size x size, premultiplied ARGB */
+	Picture picture;
+	int refs;
+	LIST link;
+};
+
+struct icon *fetch_icon(Window, int);
+void release_icon(struct icon *);
+const struct cachestats *icon_cache_stats(void);
+void draw_icon(struct icon *, XftDraw *, int, int);
+void icon_fini(void);
+
+#endif /* !defined(ICON_H) */
@@ -0,0 +1,295 @@
+/*
+ * karmenctl.c - read statistics from a running karmen
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * "karmenctl stats" prints one snapshot of the statistics that karmen
+ * serves on its socket.  With -i, a snapshot is printed every so many
+ * seconds, with the rate per second of each counter since the last.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct entry {
+	char *name;
+	double value;
+};
+
+struct snapshot {
+	char *text;
+	struct entry *stats;
+	int nstats;
+};
+
+static void *xmalloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "karmenctl: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL) {
+		fprintf(stderr, "karmenctl: out of memory\n");
+		exit(1);
+	}
+	return p;
+}
+
+/*
+ * The same path as stats_path() in karmen.
+ */
+static char *sockpath(const char *displayname)
+{
+	const char *dir;
+	char *path, *p;
+	size_t len;
+
+	if ((dir = getenv("XDG_RUNTIME_DIR")) == NULL || *dir == '\0')
+		dir = "/tmp";
+	len = strlen(dir) + strlen(displayname) + 32;
+	path = xmalloc(len);
+	snprintf(path, len, "%s/karmen-%d-", dir, (int)getuid());
+	for (p = path + strlen(path); *displayname != '\0'; displayname++)
+		*p++ = *displayname == '/' ? '_' : *displayname;
+	*p = '\0';
+	return path;
+}
+
+/*
+ * Read a whole snapshot.  Returns NULL with a message on failure.
+ */
+static char *fetch(const char *path)
+{
+	struct sockaddr_un addr;
+	char *buf;
+	size_t len, lim;
+	ssize_t n;
+	int fd;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof addr.sun_path) {
+		fprintf(stderr, "karmenctl: path too long: %s\n", path);
+		return NULL;
+	}
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof addr) == -1) {
+		fprintf(stderr, "karmenctl: %s: %s\n", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return NULL;
+	}
+
+	len = 0;
+	lim = 16384;
+	buf = xmalloc(lim);
+	for (;;) {
+		if (len + 1 == lim)
+			buf = xrealloc(buf, lim *= 2);
+		n = read(fd, buf + len, lim - len - 1);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += n;
+	}
+	close(fd);
+	if (n == -1) {
+		fprintf(stderr, "karmenctl: %s: %s\n", path, strerror(errno));
+		free(buf);
+		return NULL;
+	}
+	buf[len] = '\0';
+	return buf;
+}
+
+/*
+ * Split "name value" lines into a snapshot; the text is taken over.
+ */
+static void parse(struct snapshot *sp, char *text)
+{
+	char *line, *next, *value;
+	int lim = 0;
+
+	sp->text = text;
+	sp->stats = NULL;
+	sp->nstats = 0;
+	for (line = text; *line != '\0'; line = next) {
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		if ((value = strchr(line, ' ')) == NULL)
+			continue;
+		*value++ = '\0';
+		if (sp->nstats == lim) {
+			lim = lim == 0 ? 256 : 2 * lim;
+			sp->stats = xrealloc(sp->stats,
+			    lim * sizeof sp->stats[0]);
+		}
+		sp->stats[sp->nstats].name = line;
+		sp->stats[sp->nstats].value = strtod(value, NULL);
+		sp->nstats++;
+	}
+}
+
+static void freesnapshot(struct snapshot *sp)
+{
+	free(sp->text);
+	free(sp->stats);
+	sp->text = NULL;
+	sp->stats = NULL;
+	sp->nstats = 0;
+}
+
+/*
+ * Find a statistic, looking where it was in the last snapshot first
+ * since the order rarely changes.
+ */
+static struct entry *lookup(struct snapshot *sp, const char *name, int hint)
+{
+	int i;
+
+	if (hint < sp->nstats && strcmp(sp->stats[hint].name, name) == 0)
+		return &sp->stats[hint];
+	for (i = 0; i < sp->nstats; i++)
+		if (strcmp(sp->stats[i].name, name) == 0)
+			return &sp->stats[i];
+	return NULL;
+}
+
+static int iscounter(const char *name)
+{
+	size_t len = strlen(name);
+
+	return len > 6 && strcmp(name + len - 6, "_total") == 0;
+}
+
+static void print(struct snapshot *sp, struct snapshot *prev)
+{
+	struct entry *s, *p, *up, *produp;
+	double secs = 0;
+	int i;
+
+	if (prev != NULL && (up = lookup(sp, "uptime_ms", 0)) != NULL &&
+	    (produp = lookup(prev, "uptime_ms", 0)) != NULL &&
+	    up->value > produp->value)
+		secs = (up->value - produp->value) / 1000;
+
+	for (i = 0; i < sp->nstats; i++) {
+		s = &sp->stats[i];
+		if (secs > 0 && iscounter(s->name) &&
+		    (p = lookup(prev, s->name, i)) != NULL)
+			printf("%s %.0f %.1f/s\n", s->name, s->value,
+			    (s->value - p->value) / secs);
+		else
+			printf("%s %.0f\n", s->name, s->value);
+	}
+	fflush(stdout);
+}
+
+static void usage(FILE *fp)
+{
+	fprintf(fp,
+"usage: karmenctl [-display name] [-s socket] stats [-i seconds]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct snapshot cur, prev;
+	char *dpyname = NULL;
+	char *path = NULL;
+	char *text;
+	int i, interval = 0;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-display") == 0 && i + 1 < argc)
+			dpyname = argv[++i];
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			path = argv[++i];
+		else if (strcmp(argv[i], "-help") == 0) {
+			usage(stdout);
+			return 0;
+		} else {
+			usage(stderr);
+			return 2;
+		}
+	}
+	if (i == argc || strcmp(argv[i], "stats") != 0) {
+		usage(stderr);
+		return 2;
+	}
+	for (i++; i < argc; i++) {
+		if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			interval = atoi(argv[++i]);
+		else {
+			usage(stderr);
+			return 2;
+		}
+	}
+
+	if (path == NULL) {
+		if (dpyname == NULL && (dpyname = getenv("DISPLAY")) == NULL) {
+			fprintf(stderr, "karmenctl: no display\n");
+			return 1;
+		}
+		path = sockpath(dpyname);
+	}
+
+	if (interval <= 0) {
+		if ((text = fetch(path)) == NULL)
+			return 1;
+		fputs(text, stdout);
+		free(text);
+		return 0;
+	}
+
+	memset(&prev, 0, sizeof prev);
+	for (;;) {
+		if ((text = fetch(path)) == NULL)
+			return 1;
+		parse(&cur, text);
+		if (prev.text != NULL)
+			putchar('\n');
+		print(&cur, prev.text != NULL ? &prev : NULL);
+		freesnapshot(&prev);
+		prev = cur;
+		sleep(interval);
+	}
+}
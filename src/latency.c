@@ -0,0 +1,309 @@
+/*
+ * latency.c - event latency histograms and main loop watchdog
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Every event is stamped when it is taken off the connection, and the
+ * time from there until its handler returns goes into a histogram for
+ * its type and one for the widget that handled it.  The main loop
+ * marks the start of each iteration and of each step within it, so an
+ * iteration that runs past the watchdog threshold can be reported
+ * along with the step and the single event that took longest.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "global.h"
+#include "hist.h"
+#include "latency.h"
+#include "widget.h"
+
+/* Event types past the core protocol share the last histogram */
+#define NTYPES		(LASTEvent + 1)
+
+#define NHANDLER	(WIDGET_PREVIEW + 2)
+
+/* Stalls kept for the report, longest first */
+#define NWORST		8
+
+/* Least time between two stall messages (us) */
+#define REPORTGAP	1000000LL
+
+struct stall {
+	time_t when;
+	long long us;
+	const char *step;	/* longest step of the iteration */
+	long long stepus;
+	int type;		/* slowest event, -1 if none */
+	int handler;
+	long long eventus;
+};
+
+static const char *handlers[NHANDLER] = {
+	[WIDGET_ANY] = "root",
+	[WIDGET_WINDOW] = "window",
+	[WIDGET_TITLE] = "title",
+	[WIDGET_BUTTON] = "button",
+	[WIDGET_MENU] = "menu",
+	[WIDGET_RESIZER] = "resizer",
+	[WIDGET_SIZEWIN] = "sizewin",
+	[WIDGET_PREVIEW] = "preview",
+	[NHANDLER - 1] = "extension",
+};
+
+static struct hist bytype[NTYPES];
+static struct hist byhandler[NHANDLER];
+static struct hist iterations;
+
+/* Iterations longer than this are stalls (us), 0 for none */
+static long long watchdog = 0;
+
+static struct stall worst[NWORST];
+static int nworst = 0;
+static unsigned long stalls = 0;
+
+/* The iteration in progress; iterstart is 0 while idle */
+static long long iterstart = 0;
+static long long stepstart;
+static const char *step;
+static struct stall cur;
+
+static long long lastreport = 0;
+static unsigned long unreported = 0;
+
+/*
+ * Set the watchdog threshold in ms, 0 to turn it off.
+ */
+void latency_init(long ms)
+{
+	watchdog = ms * 1000LL;
+}
+
+/*
+ * Record an event of the given type, handled by a widget of the given
+ * type (or HANDLER_EXTENSION), that was received at the first time
+ * and whose handler was called at the second.
+ */
+void latency_event(int type, int handler, long long received,
+    long long started)
+{
+	long long now = now_us();
+
+	if (type < 0 || type >= LASTEvent)
+		type = NTYPES - 1;
+	if (handler < 0 || handler >= NHANDLER - 1)
+		handler = NHANDLER - 1;
+
+	hist_add(&bytype[type], now - received);
+	hist_add(&byhandler[handler], now - received);
+
+	if (iterstart != 0 && now - started > cur.eventus) {
+		cur.eventus = now - started;
+		cur.type = type;
+		cur.handler = handler;
+	}
+}
+
+static void describe(char *buf, size_t size, const struct stall *sp)
+{
+	int n;
+
+	n = snprintf(buf, size, "%lldms, %lldms of it in %s", sp->us / 1000,
+	    sp->stepus / 1000, sp->step);
+	if (sp->type != -1 && n >= 0 && n < size)
+		snprintf(buf + n, size - n, ", slowest event %s for %s (%lldms)",
+		    sp->type < LASTEvent ? eventname(sp->type) : "extension",
+		    handlers[sp->handler], sp->eventus / 1000);
+}
+
+static void stalled(long long now)
+{
+	char buf[160];
+	int i;
+
+	stalls++;
+	cur.when = time(NULL);
+
+	/* keep the longest few */
+	for (i = nworst; i > 0 && worst[i - 1].us < cur.us; i--)
+		if (i < NWORST)
+			worst[i] = worst[i - 1];
+	if (i < NWORST) {
+		worst[i] = cur;
+		nworst = MIN(nworst + 1, NWORST);
+	}
+
+	if (now - lastreport < REPORTGAP) {
+		unreported++;
+		return;
+	}
+	describe(buf, sizeof buf, &cur);
+	if (unreported > 0)
+		error("main loop stalled for %s (and %lu more since the "
+		    "last report)", buf, unreported);
+	else
+		error("main loop stalled for %s", buf);
+	lastreport = now;
+	unreported = 0;
+}
+
+static void endstep(long long now)
+{
+	if (now - stepstart > cur.stepus) {
+		cur.stepus = now - stepstart;
+		cur.step = step;
+	}
+}
+
+static void enditeration(long long now)
+{
+	endstep(now);
+	cur.us = now - iterstart;
+	hist_add(&iterations, cur.us);
+	if (watchdog > 0 && cur.us >= watchdog)
+		stalled(now);
+	iterstart = 0;
+}
+
+/*
+ * Mark the start of a main loop iteration.
+ */
+void loop_begin(void)
+{
+	long long now = now_us();
+
+	if (iterstart != 0)
+		enditeration(now);
+	memset(&cur, 0, sizeof cur);
+	cur.type = -1;
+	cur.step = "events";
+	iterstart = stepstart = now;
+	step = "events";
+}
+
+/*
+ * Mark the start of a step within the current iteration.  The name
+ * must be a string constant.
+ */
+void loop_phase(const char *name)
+{
+	long long now = now_us();
+
+	if (iterstart == 0)
+		return;
+	endstep(now);
+	step = name;
+	stepstart = now;
+}
+
+/*
+ * Mark the end of the current iteration, before waiting for events.
+ */
+void loop_idle(void)
+{
+	if (iterstart != 0)
+		enditeration(now_us());
+}
+
+static void dumphist(FILE *fp, const char *what, const char *name,
+    const struct hist *hp)
+{
+	fprintf(fp, "latency %s=%s count=%lu mean=%lu p50=%lu p90=%lu "
+	    "p99=%lu max=%lu\n", what, name, hp->count, hist_mean(hp),
+	    hist_percentile(hp, .50), hist_percentile(hp, .90),
+	    hist_percentile(hp, .99), hp->max);
+}
+
+/*
+ * Write all histograms, in microseconds, and the worst stalls.
+ */
+void latency_dump(FILE *fp)
+{
+	char buf[160], date[32];
+	int i;
+
+	for (i = 0; i < NTYPES; i++)
+		if (bytype[i].count > 0)
+			dumphist(fp, "event", i < LASTEvent ?
+			    eventname(i) : "extension", &bytype[i]);
+	for (i = 0; i < NHANDLER; i++)
+		if (byhandler[i].count > 0)
+			dumphist(fp, "handler", handlers[i], &byhandler[i]);
+	dumphist(fp, "loop", "iteration", &iterations);
+
+	fprintf(fp, "stalls %lu over %lldms\n", stalls, watchdog / 1000);
+	for (i = 0; i < nworst; i++) {
+		strftime(date, sizeof date, "%Y-%m-%d %H:%M:%S",
+		    localtime(&worst[i].when));
+		describe(buf, sizeof buf, &worst[i]);
+		fprintf(fp, "stall %s %s\n", date, buf);
+	}
+	fflush(fp);
+}
+
+/*
+ * Return the histogram for the i'th event type or handler, and its
+ * name, or NULL past the last one.
+ */
+const struct hist *latency_by_event(int i, const char **namep)
+{
+	if (i < 0 || i >= NTYPES)
+		return NULL;
+	*namep = i < LASTEvent ? eventname(i) : "extension";
+	return &bytype[i];
+}
+
+const struct hist *latency_by_handler(int i, const char **namep)
+{
+	if (i < 0 || i >= NHANDLER)
+		return NULL;
+	*namep = handlers[i];
+	return &byhandler[i];
+}
+
+const struct hist *latency_iterations(void)
+{
+	return &iterations;
+}
+
+unsigned long latency_stalls(void)
+{
+	return stalls;
+}
+
+void latency_reset(void)
+{
+	int i;
+
+	for (i = 0; i < NTYPES; i++)
+		hist_reset(&bytype[i]);
+	for (i = 0; i < NHANDLER; i++)
+		hist_reset(&byhandler[i]);
+	hist_reset(&iterations);
+	nworst = 0;
+	stalls = 0;
+}
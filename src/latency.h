@@ -0,0 +1,43 @@
+#if !defined(LATENCY_H)
+#define LATENCY_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+
+/* Handler of events that belong to an extension, not to a widget */
+#define HANDLER_EXTENSION	(-1)
+
+void latency_init(long);
+void latency_event(int, int, long long, long long);
+void loop_begin(void);
+void loop_phase(const char *);
+void loop_idle(void);
+const struct hist *latency_by_event(int, const char **);
+const struct hist *latency_by_handler(int, const char **);
+const struct hist *latency_iterations(void);
+unsigned long latency_stalls(void);
+void latency_dump(FILE *);
+void latency_reset(void);
+
+#endif /* !defined(LATENCY_H) */
@@ -25,10 +25,14 @@
  */
 
 #include <assert.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <X11/Xlib.h>
@@ -36,6 +40,7 @@
 
 #include "global.h"
 #include "lib.h"
+#include "stats.h"
 #include "widget.h"
 
 void error(const char *fmt, ...)
@@ -64,10 +69,56 @@ void debug(const char *fmt, ...)
 #endif
 }
 
+/*
+ * Monotonic time, for timers, budgets and latencies.
+ */
+long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/*
+ * Fill a rectangle.  Drawables of the default visual get a plain core
+ * fill; only ARGB drawables need XRender to get the alpha right.
+ */
+void fillrect(XftDraw *xftdraw, XftColor *color, int x, int y,
+    int width, int height)
+{
+	static GC gc = None;
+	static unsigned long fg;
+
+	if (XftDrawVisual(xftdraw) != DefaultVisual(display, screen)) {
+		XftDrawRect(xftdraw, color, x, y, width, height);
+		return;
+	}
+	if (gc == None) {
+		gc = XCreateGC(display, root, 0, NULL);
+		XRES_HOLD(XRES_GC);
+		fg = ~color->pixel;
+	}
+	if (fg != color->pixel) {
+		fg = color->pixel;
+		XSetForeground(display, gc, fg);
+	}
+	XFillRectangle(display, XftDrawDrawable(xftdraw), gc,
+	    x, y, width, height);
+}
+
 void unmapDraw(XftDraw *xftdraw, XftColor color, int x, int y, int width, int height) {
 	int y1 = y + (height - 4)/2;
 	int x1 = x + (width - (width - 4))/2;
-	XftDrawRect(xftdraw, &color, x1, y1, width-4, 4);
+	fillrect(xftdraw, &color, x1, y1, width-4, 4);
 	//XGlyphInfo ext;
         //XftTextExtentsUtf8(display, xftfont, "<", 1, &ext);
         //int y1 = y + height-(height - ext.height)/2;
@@ -78,7 +129,7 @@ void unmapDraw(XftDraw *xftdraw, XftColor color, int x, int y, int width, int he
 void closeDraw(XftDraw *xftdraw, XftColor color, int x, int y, int width, int height) {
 	int y1 = y + (height - (height -6))/2;
 	int x1 = x + (width - (width - 6))/2;
-	XftDrawRect(xftdraw, &color, x1, y1, width-6, height-6);
+	fillrect(xftdraw, &color, x1, y1, width-6, height-6);
 
 	//XGlyphInfo ext;
 	//XftTextExtentsUtf8(display, xftfont, "#", 1, &ext);
@@ -89,31 +140,42 @@ void closeDraw(XftDraw *xftdraw, XftColor color, int x, int y, int width, int he
 
 
 
-int stringwidth(const char *str)
-{
-         XGlyphInfo ch;
-        int direction;
-        int ascent;
-        int descent;
+/*
+ * Everything allocated through MALLOC, REALLOC and STRDUP is counted
+ * until it is passed to FREE, so a leak shows as growth in the
+ * statistics.  Memory from Xlib is not counted, and must not be
+ * passed to FREE, nor ours to XFree.
+ */
+static struct heapstats heap;
 
-        XftTextExtents8(display, xftfont, (XftChar8 *)(str), strlen(str), &ch);
-        return ch.width;
+static size_t blocksize(void *ptr)
+{
+#if defined(__GLIBC__)
+	return malloc_usable_size(ptr);
+#else
+	return 0;
+#endif
 }
 
-char *stringfit(char *str, int width)
+static void hold(void *ptr)
 {
-	int len;
+	if (ptr != NULL) {
+		heap.blocks++;
+		heap.bytes += blocksize(ptr);
+	}
+}
 
-	len = strlen(str);
-	while (stringwidth(str) > width) {
-		if (len < 3) {
-			str[0] = '\0';
-			break;
-		}
-		strcpy(str + len - 3, "...");
-		len--;
+static void drop(void *ptr)
+{
+	if (ptr != NULL) {
+		heap.blocks--;
+		heap.bytes -= blocksize(ptr);
 	}
-	return str;
+}
+
+const struct heapstats *heap_stats(void)
+{
+	return &heap;
 }
 
 void *MALLOC(size_t size)
@@ -122,6 +184,8 @@ void *MALLOC(size_t size)
 
 	while ((ptr = malloc(size)) == NULL && size != 0)
 		sleep(1);
+	hold(ptr);
+	heap.allocs++;
 	return ptr;
 }
 
@@ -129,13 +193,19 @@ void *REALLOC(void *optr, size_t size)
 {
 	void *nptr;
 
+	drop(optr);
 	while ((nptr = realloc(optr, size)) == NULL && size != 0)
 		sleep(1);
+	hold(nptr);
+	heap.allocs++;
 	return nptr;
 }
 
 void FREE(void *ptr)
 {
+	if (ptr != NULL)
+		heap.frees++;
+	drop(ptr);
 	free(ptr);
 }
 
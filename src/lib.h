@@ -44,11 +44,14 @@ struct color {
 	unsigned long shadow2;
 };
 
+struct heapstats;
+
 void *MALLOC(size_t);
 void *REALLOC(void *, size_t);
 void FREE(void *);
 
 char *STRDUP(const char *);
+const struct heapstats *heap_stats(void);
 
 void clerr(void);
 void sterr(void);
@@ -64,15 +67,16 @@ void grabbutton(Display *display, unsigned button, unsigned modifiers,
 void ungrabbutton(Display *display, unsigned button, unsigned modifiers,
     Window grab_window);
 
+void fillrect(XftDraw *, XftColor *, int, int, int, int);
 void unmapDraw(XftDraw *xftdraw, XftColor color, int x, int y, int width, int height);
 void closeDraw(XftDraw *xftdraw, XftColor color, int x, int y, int width, int height);
 
-int stringwidth(const char *);
-char *stringfit(char *str, int width);
-
 void beginfastmove(Window);
 void endfastmove(void);
 
+long now_ms(void);
+long long now_us(void);
+
 void error(const char *, ...);
 void debug(const char *, ...);
 const char *eventname(int);
@@ -38,13 +38,32 @@
 #include <X11/Xresource.h>
 #include <X11/Xutil.h>
 #include <X11/Xft/Xft.h>
-#include <sys/timerfd.h>
+#if CONFIG_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+#if CONFIG_XSS
+#include <X11/extensions/scrnsaver.h>
+#endif
+#if CONFIG_DPMS
+#include <X11/extensions/dpms.h>
+#endif
 
 #include "global.h"
 #include "lib.h"
 #include "hints.h"
+#include "icon.h"
+#include "latency.h"
 #include "menu.h"
+#include "record.h"
+#include "stats.h"
+#if CONFIG_THUMBNAILS
+#include "thumb.h"
+#endif
+#include "timer.h"
+#include "title.h"
+#include "trace.h"
 #include "window.h"
+#include "xcount.h"
 
 
 #define BORDERWIDTH_MIN  0
@@ -95,6 +114,7 @@ static XrmOptionDescRec options[] = {
 	{ "-display", ".display", XrmoptionSepArg, NULL },
 	{ "-font", ".font", XrmoptionSepArg, NULL },
 	{ "-help", ".showHelp", XrmoptionNoArg, "True" },
+	{ "-record", ".record", XrmoptionSepArg, NULL },
 	{ "-version", ".showVersion", XrmoptionNoArg, "True" },
 
 	/*
@@ -134,7 +154,12 @@ static char *colorname_menu_selection_bg = WHITE;
 
 
 /* The signals that we care about */
-static const int sigv[] = { SIGHUP, SIGINT, SIGTERM };
+static const int sigv[] = {
+	SIGHUP, SIGINT, SIGTERM, SIGUSR2,
+#if CONFIG_TRACE
+	SIGUSR1,
+#endif
+};
 
 /* The self-pipe for delivering signals */
 static int sigpipe[2] = { -1, -1 };
@@ -142,7 +167,41 @@ static int sigpipe[2] = { -1, -1 };
 /* If greater than zero, don't report X errors */
 static int errlev = 0;
 
-static int timerfd;
+/* The compositing manager selection of our screen */
+static Atom NET_WM_CM_S;
+
+#if CONFIG_XFIXES
+static int xfixes_event_base = -1;
+#endif
+
+#if CONFIG_XSS
+static int xss_event_base = -1;
+#endif
+
+/* Nonzero while the event backlog is too deep for cosmetic work */
+int overloaded = 0;
+
+/* Overload episodes, see checkload() */
+static struct loadstats load;
+
+/* Path of the statistics socket, NULL for the default */
+static char *statssocket = NULL;
+
+/* File to record dispatched events to, see record.c */
+static char *recordfile = NULL;
+
+#if CONFIG_THUMBNAILS
+/* Memory for switcher thumbnails, in bytes, 0 for no thumbnails */
+static long thumbnail_budget = 0;
+#endif
+
+/* Main loop iterations that take longer are reported (ms), 0 for never */
+static long watchdog = 100;
+
+#if CONFIG_TRACE
+/* Main loop iterations that take longer are dumped (ms), 0 for never */
+static long trace_stall = 200;
+#endif
 
 static int xerr_report(Display *dpy, XErrorEvent *ep)
 {
@@ -170,6 +229,9 @@ void clerr(void)
 	assert(errlev >= 0);
 
 	if (errlev++ == 0) {
+#if CONFIG_XCOUNT
+		xcount_grab();
+#endif
 		XGrabServer(display);
 		XSetErrorHandler(xerr_ignore);
 	}
@@ -196,15 +258,40 @@ static void sighandler(int signo)
 	errno = e;
 }
 
+/* colormap cells held by the decoration colors */
+static unsigned long colorpixels[10];
+static int ncolorpixels = 0;
+
+static void freecolors(void)
+{
+	if (ncolorpixels > 0)
+		XFreeColors(display, DefaultColormap(display, screen),
+		    colorpixels, ncolorpixels, 0);
+	ncolorpixels = 0;
+}
+
 static void die(int signo)
 {
 	struct sigaction sigact;
 
+	if (load.episodes > 0)
+		debug("overloaded %lu times for %ldms in total, "
+		    "longest %ldms, deepest backlog %d", load.episodes,
+		    load.totalms, load.maxms, load.deepest);
+
 	window_fini();
+	icon_fini();
+	text_fini();
+#if CONFIG_THUMBNAILS
+	thumbnail_fini();
+#endif
 	hints_fini();
 	destroy_menu(winmenu);
+	freecolors();
 	widget_fini();
-
+	timer_fini();
+	stats_fini();
+	record_close();
 
 	XSetInputFocus(display, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XCloseDisplay(display);
@@ -234,9 +321,12 @@ static int readsig(int fd)
 		return c;
 }
 
-static void waitevent(void)
+/*
+ * Wait for an X event.  Returns zero if a timer ran instead.
+ */
+static int waitevent(void)
 {
-	struct pollfd pfd[3];
+	struct pollfd pfd[4];
 	int res;
 
 	pfd[0].fd = ConnectionNumber(display);
@@ -244,33 +334,17 @@ static void waitevent(void)
 
 	pfd[1].fd = sigpipe[0];
 	pfd[1].events = POLLIN;
-	pfd[2].fd = timerfd;
-	pfd[2].revents = 0;
+
+	pfd[2].fd = timer_fd();
 	pfd[2].events = POLLIN;
 
+	pfd[3].fd = stats_fd();
+	pfd[3].events = POLLIN;
 
 	for (;;) {
-		do {
-			res = poll(pfd, 3, -1);
-			if(res > 0) {
-			  if(pfd[2].revents == POLLIN) {
-				int timersElapsed = 0;
-            			(void) read(pfd[2].fd, &timersElapsed, 8);
-            			//error("timers elapsed: %d\n", timersElapsed);
-				if(active !=NULL) {
-					if(active->widget.xwindow != 0) {
-					  XEvent exppp;
-                                	  memset(&exppp,0, sizeof(exppp));
-                                	  exppp.type = Expose;
-                                	  exppp.xexpose.window = active->widget.xwindow;
-                                	  XSendEvent(display,active->widget.xwindow, False, ExposureMask, &exppp);
-                                	  XFlush(display);
-					}
-				}
-			  	res = -1;
-			  }
-			}
-		} while (res == -1 && (errno == EINTR || errno == EAGAIN));
+		do
+			res = poll(pfd, 4, -1);
+		while (res == -1 && (errno == EINTR || errno == EAGAIN));
 
 		if (res == -1) {
 			error("poll: %s", strerror(errno));
@@ -280,37 +354,56 @@ static void waitevent(void)
 
 			if (pfd[1].revents == POLLIN &&
 			    (sig = readsig(pfd[1].fd)) != 0) {
+#if CONFIG_TRACE
+				if (sig == SIGUSR1) {
+					char name[64];
+
+					snprintf(name, sizeof name,
+					    "karmen-trace-%d.json", getpid());
+					trace_dump(name);
+					continue;
+				}
+#endif
+				if (sig == SIGUSR2) {
+					/* report and restart statistics */
+#if CONFIG_XCOUNT
+					xcount_dump(stderr);
+					xcount_reset();
+#endif
+					latency_dump(stderr);
+					latency_reset();
+					continue;
+				}
 				/* Signal received on our self-pipe */
 				debug("terminating on signal %d", sig);
 				die(sig);
+			} else if (pfd[3].revents & POLLIN) {
+				stats_serve();
 			} else if (pfd[0].revents == POLLIN) {
 				/* Event received */
-				if(timerfd >=0) {
-				    //timerfd_destroy(timerfd);
-				}
-				return;
+				return 1;
 			} else if (pfd[0].revents == POLLERR) {
 				/* X connection broken */
 				error("X connection broken");
 				die(0);
-			} else if(pfd[2].revents == POLLIN) {
-				/*XEvent exppp;
-				memset(&exppp,0, sizeof(exppp));
-				exppp.type = Expose;
-				exppp.xexpose.window = active->widget.xwindow;
-				XSendEvent(display,active->widget.xwindow, False, ExposureMask, &exppp);
-				XFlush(display);*/
+			} else if (pfd[2].revents == POLLIN) {
+				/* timers count as an iteration of their own */
+				loop_begin();
+				loop_phase("timers");
+				run_timers();
+				return 0;
 			}
 		}
 	}
 }
 
-static void nextevent(XEvent *ep)
+static int nextevent(XEvent *ep)
 {
 	XFlush(display);
-	if (XQLength(display) == 0)
-		waitevent();
+	if (XQLength(display) == 0 && !waitevent())
+		return 0;
 	XNextEvent(display, ep);
+	return 1;
 }
 
 static unsigned short scalepixel(unsigned c, double d)
@@ -333,25 +426,136 @@ static void scalecolor(XColor *rp, const XColor *cp, double d)
 
 
 static void mkxftcolor(XftColor *color, const char *name, float alpha) {
-	error("alpha : %f\n", alpha);
+	debug("alpha : %f", alpha);
 	XColor tc, sc;
-	XAllocNamedColor(display, DefaultColormap(display, screen),
-            name, &sc, &tc);
+	if (XAllocNamedColor(display, DefaultColormap(display, screen),
+            name, &sc, &tc) && ncolorpixels < NELEM(colorpixels))
+		colorpixels[ncolorpixels++] = sc.pixel;
     color->pixel = sc.pixel;
     color->color.red = (unsigned short)(tc.red * alpha);
     color->color.green = (unsigned short)(tc.green * alpha);
     color->color.blue = (unsigned short)(tc.blue * alpha);
     color->color.alpha = (unsigned short)(0xffff * alpha);
-    color->pixel &= 0x00FFFFFF;
-    color->pixel |= (unsigned char)(0xff * alpha) << 24;
+    if (widget_argb()) {
+	    color->pixel &= 0x00FFFFFF;
+	    color->pixel |= (unsigned char)(0xff * alpha) << 24;
+    }
+}
+
+/*
+ * Pick the decoration pipeline.  Translucent ARGB decorations are only
+ * worth their cost when a compositor blends them and -a was given;
+ * otherwise everything is drawn opaque on the default visual.
+ */
+static void setdecorations(int composited)
+{
+	float a;
+
+	freecolors();
+	set_widget_argb(composited && alpha < 1);
+	a = widget_argb() ? alpha : 1;
+
+	mkxftcolor(&bgColorTitleActive,colorname_title_active_bg, a);
+	mkxftcolor(&bgColorTitleActiveBright, colorname_title_active_bg_bright, a);
+	mkxftcolor(&fgColorTitleActive,colorname_title_active_fg,a);
+	mkxftcolor(&bgColorTitleInactive,colorname_title_inactive_bg, a);
+	mkxftcolor(&fgColorTitleInactive,colorname_title_inactive_fg,a);
+	mkxftcolor(&bgColorTitleInactiveBright, colorname_title_inactive_bg_bright,a);
+	mkxftcolor(&bgColorMenu, colorname_menu_bg,a);
+	mkxftcolor(&fgColorMenu, colorname_menu_fg,a);
+	mkxftcolor(&bgColorMenuSelection, colorname_menu_selection_bg,a);
+	mkxftcolor(&fgColorMenuSelection, colorname_menu_selection_fg,a);
+}
+
+static int compositor_running(void)
+{
+	return XGetSelectionOwner(display, NET_WM_CM_S) != None;
+}
+
+/*
+ * Watch the _NET_WM_CM_Sn selection so that we notice a compositor
+ * starting or stopping.  Without XFixes we only look once at startup.
+ */
+static void watchcompositor(void)
+{
+	char name[32];
+#if CONFIG_XFIXES
+	int error_base;
+#endif
+
+	snprintf(name, sizeof name, "_NET_WM_CM_S%d", screen);
+	NET_WM_CM_S = XInternAtom(display, name, False);
+
+#if CONFIG_XFIXES
+	if (XFixesQueryExtension(display, &xfixes_event_base, &error_base))
+		XFixesSelectSelectionInput(display, root, NET_WM_CM_S,
+		    XFixesSetSelectionOwnerNotifyMask |
+		    XFixesSelectionWindowDestroyNotifyMask |
+		    XFixesSelectionClientCloseNotifyMask);
+	else
+		xfixes_event_base = -1;
+#endif
+}
+
+/*
+ * Stop the clock while the screen saver runs.  DPMS blanking also
+ * activates the screen saver, so DPMS is only asked whether the
+ * monitor is already off when we start.
+ */
+static void watchscreensaver(void)
+{
+#if CONFIG_XSS
+	int error_base;
+#if CONFIG_DPMS
+	CARD16 level;
+	BOOL enabled;
+#endif
+
+	if (XScreenSaverQueryExtension(display, &xss_event_base, &error_base)) {
+		XScreenSaverSelectInput(display, root, ScreenSaverNotifyMask);
+#if CONFIG_DPMS
+		if (DPMSQueryExtension(display, &error_base, &error_base)
+		    && DPMSInfo(display, &level, &enabled)
+		    && enabled && level != DPMSModeOn)
+			pause_clock(1);
+#endif
+	} else
+		xss_event_base = -1;
+#endif
+}
+
+/*
+ * Switch the decorations between the opaque and the ARGB pipeline.
+ * The visual of a window can't be changed, so the frames and the
+ * window menu get new X windows and the clients are reparented into
+ * them; the windows themselves are left as they are.
+ */
+static void compositorchanged(void)
+{
+	int composited = compositor_running();
+
+	if ((composited && alpha < 1) == widget_argb())
+		return;
+
+	debug("compositor %s", composited ? "started" : "stopped");
+
+	setdecorations(composited);
+	redecorate_menu(winmenu);
+	redecorate_all_windows();
 }
 static void usage(FILE *fp)
 {
 	fprintf(fp,
-"usage: karmen [-display name] [-font name] [-help] [-version]\n");
+"usage: karmen [-display name] [-font name] [-help] [-record file] "
+"[-version]\n");
 }
 
-static void loadres(XrmDatabase db)
+/*
+ * What the command line says before the display is opened.  The rest
+ * is read once the server's resources are merged in, so that no
+ * string is copied twice.
+ */
+static void loadargs(XrmDatabase db)
 {
 	XrmValue val;
 	char *type;
@@ -371,6 +575,12 @@ static void loadres(XrmDatabase db)
 	if (XrmGetResource(db, "karmen.display",
 	    "Karmen.Display", &type, &val))
 		displayname = STRDUP((char *)val.addr);
+}
+
+static void loadres(XrmDatabase db)
+{
+	XrmValue val;
+	char *type;
 
 	if (XrmGetResource(db, "karmen.title.active.foreground",
 	    "Karmen.Title.Active.Foreground", &type, &val))
@@ -408,12 +618,36 @@ static void loadres(XrmDatabase db)
 	    "Karmen.Border.Width", &type, &val))
 		border_width = MAX(BORDERWIDTH_MIN, atoi((char *)val.addr));
 
+#if CONFIG_THUMBNAILS
+	if (XrmGetResource(db, "karmen.thumbnail.budget",
+	    "Karmen.Thumbnail.Budget", &type, &val))
+		thumbnail_budget = 1024L * atol((char *)val.addr);
+#endif
+
+	if (XrmGetResource(db, "karmen.record",
+	    "Karmen.Record", &type, &val))
+		recordfile = STRDUP((char *)val.addr);
+
+	if (XrmGetResource(db, "karmen.stats.socket",
+	    "Karmen.Stats.Socket", &type, &val))
+		statssocket = STRDUP((char *)val.addr);
+
+	if (XrmGetResource(db, "karmen.watchdog",
+	    "Karmen.Watchdog", &type, &val))
+		watchdog = atol((char *)val.addr);
+
+#if CONFIG_TRACE
+	if (XrmGetResource(db, "karmen.trace.stall",
+	    "Karmen.Trace.Stall", &type, &val))
+		trace_stall = atol((char *)val.addr);
+#endif
+
 	if (XrmGetResource(db, "karmen.font", "Karmen.Font", &type, &val))
 		 ftnames[0] = STRDUP((char *)val.addr);
 
 	if (XrmGetResource(db, "karmen.alpa", "Karmen.Alpa", &type, &val)) {
                  alpha = atof((char *)val.addr);
-		error("loading alpha  \"%f\"",alpha);
+		debug("loading alpha  \"%f\"",alpha);
 	}
 
 }
@@ -468,12 +702,15 @@ static void init(int *argcp, char *argv[])
 		usage(stderr);
 		exit(1);
 	}
-	loadres(adb);
+	loadargs(adb);
 
 	if ((display = XOpenDisplay(displayname)) == NULL) {
 		error("can't open display \"%s\"", XDisplayName(displayname));
 		exit(1);
 	}
+#if CONFIG_XCOUNT
+	xcount_init();
+#endif
 
 	/* Load the default database. */
 	db = NULL;
@@ -518,40 +755,49 @@ static void init(int *argcp, char *argv[])
 		button_size++;
 	button_size++;
 
-	mkxftcolor(&bgColorTitleActive,colorname_title_active_bg, alpha);
-	mkxftcolor(&bgColorTitleActiveBright, colorname_title_active_bg_bright, alpha);
-	mkxftcolor(&fgColorTitleActive,colorname_title_active_fg,alpha);
-	mkxftcolor(&bgColorTitleInactive,colorname_title_inactive_bg, alpha);
-	mkxftcolor(&fgColorTitleInactive,colorname_title_inactive_fg,alpha);
-	mkxftcolor(&bgColorTitleInactiveBright, colorname_title_inactive_bg_bright,alpha);
-	mkxftcolor(&bgColorMenu, colorname_menu_bg,alpha);
-	mkxftcolor(&fgColorMenu, colorname_menu_fg,alpha);
-	mkxftcolor(&bgColorMenuSelection, colorname_menu_selection_bg,alpha);
-	mkxftcolor(&fgColorMenuSelection, colorname_menu_selection_fg,alpha);
-	struct itimerspec timerValue;
-	timerfd = timerfd_create(CLOCK_REALTIME, 0);
-    	if (timerfd < 0) {
-        	error("failed to create timer fd\n");
-        	//exit(1);
-    	}
-    	bzero(&timerValue, sizeof(timerValue));
-    	timerValue.it_value.tv_sec = 1;
-    	timerValue.it_value.tv_nsec = 0;
-    	timerValue.it_interval.tv_sec = 1;
-    	timerValue.it_interval.tv_nsec = 0;
-	if(timerfd >= 0) {
-		if (timerfd_settime(timerfd, 0, &timerValue, NULL) < 0) {
-        		error("could not start timer\n");
-        	//exit(1);
-    		}
-	}
+	timer_init();
+	watchcompositor();
+	setdecorations(compositor_running());
+	watchscreensaver();
+}
+
+/*
+ * Preview the window selected in the switcher.
+ */
+static void previewcurrent(void)
+{
+#if CONFIG_THUMBNAILS
+	show_thumbnail(current_menuitem_arg(winmenu), &winmenu->widget);
+#endif
+}
 
+static void endpreview(void)
+{
+#if CONFIG_THUMBNAILS
+	hide_thumbnail();
+#endif
 }
 
 static void handlekey(XKeyEvent *ep)
 {
 	static int cycling = 0;
 
+	/* typing while cycling filters the window menu */
+	if (cycling && ep->type == KeyPress) {
+		if (XLookupKeysym(ep, 0) == XK_Escape) {
+			cycling = 0;
+			XUngrabKeyboard(display, CurrentTime);
+			endpreview();
+			hide_menu(winmenu);
+			return;
+		}
+		if (XLookupKeysym(ep, 0) != XK_Tab &&
+		    filter_menu_key(winmenu, ep)) {
+			previewcurrent();
+			return;
+		}
+	}
+
 	//switch (XKeycodeToKeysym(display, ep->keycode, 0)) {
         switch (XkbKeycodeToKeysym( display, ep->keycode, 
                                 0, ep->state & ShiftMask ? 1 : 0)) {
@@ -566,6 +812,7 @@ static void handlekey(XKeyEvent *ep)
 			if (cycling) {
 				cycling = 0;
 				XUngrabKeyboard(display, CurrentTime);
+				endpreview();
 				select_current_menuitem(winmenu);
 				hide_menu(winmenu);
 			}
@@ -579,27 +826,23 @@ static void handlekey(XKeyEvent *ep)
 			XGrabKeyboard(display, root, True,
 			    GrabModeAsync, GrabModeAsync, CurrentTime);
 
-			if (!WIDGET_MAPPED(winmenu)) {
-				int x = DisplayWidth(display, screen) / 2
-				    - WIDGET_WIDTH(winmenu) / 2;
-				int y = DisplayHeight(display, screen) / 2
-				    - WIDGET_HEIGHT(winmenu) / 2;
-				show_menu(winmenu, x, y, -1);
-			}
+			if (!WIDGET_MAPPED(winmenu))
+				show_menu_centered(winmenu, -1);
 
 			if (winmenu->current == -1)
 				winmenu->current = ep->state & ShiftMask ?
-				    winmenu->nitems - 1 : 1;
+				    winmenu->nshown - 1 : 1;
 			else
 				winmenu->current +=
 				    ep->state & ShiftMask ? -1 : 1;
 
-			if (winmenu->current >= winmenu->nitems)
+			if (winmenu->current >= winmenu->nshown)
 				winmenu->current = 0;
 			else if (winmenu->current < 0)
-				winmenu->current = winmenu->nitems - 1;
+				winmenu->current = winmenu->nshown - 1;
 
 			REPAINT(winmenu);
+			previewcurrent();
 		}
 		break;
 	case XK_Return:
@@ -713,58 +956,317 @@ int XNextEventTimeout(Display *display, XEvent *event, double seconds)
     }
 }
 
-static void mainloop(void)
+/*
+ * Property fetches are deferred to the end of a batch of events, but
+ * never for more than this many events; see dispatch().
+ */
+#define MAXBATCH	256
+
+/* Time in ms that low priority events may take before input is checked */
+#define LOWBUDGET	5
+
+/*
+ * With more than OVERLOAD events waiting, cosmetic work is put off
+ * until the backlog is down to UNDERLOAD again.
+ */
+#define OVERLOAD	512
+#define UNDERLOAD	16
+
+static int batchlen = 0;
+
+/*
+ * Events are handled in priority order rather than arrival order:
+ * input first, so that a click or key press never waits behind a
+ * burst of other work, then changes to the window structure, then
+ * everything else (repaints, property changes and housekeeping).
+ */
+enum {
+	CLASS_INPUT,
+	CLASS_STRUCTURE,
+	CLASS_LOW,
+
+	NCLASS
+};
+
+/* A queued event and when it was taken off the connection (us) */
+struct queued {
+	XEvent ev;
+	long long received;
+};
+
+static struct {
+	struct queued *ev;
+	int head;
+	int len;
+	int lim;
+} queue[NCLASS];
+
+static int eventclass(XEvent *ep)
 {
+	switch (ep->type) {
+	case ButtonPress:
+	case ButtonRelease:
+	case MotionNotify:
+	case KeyPress:
+	case KeyRelease:
+	case EnterNotify:
+	case LeaveNotify:
+		return CLASS_INPUT;
+	case MapRequest:
+	case ConfigureRequest:
+	case CirculateRequest:
+	case UnmapNotify:
+	case DestroyNotify:
+	case MapNotify:
+	case ReparentNotify:
+	case ConfigureNotify:
+	case CreateNotify:
+	case GravityNotify:
+	case ClientMessage:
+		return CLASS_STRUCTURE;
+	default:
+		return CLASS_LOW;
+	}
+}
+
+static void enqueue(XEvent *ep)
+{
+	int class = eventclass(ep);
+
+	if (queue[class].len == queue[class].lim) {
+		queue[class].lim = LARGER(queue[class].lim);
+		queue[class].ev = REALLOC(queue[class].ev,
+		    queue[class].lim * sizeof (struct queued));
+	}
+	queue[class].ev[queue[class].len].ev = *ep;
+	queue[class].ev[queue[class].len++].received = now_us();
+}
+
+static int dequeue(int class, XEvent *ep, long long *receivedp)
+{
+	if (queue[class].head == queue[class].len)
+		return 0;
+	*receivedp = queue[class].ev[queue[class].head].received;
+	*ep = queue[class].ev[queue[class].head++].ev;
+	if (queue[class].head == queue[class].len)
+		queue[class].head = queue[class].len = 0;
+	return 1;
+}
 
+static int queued(int class)
+{
+	return queue[class].len - queue[class].head;
+}
+
+/*
+ * Enter or leave overload mode.  While overloaded, clock ticks,
+ * hover feedback, repaints of inactive frames and the EWMH stacking
+ * list wait; they are caught up in one pass once the backlog is gone.
+ */
+static void checkload(void)
+{
+	int backlog = queued(CLASS_INPUT) + queued(CLASS_STRUCTURE) +
+	    queued(CLASS_LOW) + XQLength(display);
+	long t;
+
+	if (!overloaded && backlog >= OVERLOAD) {
+		overloaded = 1;
+		load.episodes++;
+		load.since = now_ms();
+		debug("overloaded, %d events waiting", backlog);
+	}
+	if (overloaded) {
+		load.deepest = MAX(load.deepest, backlog);
+		if (backlog <= UNDERLOAD) {
+			overloaded = 0;
+			t = now_ms() - load.since;
+			load.totalms += t;
+			load.maxms = MAX(load.maxms, t);
+			debug("overload over after %ldms", t);
+			catch_up_windows();
+		}
+	}
+}
+
+/*
+ * Sort all events that can be had without blocking into the queues.
+ */
+static void drainevents(void)
+{
 	XEvent e;
+
+	while (XEventsQueued(display, QueuedAfterReading) > 0) {
+		XNextEvent(display, &e);
+		enqueue(&e);
+	}
+}
+
+/*
+ * Whether input is waiting, which is what the low priority work
+ * yields to.  Other events that have arrived are sorted into their
+ * queues on the way and just wait their turn.
+ */
+static int inputwaiting(void)
+{
+	drainevents();
+	return queued(CLASS_INPUT) > 0;
+}
+
+/*
+ * Handle an event and return the type of the widget that took it,
+ * WIDGET_ANY for the root window or HANDLER_EXTENSION.
+ */
+static int handle(XEvent *ep)
+{
 	Window xwindow;
 	struct widget *widget;
+	int handler;
+
+#if CONFIG_XFIXES
+	if (xfixes_event_base != -1
+	    && ep->type == xfixes_event_base + XFixesSelectionNotify) {
+		compositorchanged();
+		return HANDLER_EXTENSION;
+	}
+#endif
+#if CONFIG_XSS
+	if (xss_event_base != -1
+	    && ep->type == xss_event_base + ScreenSaverNotify) {
+		pause_clock(((XScreenSaverNotifyEvent *)ep)->state ==
+		    ScreenSaverOn);
+		return HANDLER_EXTENSION;
+	}
+#endif
+#if CONFIG_THUMBNAILS
+	if (thumbnail_event(ep))
+		return HANDLER_EXTENSION;
+#endif
+	xwindow = xeventwindow(ep);
+	widget = find_widget(xwindow, WIDGET_ANY);
+
+	if (widget != NULL) {
+		/* the handler may destroy the widget */
+		handler = widget->type;
+		if (widget->event != NULL)
+			widget->event(widget, ep);
+		return handler;
+	} else {
+		switch (ep->type) {
+		case MapRequest:
+			manage_window(xwindow, 0);
+			break;
+		case ConfigureRequest:
+			configrequest(&ep->xconfigurerequest);
+			break;
+		case ButtonPress:
+			if (ep->xbutton.window == root &&
+			    ep->xbutton.subwindow == None &&
+			    ep->xbutton.button == Button3)
+				show_menu(winmenu,
+				    ep->xbutton.x, ep->xbutton.y,
+				    ep->xbutton.button);
+			break;
+		case KeyPress:
+		case KeyRelease:
+			if (ep->xkey.window == root)
+				handlekey(&ep->xkey);
+			break;
+		case ClientMessage:
+		case CreateNotify:
+		case DestroyNotify:
+		case ConfigureNotify:
+		case ReparentNotify:
+		case MapNotify:
+		case UnmapNotify:
+			/* ignore */
+			break;
+		default:
+			debug("mainloop(): unhandled event -- %s (%d)",
+			    eventname(ep->type), ep->type);
+			break;
+		}
+		return WIDGET_ANY;
+	}
+}
+
+static void dispatch(XEvent *ep, long long received)
+{
+	long long started = now_us();
+	int type = ep->type;
+	int handler;
+
+	batchlen++;
+	record_event(ep, received);
+	TRACE_BEGIN(TR_DISPATCH, type);
+	handler = handle(ep);
+	TRACE_END(TR_DISPATCH);
+	latency_event(type, handler, received, started);
+}
+
+static void mainloop(void)
+{
+	XEvent e;
+	long long received;
+	long deadline;
 
 	for (;;) {
+		TRACE_ITERATION();
+		loop_begin();
+		drainevents();
+		checkload();
+		if (overloaded)
+			stats_serve();	/* waitevent() is not reached */
+
+		/* a batch ends when the queues drain */
+		if (batchlen >= MAXBATCH || (queued(CLASS_INPUT) == 0 &&
+		    queued(CLASS_STRUCTURE) == 0 && queued(CLASS_LOW) == 0)) {
+			loop_phase("properties");
+			fetch_dirty_properties();
+			batchlen = 0;
+		}
+		loop_phase("deferred");
+		run_deferred();
+		loop_phase("restack");
 		restack_all_windows();
-		repaint_widgets();
-		nextevent(&e);
-		xwindow = xeventwindow(&e);
-		widget = find_widget(xwindow, WIDGET_ANY);
-
-		if (widget != NULL) {
-			if (widget->event != NULL)
-				widget->event(widget, &e);
-		} else {
-			switch (e.type) {
-			case MapRequest:
-				manage_window(xwindow, 0);
-				break;
-			case ConfigureRequest:
-				configrequest(&e.xconfigurerequest);
-				break;
-			case ButtonPress:
-				if (e.xbutton.window == root &&
-				    e.xbutton.subwindow == None &&
-				    e.xbutton.button == Button3)
-					show_menu(winmenu,
-					    e.xbutton.x, e.xbutton.y,
-					    e.xbutton.button);
-				break;
-			case KeyPress:
-			case KeyRelease:
-				if (e.xkey.window == root)
-					handlekey(&e.xkey);
-				break;
-			case ClientMessage:
-			case CreateNotify:
-			case DestroyNotify:
-			case ConfigureNotify:
-			case ReparentNotify:
-			case MapNotify:
-			case UnmapNotify:
-				/* ignore */
-				break;
-			default:
-				debug("mainloop(): unhandled event -- %s (%d)",
-				    eventname(e.type), e.type);
-				break;
+		if (queued(CLASS_INPUT) == 0) {
+			loop_phase("repaint");
+			repaint_widgets(inputwaiting);
+		}
+
+		if (queued(CLASS_INPUT) > 0) {
+			loop_phase("input");
+			while (batchlen < MAXBATCH &&
+			    dequeue(CLASS_INPUT, &e, &received))
+				dispatch(&e, received);
+		} else if (queued(CLASS_STRUCTURE) > 0) {
+			/* one transaction for what is queued, within budget */
+			loop_phase("structure");
+			deadline = now_ms() + LOWBUDGET;
+			begin_transaction();
+			while (dequeue(CLASS_STRUCTURE, &e, &received)) {
+				dispatch(&e, received);
+				if (now_ms() >= deadline ||
+				    batchlen >= MAXBATCH)
+					break;
+			}
+			loop_phase("commit");
+			commit_transaction();
+		} else if (queued(CLASS_LOW) > 0) {
+			/* until the budget is spent or input shows up */
+			loop_phase("events");
+			deadline = now_ms() + LOWBUDGET;
+			while (dequeue(CLASS_LOW, &e, &received)) {
+				dispatch(&e, received);
+				if (now_ms() >= deadline ||
+				    batchlen >= MAXBATCH || inputwaiting())
+					break;
 			}
+		} else if (!repaint_pending()) {
+			TRACE_IDLE();
+			loop_idle();
+			record_flush();
+			if (nextevent(&e))
+				enqueue(&e);
 		}
 	}
 }
@@ -776,7 +1278,20 @@ int main(int argc, char *argv[])
 	widget_init();
 	winmenu = create_menu();
 	hints_init();
+#if CONFIG_THUMBNAILS
+	thumbnail_init(thumbnail_budget);
+#endif
+#if CONFIG_TRACE
+	trace_init(trace_stall);
+#endif
+	latency_init(watchdog);
 	window_init();
+	if (recordfile != NULL && record_open(recordfile) == 0)
+		record_windows();
+	if (statssocket == NULL)
+		statssocket = stats_path(XDisplayString(display));
+	if (*statssocket != '\0')
+		stats_init(statssocket, &load);
 	mainloop();
 	return 0;
 }
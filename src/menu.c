@@ -21,62 +21,214 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 
 #include <X11/cursorfont.h>
+#include <X11/keysym.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
 #include "global.h"
-#include "list.h"
+#include "icon.h"
 #include "menu.h"
-#include "window.h"
+#include "stats.h"
+#include "xcount.h"
 
 #define ITEMPAD		MAX(1, (xftfont->ascent + xftfont->descent) / 4)
 #define ITEMHEIGHT	(xftfont->ascent + xftfont->descent + 2 * ITEMPAD)
 #define MAXWIDTH	(DisplayWidth(display, screen) / 4)
+#define MAXROWS		MAX(1, (DisplayHeight(display, screen) \
+			    - 2 - 2 * ITEMPAD) / ITEMHEIGHT)
+
+/* The i'th item shown, after filtering */
+#define SHOWN(m, i)	((m)->filterlen > 0 ? (m)->view[i] : (m)->items[i])
 
 static Cursor cursor = None;
 
 static void menuevent(struct widget *, XEvent *);
 static void trim(struct menu *);
 
+/*
+ * A signature of a text, with one of the low 32 bits set for each
+ * character and one of the high 32 bits for each trigram.  A text
+ * can only contain a query if its signature has all of the bits of
+ * the query's, which rejects most items without looking at them.
+ */
+static unsigned long long signature(const char *s)
+{
+	const unsigned char *p = (const unsigned char *)s;
+	unsigned long long sig = 0;
+
+	for (; *p != '\0'; p++) {
+		sig |= 1ULL << (*p % 32);
+		if (p[1] != '\0' && p[2] != '\0')
+			sig |= 1ULL << (32 +
+			    (p[0] * 31 * 31 + p[1] * 31 + p[2]) % 32);
+	}
+	return sig;
+}
+
+/*
+ * Rebuild the list of shown items.  When the filter has only grown
+ * since the last call, the items currently shown are the only
+ * candidates.
+ */
+static void refilter(struct menu *menu, int narrow)
+{
+	struct menuitem **from;
+	struct menuitem *ip;
+	unsigned long long sig;
+	int i, n;
+
+	if (menu->filterlen == 0) {
+		menu->nshown = menu->nitems;
+		return;
+	}
+
+	if (narrow) {
+		from = menu->view;
+		n = menu->nshown;
+	} else {
+		from = menu->items;
+		n = menu->nitems;
+	}
+
+	sig = signature(menu->filter);
+	menu->nshown = 0;
+	for (i = 0; i < n; i++) {
+		ip = from[i];
+		if ((ip->sig & sig) == sig &&
+		    strstr(ip->text, menu->filter) != NULL)
+			menu->view[menu->nshown++] = ip;
+	}
+}
+
+/*
+ * Mark the whole menu for repainting.  A hidden menu is not painted
+ * until it is about to be shown, and a shown one is resized when it
+ * is repainted, so a burst of changes costs one layout.
+ */
+static void invalidate(struct menu *menu)
+{
+	refilter(menu, 0);
+	if (menu->current >= menu->nshown)
+		menu->current = -1;
+	menu->stale = 1;
+	if (WIDGET_MAPPED(menu))
+		REPAINT(menu);
+}
+
+/*
+ * The widest name is tracked with a histogram of name widths, so
+ * that adding, renaming or removing an item never rescans the menu.
+ */
+static void addwidth(struct menu *menu, int width)
+{
+	menu->widthcount[width]++;
+	if (width > menu->maxwidth)
+		menu->maxwidth = width;
+}
+
+static void delwidth(struct menu *menu, int width)
+{
+	menu->widthcount[width]--;
+	while (menu->maxwidth > 0 && menu->widthcount[menu->maxwidth] == 0)
+		menu->maxwidth--;
+}
+
+static void setname(struct menuitem *ip, const char *name)
+{
+	ip->rawname = STRDUP(name);
+	ip->name = STRDUP(name);
+	stringfit(ip->name, MAXWIDTH);
+	ip->width = MIN(stringwidth(ip->name), MAXWIDTH);
+}
+
+static void settext(struct menuitem *ip, const char *text)
+{
+	char *p;
+
+	ip->text = STRDUP(text);
+	for (p = ip->text; *p != '\0'; p++)
+		*p = tolower((unsigned char)*p);
+	ip->sig = signature(ip->text);
+}
+
+/*
+ * Whether text lower-cased is the same as the item's text.
+ */
+static int sametext(struct menuitem *ip, const char *text)
+{
+	const char *p;
+
+	for (p = ip->text; *p != '\0'; p++, text++)
+		if (*p != tolower((unsigned char)*text))
+			return 0;
+	return *text == '\0';
+}
+
+/*
+ * Move the item at index 'from' to index 'to', shifting the ones
+ * in between.
+ */
+static void moveitem(struct menu *menu, int from, int to)
+{
+	struct menuitem *ip = menu->items[from];
+	int i;
+
+	if (from < to) {
+		memmove(&menu->items[from], &menu->items[from + 1],
+		    (to - from) * sizeof menu->items[0]);
+		for (i = from; i < to; i++)
+			menu->items[i]->index = i;
+	} else if (from > to) {
+		memmove(&menu->items[to + 1], &menu->items[to],
+		    (from - to) * sizeof menu->items[0]);
+		for (i = to + 1; i <= from; i++)
+			menu->items[i]->index = i;
+	}
+	menu->items[to] = ip;
+	ip->index = to;
+}
+
 /*
  * Perform the action of the currently selected item.
  */
 void select_current_menuitem(struct menu *menu)
 {
 	struct menuitem *ip;
-	LIST *lp;
-	int i;
 
-	i = 0;
-	LIST_FOREACH(lp, &menu->itemlist) {
-		if (i == menu->current) {
-			ip = LIST_ITEM(lp, struct menuitem, itemlink);
-			ip->select(ip->arg);
-			return;
-		}
-		i++;
+	if (menu->current >= 0 && menu->current < menu->nshown) {
+		ip = SHOWN(menu, menu->current);
+		ip->select(ip->arg);
 	}
 }
 
+/*
+ * Return the argument of the currently selected item, or NULL.
+ */
+void *current_menuitem_arg(struct menu *menu)
+{
+	if (menu->current >= 0 && menu->current < menu->nshown)
+		return SHOWN(menu, menu->current)->arg;
+	return NULL;
+}
+
 void put_menuitem_first(struct menuitem *item)
 {
 	if (item->menu != NULL) {
-		LIST_REMOVE(&item->itemlink);
-		LIST_INSERT_HEAD(&item->menu->itemlist, &item->itemlink);
-		REPAINT(item->menu);
+		moveitem(item->menu, item->index, 0);
+		invalidate(item->menu);
 	}
 }
 
 void put_menuitem_last(struct menuitem *item)
 {
 	if (item->menu != NULL) {
-		LIST_REMOVE(&item->itemlink);
-		LIST_INSERT_TAIL(&item->menu->itemlist, &item->itemlink);
-		REPAINT(item->menu);
+		moveitem(item->menu, item->index, item->menu->nitems - 1);
+		invalidate(item->menu);
 	}
 }
 
@@ -87,101 +239,154 @@ static void prepare_repaint(struct widget *widget)
 //	XSetWindowBackground(display, WIDGET_XWINDOW(menu),
 //	    color_menu_bg.normal);
 }
-char* fetch_icon_name_only(struct window *win)
-{
-	char *name;
-	char *iconname;
-	XTextProperty p;
-	clerr();
-	XGetIconName(display, win->client, &iconname);
-	if (iconname == NULL || strlen(iconname) == 0) {
-		if (iconname != NULL) {
-			XFree(iconname);
-			iconname = NULL;
-		}
-		XFetchName(display, win->client, &iconname);
+
+static int rowy(int row)
+{
+	return 1 + ITEMPAD + row * ITEMHEIGHT;
+}
+
+/*
+ * Paint a row of the pixmap, blank if no item is shown there.
+ */
+static void paintrow(struct menu *menu, int row)
+{
+	struct menuitem *ip;
+	XftColor *bg, *fg;
+	int i = menu->top + row;
+
+	ip = i < menu->nshown ? SHOWN(menu, i) : NULL;
+	if (ip != NULL && i == menu->current) {
+		bg = &fgColorMenuSelection;
+		fg = &bgColorMenuSelection;
+	} else {
+		bg = &bgColorMenu;
+		fg = &fgColorMenu;
 	}
-	sterr();
+	fillrect(menu->xftdraw, bg, 0, rowy(row),
+	    WIDGET_WIDTH(menu), ITEMHEIGHT);
+	if (ip != NULL && ip->icon != NULL)
+		draw_icon(ip->icon, menu->xftdraw,
+		    1 + ITEMPAD, rowy(row) + ITEMPAD);
+	if (ip != NULL)
+		drawstring(menu->xftdraw, fg,
+		    1 + ITEMHEIGHT, rowy(row) + ITEMPAD + xftfont->ascent,
+		    ip->name);
+	menu->drawn[row] = ip;
+}
+
+static void showrow(struct menu *menu, int row)
+{
+	int y = rowy(row);
+
+	XCopyArea(display, menu->pixmap, WIDGET_XWINDOW(menu), menu->gc,
+	    0, y, WIDGET_WIDTH(menu), ITEMHEIGHT, 0, y);
+}
 
-	if (iconname == NULL || strlen(iconname) == 0) {
-    	   XTextProperty p;
-    	   if (0 != XGetWMName(display, win->client, &p)) {
-      		name = decodetextproperty(&p);
-      		if (p.value != NULL)
-        		XFree(p.value);
-    	   }
-       } else {
-         name = iconname;
-       }
+/*
+ * Scroll so that the selected item is in view.
+ */
+static void scrolltocurrent(struct menu *menu)
+{
+	int top = menu->top;
 
-  return name;
+	if (menu->current >= 0 && menu->current < menu->nshown) {
+		if (menu->current < top)
+			top = menu->current;
+		else if (menu->current >= top + menu->nrows)
+			top = menu->current - menu->nrows + 1;
+	}
+	top = MIN(top, menu->nshown - menu->nrows);
+	top = MAX(top, 0);
+	if (top != menu->top) {
+		menu->top = top;
+		menu->stale = 1;
+	}
 }
 
+/*
+ * Repaint the menu.  Only the rows in view are ever painted.  After a
+ * full invalidation all of them are; otherwise only rows whose item
+ * or highlight differs from what is on screen, so moving the
+ * selection or narrowing the filter touches just the rows it changed.
+ */
 static void repaint(struct widget *widget)
 {
 	struct menu *menu = (struct menu *)widget;
 	struct menuitem *ip;
-	LIST *lp;
-	char *name;
-	int i;
+	int row, i;
 
-	/* clear */
-	XftDrawRect(menu->xftdraw, &bgColorMenu, 0, 0, WIDGET_WIDTH(menu), WIDGET_HEIGHT(menu));
-
-	i = 0;
-	LIST_FOREACH(lp, &menu->itemlist) {
-		ip = LIST_ITEM(lp, struct menuitem, itemlink);
-		name = ip->name;
-		//name = fetch_icon_name_only(ip->arg);
-		//stringfit(name,MAXWIDTH);
-		if (i == menu->current) {
-			XftDrawRect(menu->xftdraw, &fgColorMenuSelection, 0,  ITEMPAD+i * ITEMHEIGHT, WIDGET_WIDTH(menu) , WIDGET_HEIGHT(menu));
-			XftDrawString8(menu->xftdraw, &bgColorMenuSelection, xftfont,
-                        1 + ITEMPAD,
-                        1 + ITEMPAD +i * ITEMHEIGHT + ITEMPAD + xftfont->ascent,
-                        (XftChar8 *) name, strlen(name));
-		} else {
-			XftDrawRect(menu->xftdraw, &bgColorMenu, 0, ITEMPAD + i * ITEMHEIGHT, WIDGET_WIDTH(menu), WIDGET_HEIGHT(menu));
-			XftDrawString8(menu->xftdraw, &fgColorMenu, xftfont,
-			1 + ITEMPAD,
-			1 + ITEMPAD +i * ITEMHEIGHT + ITEMPAD + xftfont->ascent,
-			(XftChar8 *) name, strlen(name));
-		}
-		i++;
+	/* painted when shown */
+	if (!WIDGET_MAPPED(menu)) {
+		menu->stale = 1;
+		return;
 	}
 
-	/* show */
-	if (WIDGET_MAPPED(menu))
+	if (menu->stale)
+		trim(menu);
+	scrolltocurrent(menu);
+
+	if (menu->stale) {
+		fillrect(menu->xftdraw, &bgColorMenu,
+		    0, 0, WIDGET_WIDTH(menu), WIDGET_HEIGHT(menu));
+		for (row = 0; row < menu->nrows; row++)
+			paintrow(menu, row);
 		XCopyArea(display,
 		    menu->pixmap, WIDGET_XWINDOW(menu), menu->gc,
 		    0, 0, WIDGET_WIDTH(menu), WIDGET_HEIGHT(menu), 0, 0);
+		menu->stale = 0;
+	} else {
+		for (row = 0; row < menu->nrows; row++) {
+			i = menu->top + row;
+			ip = i < menu->nshown ? SHOWN(menu, i) : NULL;
+			if (ip != menu->drawn[row] ||
+			    (i == menu->current) != (row == menu->drawnsel)) {
+				paintrow(menu, row);
+				showrow(menu, row);
+			}
+		}
+	}
+	if (menu->current >= menu->top &&
+	    menu->current < menu->top + menu->nrows &&
+	    menu->current < menu->nshown)
+		menu->drawnsel = menu->current - menu->top;
+	else
+		menu->drawnsel = -1;
 }
 
 /*
- * Pop up and activate the menu at position (x, y).
+ * Scroll the view by n rows.
  */
-
-void update_list(struct menu *menu) {
-	struct menuitem *ip;
-	LIST *lp;
-	LIST_FOREACH(lp, &menu->itemlist) {
-		char *name;		
-		ip = LIST_ITEM(lp, struct menuitem, itemlink);
-		name = fetch_icon_name_only(ip->arg);
-		ip->name = STRDUP(name);
-		stringfit(ip->name, MAXWIDTH);
+static void scroll(struct menu *menu, int n)
+{
+	int top;
+
+	top = MIN(menu->top + n, menu->nshown - menu->nrows);
+	top = MAX(top, 0);
+	if (top != menu->top) {
+		menu->top = top;
+		menu->current = -1;
+		menu->stale = 1;
+		REPAINT(menu);
 	}
 }
+
+/*
+ * Pop up and activate the menu at position (x, y).
+ */
 void show_menu(struct menu *menu, int x, int y, int button)
 {
 	int dw = DisplayWidth(display, screen);
 	int dh = DisplayHeight(display, screen);
 	
-	if (LIST_EMPTY(&menu->itemlist))
+	if (menu->nitems == 0)
 		return;
-	///
-	update_list(menu);
+
+	XC_ENTER(XC_MENU);
+	refilter(menu, 0);
 	trim(menu);
+	menu->top = 0;
+	menu->stale = 1;
+	REPAINT(menu);
 	if (x + WIDGET_WIDTH(menu) >= dw)
 		x = MAX(0, x - WIDGET_WIDTH(menu) + 1);
 
@@ -198,7 +403,23 @@ void show_menu(struct menu *menu, int x, int y, int button)
 		    ButtonPressMask | ButtonReleaseMask |
 		    ButtonMotionMask | PointerMotionMask,
 		    GrabModeAsync, GrabModeAsync, None, None, CurrentTime);
+		/* for typing to filter */
+		XGrabKeyboard(display, WIDGET_XWINDOW(menu), False,
+		    GrabModeAsync, GrabModeAsync, CurrentTime);
 	}
+	XC_LEAVE();
+}
+
+/*
+ * Pop up the menu in the middle of the screen.
+ */
+void show_menu_centered(struct menu *menu, int button)
+{
+	trim(menu);
+	show_menu(menu,
+	    DisplayWidth(display, screen) / 2 - WIDGET_WIDTH(menu) / 2,
+	    DisplayHeight(display, screen) / 2 - WIDGET_HEIGHT(menu) / 2,
+	    button);
 }
 
 /*
@@ -207,10 +428,47 @@ void show_menu(struct menu *menu, int x, int y, int button)
 void hide_menu(struct menu *menu)
 {
 	unmap_widget(&menu->widget);
-	if (menu->button != -1)
+	if (menu->button != -1) {
 		XUngrabPointer(display, CurrentTime);
+		XUngrabKeyboard(display, CurrentTime);
+	}
 	menu->current = -1;
+	menu->filterlen = 0;
+	menu->filter[0] = '\0';
+	menu->nshown = menu->nitems;
+}
+
+/*
+ * Narrow the shown items by a typed character, or widen them again
+ * on BackSpace.  Returns nonzero if the key was used.
+ */
+int filter_menu_key(struct menu *menu, XKeyEvent *ep)
+{
+	KeySym keysym;
+	char buf[8];
+	int n;
+
+	n = XLookupString(ep, buf, sizeof buf, &keysym, NULL);
+	if (keysym == XK_BackSpace) {
+		if (menu->filterlen == 0)
+			return 1;
+		menu->filter[--menu->filterlen] = '\0';
+		refilter(menu, 0);
+	} else if (n == 1 && (unsigned char)buf[0] >= ' ' && buf[0] != 0x7f) {
+		if (menu->filterlen == MENUFILTERLEN - 1)
+			return 1;
+		menu->filter[menu->filterlen++] =
+		    tolower((unsigned char)buf[0]);
+		menu->filter[menu->filterlen] = '\0';
+		refilter(menu, menu->filterlen > 1);
+	} else
+		return 0;
+
+	/* the best match is the most recently used */
+	menu->current = menu->nshown > 0 ? 0 : -1;
+	menu->top = 0;
 	REPAINT(menu);
+	return 1;
 }
 
 /*
@@ -239,14 +497,20 @@ static void menuevent(struct widget *widget, XEvent *ep)
 			mp->current = -1;
 		} else {
 			/* On an item */
-			mp->current =
+			mp->current = mp->top +
 			    (ep->xmotion.y - ITEMPAD - 1) / ITEMHEIGHT;
+			if (mp->current >= mp->nshown)
+				mp->current = -1;
 		}
 		if (tmp != mp->current)
 			REPAINT(mp);
 		break;
 	case ButtonPress:
-		if (mp->current == -1 &&
+		if (ep->xbutton.button == Button4)
+			scroll(mp, -1);
+		else if (ep->xbutton.button == Button5)
+			scroll(mp, 1);
+		else if (mp->current == -1 &&
 		    (ep->xbutton.x <= 0 ||
 		     ep->xbutton.x >= WIDGET_WIDTH(mp) - 1 ||
 		     ep->xbutton.y <= 0 ||
@@ -254,6 +518,9 @@ static void menuevent(struct widget *widget, XEvent *ep)
 			mp->current = -2;
 		break;
 	case ButtonRelease:
+		if (ep->xbutton.button == Button4 ||
+		    ep->xbutton.button == Button5)
+			break;
 		if (mp->current == -2)
 			hide_menu(mp);
 		else if (mp->current != -1 &&
@@ -263,6 +530,22 @@ static void menuevent(struct widget *widget, XEvent *ep)
 			hide_menu(mp);
 		}
 		break;
+	case KeyPress:
+		switch (XLookupKeysym(&ep->xkey, 0)) {
+		case XK_Escape:
+			hide_menu(mp);
+			break;
+		case XK_Return:
+			select_current_menuitem(mp);
+			hide_menu(mp);
+			break;
+		default:
+			filter_menu_key(mp, &ep->xkey);
+			break;
+		}
+		break;
+	case KeyRelease:
+		break;
 	case Expose:
 		XCopyArea(display, mp->pixmap, WIDGET_XWINDOW(mp),
 		    mp->gc, ep->xexpose.x, ep->xexpose.y,
@@ -276,18 +559,13 @@ static void menuevent(struct widget *widget, XEvent *ep)
 }
 
 /*
- * Create an empty menu.
+ * Set up the menu's X window and the pixmap it is painted from.
  */
-struct menu *create_menu(void)
+static void setupwindow(struct menu *mp)
 {
 	XSetWindowAttributes attr;
 	XGCValues gcval;
-	struct menu *mp;
-
-	mp = MALLOC(sizeof (struct menu));
 
-	create_widget(&mp->widget, WIDGET_MENU, root, InputOutput,
-	    0, 0, 1, 1, False);
 	attr.save_under = True;
 	XChangeWindowAttributes(display, WIDGET_XWINDOW(mp),
 	    CWSaveUnder, &attr);
@@ -300,64 +578,122 @@ struct menu *create_menu(void)
 	    mp->pixmapwidth = WIDGET_WIDTH(mp),
 	    mp->pixmapheight = WIDGET_HEIGHT(mp),
 	    mp->widget.depth);
+	XRES_HOLD(XRES_PIXMAP);
 	mp->xftdraw = XftDrawCreate(display, mp->pixmap, mp->widget.visual, mp->widget.colormap);
 	//gcval.font = font->fid;
 	gcval.graphics_exposures = False;
 	mp->gc = XCreateGC(display, WIDGET_XWINDOW(mp),
 	    GCGraphicsExposures, &gcval);
+	XRES_HOLD(XRES_GC);
+
+	XSelectInput(display, WIDGET_XWINDOW(mp), ExposureMask);
+}
+
+static void freewindow(struct menu *mp)
+{
+	XFreeGC(display, mp->gc);
+	XftDrawDestroy(mp->xftdraw);
+	XFreePixmap(display, mp->pixmap);
+	XRES_DROP(XRES_GC);
+	XRES_DROP(XRES_PIXMAP);
+}
+
+/*
+ * Create an empty menu.
+ */
+struct menu *create_menu(void)
+{
+	struct menu *mp;
+	int i;
+
+	mp = MALLOC(sizeof (struct menu));
 
-	LIST_INIT(&mp->itemlist);
+	create_widget(&mp->widget, WIDGET_MENU, root, InputOutput,
+	    0, 0, 1, 1, False);
+	setupwindow(mp);
+
+	mp->items = NULL;
 	mp->nitems = 0;
+	mp->itemlim = 0;
+	mp->view = NULL;
+	mp->nshown = 0;
+	mp->filter[0] = '\0';
+	mp->filterlen = 0;
+	mp->top = 0;
+	mp->nrows = 0;
+	mp->widthcount = MALLOC((MAXWIDTH + 1) * sizeof mp->widthcount[0]);
+	for (i = 0; i <= MAXWIDTH; i++)
+		mp->widthcount[i] = 0;
+	mp->maxwidth = 0;
 	mp->current = -1;
+	mp->drawn = NULL;
+	mp->drawnlim = 0;
+	mp->drawnsel = -1;
+	mp->stale = 1;
 
 	mp->widget.event = menuevent;
-	XSelectInput(display, WIDGET_XWINDOW(mp), ExposureMask);
 
 	mp->widget.prepare_repaint = prepare_repaint;
 	mp->widget.repaint = repaint;
 
-	REPAINT(mp);
-
 	return mp;
 }
 
+/*
+ * Move the menu to a window on the visual now in use, as when a
+ * compositor starts or stops.  The items are kept.
+ */
+void redecorate_menu(struct menu *mp)
+{
+	if (WIDGET_MAPPED(mp))
+		hide_menu(mp);
+	freewindow(mp);
+	XDestroyWindow(display,
+	    replace_widget_window(&mp->widget, root, InputOutput));
+	setupwindow(mp);
+	mp->drawnsel = -1;
+	mp->stale = 1;
+}
+
 void destroy_menu(struct menu *mp)
 {
-	struct menuitem *ip;
-	LIST *lp;
+	int i;
 
-	LIST_FOREACH(lp, &mp->itemlist) {
-		ip = LIST_ITEM(lp, struct menuitem, itemlink);
-		LIST_REMOVE(lp);
-		ip->menu = NULL;
-	}
-	XFreeGC(display, mp->gc);
-	XftDrawDestroy(mp->xftdraw);
-	XFreePixmap(display, mp->pixmap);
+	for (i = 0; i < mp->nitems; i++)
+		mp->items[i]->menu = NULL;
+	freewindow(mp);
 	destroy_widget(&mp->widget);
+	FREE(mp->items);
+	FREE(mp->view);
+	FREE(mp->drawn);
+	FREE(mp->widthcount);
 	FREE(mp);
 }
 
 /*
- * Resize the menu so that all items fit.
+ * Resize the menu so that the widest item and as many rows as fit
+ * on the screen are visible.
  */
 static void trim(struct menu *mp)
 {
-	struct menuitem *ip;
-	LIST *lp;
 	int width;
 	int height;
 
-	width = 2 + 2 * ITEMHEIGHT;
-	height = 2 + 2 * ITEMPAD;
-	LIST_FOREACH(lp, &mp->itemlist) {
-		ip = LIST_ITEM(lp, struct menuitem, itemlink);
-		height += ITEMHEIGHT;
-		width = MAX(width,
-		    stringwidth(ip->name) + 2 * (1 + ITEMHEIGHT));
+	mp->nrows = MIN(mp->nitems, MAXROWS);
+	width = MAX(2 + 2 * ITEMHEIGHT, mp->maxwidth + 2 * (1 + ITEMHEIGHT));
+	height = 2 + 2 * ITEMPAD + mp->nrows * ITEMHEIGHT;
+
+	if (mp->nrows > mp->drawnlim) {
+		mp->drawnlim = mp->nrows;
+		mp->drawn = REALLOC(mp->drawn,
+		    mp->drawnlim * sizeof mp->drawn[0]);
+		mp->stale = 1;
 	}
 
-	resize_widget(&mp->widget, width, height);
+	if (width != WIDGET_WIDTH(mp) || height != WIDGET_HEIGHT(mp)) {
+		resize_widget(&mp->widget, width, height);
+		mp->stale = 1;
+	}
 
 	if (width > mp->pixmapwidth || height > mp->pixmapheight) {
 		XFreePixmap(display, mp->pixmap);
@@ -390,21 +726,30 @@ struct menuitem *create_menuitem(struct menu *menu, const char *name,
 
 	ip = MALLOC(sizeof (struct menuitem));
 
-	ip->name = STRDUP(name);
-	stringfit(ip->name, MAXWIDTH);
+	setname(ip, name);
+	settext(ip, name);
+	ip->icon = NULL;
 
 	ip->select = select;
 	ip->arg = arg;
 
 	if (menu == NULL) {
 		ip->menu = NULL;
-		LIST_INIT(&ip->itemlink);
+		ip->index = -1;
 	} else {
 		ip->menu = menu;
-		LIST_INSERT_HEAD(&menu->itemlist, &ip->itemlink);
-		menu->nitems++;
-		trim(menu);
-		REPAINT(menu);
+		if (menu->nitems == menu->itemlim) {
+			menu->itemlim += 32;
+			menu->items = REALLOC(menu->items,
+			    menu->itemlim * sizeof menu->items[0]);
+			menu->view = REALLOC(menu->view,
+			    menu->itemlim * sizeof menu->view[0]);
+		}
+		menu->items[menu->nitems] = ip;
+		ip->index = menu->nitems++;
+		moveitem(menu, ip->index, 0);
+		addwidth(menu, ip->width);
+		invalidate(menu);
 	}
 
 	return ip;
@@ -414,25 +759,60 @@ void rename_menuitem(struct menuitem *item, const char *name)
 {
 	assert(name != NULL);
 
+	if (strcmp(item->rawname, name) == 0)
+		return;
+
+	if (item->menu != NULL)
+		delwidth(item->menu, item->width);
+	FREE(item->rawname);
 	FREE(item->name);
-	item->name = STRDUP(name);
-	stringfit(item->name, MAXWIDTH);
+	setname(item, name);
 
 	if (item->menu != NULL) {
-		trim(item->menu);
-		REPAINT(item->menu);
+		addwidth(item->menu, item->width);
+		invalidate(item->menu);
 	}
 }
 
+/*
+ * Set the text that filtering matches against.
+ */
+void index_menuitem(struct menuitem *item, const char *text)
+{
+	assert(text != NULL);
+
+	if (sametext(item, text))
+		return;
+
+	FREE(item->text);
+	settext(item, text);
+
+	if (item->menu != NULL && item->menu->filterlen > 0)
+		invalidate(item->menu);
+}
+
+void set_menuitem_icon(struct menuitem *item, struct icon *icon)
+{
+	if (item->icon == icon)
+		return;
+	item->icon = icon;
+	if (item->menu != NULL)
+		invalidate(item->menu);
+}
+
 void destroy_menuitem(struct menuitem *item)
 {
-	if (item->menu != NULL) {
-		LIST_REMOVE(&item->itemlink);
-		item->menu->nitems--;
-		trim(item->menu);
-		REPAINT(item->menu);
+	struct menu *menu = item->menu;
+
+	if (menu != NULL) {
+		moveitem(menu, item->index, menu->nitems - 1);
+		menu->nitems--;
+		delwidth(menu, item->width);
+		invalidate(menu);
 	}
 
+	FREE(item->rawname);
 	FREE(item->name);
+	FREE(item->text);
 	FREE(item);
 }
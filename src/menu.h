@@ -25,15 +25,26 @@
 
 #include <X11/Xlib.h>
 
-#include "list.h"
 #include "widget.h"
 
+struct icon;
+
+#define MENUFILTERLEN	64
+
 struct menuitem {
 	struct menu *menu;
-	char *name;
+	char *rawname;		/* name as given */
+	char *name;		/* fitted to the menu width */
+	int width;		/* pixel width of name */
+	int index;		/* position in menu->items */
+	struct icon *icon;	/* not owned by the item */
+
+	/* Lower-cased search text and its trigram signature */
+	char *text;
+	unsigned long long sig;
+
 	void (*select)(void *);
 	void *arg;
-	LIST itemlink;
 };
 
 struct menu { struct widget widget;
@@ -41,15 +52,40 @@ struct menu { struct widget widget;
 	Pixmap pixmap;
 	int pixmapwidth;
 	int pixmapheight;
-	int current;
+	int current;		/* index into view */
 	int button;
+
+	/* The items in most recently used order */
+	struct menuitem **items;
 	int nitems;
-	LIST itemlist;
+	int itemlim;
+
+	/* The items matching filter, in the same order */
+	struct menuitem **view;
+	int nshown;
+	char filter[MENUFILTERLEN];
+	int filterlen;
+
+	/* The visible window onto view */
+	int top;
+	int nrows;
+
+	/* Number of items per name width, for tracking the widest */
+	int *widthcount;
+	int maxwidth;
+
 	XftDraw *xftdraw;
+
+	/* What each row shows on screen */
+	struct menuitem **drawn;
+	int drawnlim;
+	int drawnsel;		/* the row highlighted in the pixmap */
+	int stale;		/* the whole pixmap must be repainted */
 };
 
 struct menu *create_menu(void);
 void destroy_menu(struct menu *);
+void redecorate_menu(struct menu *);
 struct menuitem *create_menuitem(struct menu *, const char *,
     void (*)(void *), void *);
 void destroy_menuitem(struct menuitem *);
@@ -57,7 +93,12 @@ void hide_menu(struct menu *);
 void put_menuitem_first(struct menuitem *);
 void put_menuitem_last(struct menuitem *);
 void show_menu(struct menu *, int, int, int);
+void show_menu_centered(struct menu *, int);
 void rename_menuitem(struct menuitem *, const char *);
+void index_menuitem(struct menuitem *, const char *);
+void set_menuitem_icon(struct menuitem *, struct icon *);
 void select_current_menuitem(struct menu *);
+void *current_menuitem_arg(struct menu *);
+int filter_menu_key(struct menu *, XKeyEvent *);
 
 #endif /* !defined(MENU_H) */
@@ -0,0 +1,242 @@
+/*
+ * record.c - recording of dispatched events for karmen-replay
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The recording holds what karmen saw, not what caused it: the
+ * windows it managed when the recording began, then every event it
+ * dispatched with the time it was received.  The names of atoms in
+ * recorded events are written the first time they appear, since atom
+ * numbers differ between servers.  See record.h for the format.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "global.h"
+#include "latency.h"
+#include "record.h"
+#include "window.h"
+
+static FILE *fp = NULL;
+static long long last;		/* when the last event was received (us) */
+
+/* Atoms already named in the recording */
+static Atom *atoms = NULL;
+static int natoms = 0;
+static int atomlim = 0;
+
+static void putvarint(unsigned long v)
+{
+	while (v >= 0x80) {
+		putc((v & 0x7f) | 0x80, fp);
+		v >>= 7;
+	}
+	putc(v, fp);
+}
+
+static void putsigned(long v)
+{
+	putvarint(((unsigned long)v << 1) ^ (v < 0 ? ~0UL : 0));
+}
+
+static void putstring(const char *s)
+{
+	size_t len = s == NULL ? 0 : strlen(s);
+
+	putvarint(len);
+	fwrite(s, 1, len, fp);
+}
+
+/*
+ * Start recording to the named file.  Returns -1 on failure.
+ */
+int record_open(const char *path)
+{
+	if ((fp = fopen(path, "wb")) == NULL) {
+		error("%s: %s", path, strerror(errno));
+		return -1;
+	}
+	setvbuf(fp, NULL, _IOFBF, 65536);
+	fwrite(RECORD_MAGIC, 1, strlen(RECORD_MAGIC), fp);
+	putvarint(sizeof (long));
+	putvarint(sizeof (XEvent));
+	putvarint(root);
+	putvarint(DisplayWidth(display, screen));
+	putvarint(DisplayHeight(display, screen));
+	putvarint(time(NULL));
+	last = now_us();
+	return 0;
+}
+
+/*
+ * Write the managed windows, bottom to top.
+ */
+void record_windows(void)
+{
+	struct window **wins;
+	unsigned width, height, border, depth;
+	Window dummy;
+	int i, n, x, y;
+
+	if (fp == NULL)
+		return;
+	get_window_stack(&wins, &n);
+	clerr();
+	for (i = n - 1; i >= 0; i--) {
+		if (!XGetGeometry(display, wins[i]->client, &dummy, &x, &y,
+		    &width, &height, &border, &depth) ||
+		    !XTranslateCoordinates(display, wins[i]->client, root,
+		    0, 0, &x, &y, &dummy))
+			continue;
+		putc(REC_WINDOW, fp);
+		putvarint(wins[i]->client);
+		putsigned(x);
+		putsigned(y);
+		putvarint(width);
+		putvarint(height);
+		putvarint(border);
+		putvarint(WIDGET_MAPPED(wins[i]));
+		putstring(wins[i]->name);
+		putstring(wins[i]->wmclass);
+	}
+	sterr();
+	FREE(wins);
+}
+
+static void nameatom(Atom atom)
+{
+	char *name;
+	int i;
+
+	if (atom == None)
+		return;
+	for (i = 0; i < natoms; i++)
+		if (atoms[i] == atom)
+			return;
+	if (natoms == atomlim) {
+		atomlim = LARGER(atomlim);
+		atoms = REALLOC(atoms, atomlim * sizeof atoms[0]);
+	}
+	atoms[natoms++] = atom;
+
+	clerr();
+	name = XGetAtomName(display, atom);
+	sterr();
+	if (name == NULL)
+		return;
+	putc(REC_ATOM, fp);
+	putvarint(atom);
+	putstring(name);
+	XFree(name);
+}
+
+/*
+ * Name the atoms an event refers to: property names, message types
+ * and the atoms carried by the messages that carry atoms.
+ */
+static void nameatoms(XEvent *ep)
+{
+	static Atom WM_PROTOCOLS = None, NET_WM_STATE = None;
+	Atom type;
+
+	if (ep->type == PropertyNotify)
+		nameatom(ep->xproperty.atom);
+	else if (ep->type == ClientMessage) {
+		if (WM_PROTOCOLS == None) {
+			WM_PROTOCOLS = XInternAtom(display, "WM_PROTOCOLS",
+			    False);
+			NET_WM_STATE = XInternAtom(display, "_NET_WM_STATE",
+			    False);
+		}
+		type = ep->xclient.message_type;
+		nameatom(type);
+		if (ep->xclient.format != 32)
+			return;
+		if (type == WM_PROTOCOLS)
+			nameatom(ep->xclient.data.l[0]);
+		else if (type == NET_WM_STATE) {
+			nameatom(ep->xclient.data.l[1]);
+			nameatom(ep->xclient.data.l[2]);
+		}
+	}
+}
+
+/*
+ * Write an event received at the given time (see now_us()).
+ */
+void record_event(XEvent *ep, long long received)
+{
+	union {
+		XEvent ev;
+		unsigned long word[RECORD_NWORDS];
+	} u;
+	int i, n;
+
+	if (fp == NULL)
+		return;
+	nameatoms(ep);
+
+	memset(&u, 0, sizeof u);
+	u.ev = *ep;
+	u.ev.xany.display = NULL;
+	u.ev.xany.serial = 0;
+	for (n = RECORD_NWORDS; n > 0 && u.word[n - 1] == 0; n--)
+		;
+
+	putc(REC_EVENT, fp);
+	putvarint(received > last ? received - last : 0);
+	putvarint(n);
+	for (i = 0; i < n; i++)
+		putvarint(u.word[i]);
+	last = MAX(last, received);
+}
+
+/*
+ * Write out what is buffered, while there is nothing else to do.
+ */
+void record_flush(void)
+{
+	if (fp != NULL && fflush(fp) == EOF) {
+		error("recording: %s", strerror(errno));
+		record_close();
+	}
+}
+
+void record_close(void)
+{
+	if (fp != NULL) {
+		fclose(fp);
+		fp = NULL;
+	}
+	FREE(atoms);
+	atoms = NULL;
+	natoms = atomlim = 0;
+}
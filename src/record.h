@@ -0,0 +1,58 @@
+#if !defined(RECORD_H)
+#define RECORD_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <X11/Xlib.h>
+
+/*
+ * Recordings start with RECORD_MAGIC and a header of varints: the
+ * size of a long and of an XEvent on the recording machine, the root
+ * window, the screen size and the time the recording began.  Records
+ * follow, each a tag and varints:
+ *
+ *   REC_WINDOW	client, x, y, width, height, border, mapped, name, class
+ *   REC_ATOM	atom, name
+ *   REC_EVENT	us since the previous event, n, n words of the XEvent
+ *
+ * Strings are a length and that many bytes; x and y are zigzag coded.
+ * Event words are the XEvent as an array of longs, with the display
+ * and serial cleared and trailing zero words left out.
+ */
+#define RECORD_MAGIC	"KARMREC1"
+
+enum {
+	REC_WINDOW = 1,
+	REC_ATOM,
+	REC_EVENT
+};
+
+#define RECORD_NWORDS	(sizeof (XEvent) / sizeof (long))
+
+int record_open(const char *);
+void record_windows(void);
+void record_event(XEvent *, long long);
+void record_flush(void);
+void record_close(void);
+
+#endif /* !defined(RECORD_H) */
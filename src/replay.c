@@ -0,0 +1,739 @@
+/*
+ * replay.c - replay a karmen recording against a window manager
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A recording (see record.h) holds the events karmen dispatched.
+ * Replaying means causing the same events again: the recorded client
+ * windows are recreated, and each event is turned back into the
+ * request or input that produces it, with windows and atoms mapped
+ * to their counterparts on this server.  Events that were karmen's
+ * own doing (exposures, notifications of its own requests) follow
+ * by themselves and are not replayed.  Pointer and keyboard input
+ * needs XTest.
+ *
+ * Events are replayed at the recorded pace times -speed, or as fast
+ * as possible with -speed 0, in which case the run doubles as a
+ * benchmark: the result is one JSON line with the time it took and,
+ * given the pid of the window manager, the CPU time it used.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#if CONFIG_XTEST
+#include <X11/extensions/XTest.h>
+#endif
+
+#include "record.h"
+
+/* How long to wait for the window manager before giving up (ms) */
+#define TIMEOUT		5000
+
+/* Events between reading what the server sent us */
+#define DRAINEVERY	256
+
+struct client {
+	unsigned long recorded;
+	Window window;
+	int iconic;		/* unmapped when the recording began */
+};
+
+struct atom {
+	unsigned long recorded;
+	Atom atom;
+	char *name;
+};
+
+static Display *display;
+static Window root;
+static unsigned long recroot;
+static FILE *fp;
+
+static struct client *clients = NULL;
+static int nclients = 0, clientlim = 0;
+
+static struct atom *atoms = NULL;
+static int natoms = 0, atomlim = 0;
+
+static int wmpid = 0;
+static int xtest = 0;
+static int timeouts = 0;
+static unsigned long replayed = 0, skipped = 0;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*
+ * CPU time used by the window manager so far, in ms.
+ */
+static double wmcpu(void)
+{
+	unsigned long utime, stime;
+	char path[64];
+	FILE *pfp;
+	int n;
+
+	if (wmpid == 0)
+		return 0;
+	snprintf(path, sizeof path, "/proc/%d/stat", wmpid);
+	if ((pfp = fopen(path, "r")) == NULL)
+		return 0;
+	n = fscanf(pfp, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+	    "%lu %lu", &utime, &stime);
+	fclose(pfp);
+	if (n != 2)
+		return 0;
+	return (utime + stime) * 1e3 / sysconf(_SC_CLK_TCK);
+}
+
+static void *xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL) {
+		perror("karmen-replay");
+		exit(1);
+	}
+	return p;
+}
+
+static void truncated(void)
+{
+	fprintf(stderr, "karmen-replay: recording is truncated\n");
+	exit(1);
+}
+
+/*
+ * Read a varint.  Returns zero at the end of the file.
+ */
+static int getvarint(unsigned long *vp)
+{
+	unsigned long v = 0;
+	int c, shift = 0;
+
+	do {
+		if ((c = getc(fp)) == EOF) {
+			if (shift > 0)
+				truncated();
+			return 0;
+		}
+		v |= (unsigned long)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	*vp = v;
+	return 1;
+}
+
+static unsigned long need(void)
+{
+	unsigned long v;
+
+	if (!getvarint(&v))
+		truncated();
+	return v;
+}
+
+static long needsigned(void)
+{
+	unsigned long v = need();
+
+	return (long)(v >> 1) ^ -(long)(v & 1);
+}
+
+static char *needstring(void)
+{
+	unsigned long len = need();
+	char *s;
+
+	s = xrealloc(NULL, len + 1);
+	if (fread(s, 1, len, fp) != len)
+		truncated();
+	s[len] = '\0';
+	return s;
+}
+
+/*
+ * Wait for an event of the given type on w.  Returns zero on timeout.
+ */
+static int waitfor(Window w, int type, XEvent *ep)
+{
+	struct pollfd pfd;
+	double deadline = now() + TIMEOUT;
+	int ms;
+
+	pfd.fd = ConnectionNumber(display);
+	pfd.events = POLLIN;
+	for (;;) {
+		if (XCheckTypedWindowEvent(display, w, type, ep))
+			return 1;
+		if ((ms = deadline - now()) <= 0) {
+			timeouts++;
+			return 0;
+		}
+		if (poll(&pfd, 1, ms) == -1 && errno != EINTR) {
+			perror("poll");
+			exit(1);
+		}
+		XEventsQueued(display, QueuedAfterReading);
+	}
+}
+
+static void drain(void)
+{
+	XEvent e;
+
+	while (XPending(display))
+		XNextEvent(display, &e);
+}
+
+static struct client *findclient(unsigned long recorded)
+{
+	int i;
+
+	for (i = 0; i < nclients; i++)
+		if (clients[i].recorded == recorded)
+			return &clients[i];
+	return NULL;
+}
+
+/*
+ * Map a recorded window to ours: the root, a client we made, or None.
+ */
+static Window window(unsigned long recorded)
+{
+	struct client *cp;
+
+	if (recorded == recroot)
+		return root;
+	return (cp = findclient(recorded)) != NULL ? cp->window : None;
+}
+
+static Window mkclient(unsigned long recorded, int x, int y,
+    unsigned width, unsigned height, unsigned border,
+    const char *name, const char *wmclass)
+{
+	XClassHint ch;
+	char *class, *s;
+	Window w;
+
+	w = XCreateSimpleWindow(display, root, x, y,
+	    width > 0 ? width : 1, height > 0 ? height : 1, border,
+	    BlackPixel(display, DefaultScreen(display)),
+	    WhitePixel(display, DefaultScreen(display)));
+	XSelectInput(display, w, StructureNotifyMask);
+	XStoreName(display, w, name != NULL ? name : "karmen-replay");
+
+	/* karmen keeps WM_CLASS as "name class" */
+	if (wmclass != NULL && *wmclass != '\0') {
+		class = strdup(wmclass);
+		if (class != NULL) {
+			if ((s = strchr(class, ' ')) != NULL)
+				*s++ = '\0';
+			ch.res_name = class;
+			ch.res_class = s != NULL ? s : class;
+			XSetClassHint(display, w, &ch);
+			free(class);
+		}
+	}
+
+	if (nclients == clientlim) {
+		clientlim = clientlim == 0 ? 64 : 2 * clientlim;
+		clients = xrealloc(clients, clientlim * sizeof clients[0]);
+	}
+	clients[nclients].recorded = recorded;
+	clients[nclients].window = w;
+	clients[nclients].iconic = 0;
+	nclients++;
+	return w;
+}
+
+static void forget(unsigned long recorded)
+{
+	struct client *cp;
+
+	if ((cp = findclient(recorded)) != NULL)
+		*cp = clients[--nclients];
+}
+
+static struct atom *findatom(unsigned long recorded)
+{
+	int i;
+
+	for (i = 0; i < natoms; i++)
+		if (atoms[i].recorded == recorded)
+			return &atoms[i];
+	return NULL;
+}
+
+/*
+ * Map a recorded atom to ours.  Predefined atoms are the same
+ * everywhere; others must have been named in the recording.
+ */
+static Atom atom(unsigned long recorded)
+{
+	struct atom *ap;
+
+	if (recorded <= XA_LAST_PREDEFINED)
+		return recorded;
+	return (ap = findatom(recorded)) != NULL ? ap->atom : None;
+}
+
+static const char *atomname(unsigned long recorded)
+{
+	struct atom *ap = findatom(recorded);
+
+	return ap != NULL ? ap->name : "";
+}
+
+static void readatom(void)
+{
+	unsigned long recorded = need();
+	char *name = needstring();
+
+	if (natoms == atomlim) {
+		atomlim = atomlim == 0 ? 64 : 2 * atomlim;
+		atoms = xrealloc(atoms, atomlim * sizeof atoms[0]);
+	}
+	atoms[natoms].recorded = recorded;
+	atoms[natoms].atom = XInternAtom(display, name, False);
+	atoms[natoms].name = name;
+	natoms++;
+}
+
+static void readwindow(void)
+{
+	unsigned long recorded;
+	unsigned long width, height, border, mapped;
+	char *name, *wmclass;
+	long x, y;
+	Window w;
+
+	recorded = need();
+	x = needsigned();
+	y = needsigned();
+	width = need();
+	height = need();
+	border = need();
+	mapped = need();
+	name = needstring();
+	wmclass = needstring();
+
+	w = mkclient(recorded, x, y, width, height, border, name, wmclass);
+	clients[nclients - 1].iconic = !mapped;
+	XMapWindow(display, w);
+	free(name);
+	free(wmclass);
+}
+
+/*
+ * Make a property change that the window manager will be told
+ * about.  Names get a new value so that titles are redrawn; other
+ * properties are appended nothing to, which keeps their value.
+ */
+static void touch(Window w, unsigned long recorded)
+{
+	static int count = 0;
+	unsigned long n, after;
+	unsigned char *data;
+	const char *name;
+	char text[32];
+	Atom a, type;
+	int format;
+
+	if ((a = atom(recorded)) == None) {
+		skipped++;
+		return;
+	}
+	name = a <= XA_LAST_PREDEFINED ? "" : atomname(recorded);
+	snprintf(text, sizeof text, "karmen-replay %d", ++count);
+	if (a == XA_WM_NAME || a == XA_WM_ICON_NAME)
+		XChangeProperty(display, w, a, XA_STRING, 8, PropModeReplace,
+		    (unsigned char *)text, strlen(text));
+	else if (strcmp(name, "_NET_WM_NAME") == 0 ||
+	    strcmp(name, "_NET_WM_ICON_NAME") == 0)
+		XChangeProperty(display, w, a,
+		    XInternAtom(display, "UTF8_STRING", False), 8,
+		    PropModeReplace, (unsigned char *)text, strlen(text));
+	else {
+		if (XGetWindowProperty(display, w, a, 0, 0, False,
+		    AnyPropertyType, &type, &format, &n, &after, &data)
+		    != Success)
+			type = None;
+		if (data != NULL)
+			XFree(data);
+		if (type == None) {
+			skipped++;
+			return;
+		}
+		XChangeProperty(display, w, a, type, format, PropModeAppend,
+		    (unsigned char *)"", 0);
+	}
+	replayed++;
+}
+
+static void message(XClientMessageEvent *ep)
+{
+	const char *type;
+	int i;
+
+	ep->window = window(ep->window);
+	ep->message_type = atom(ep->message_type);
+	if (ep->window == None || ep->message_type == None) {
+		skipped++;
+		return;
+	}
+	if (ep->format == 32) {
+		type = atomname(ep->message_type);
+		for (i = 0; i < 5; i++)
+			if (findclient(ep->data.l[i]) != NULL)
+				ep->data.l[i] = window(ep->data.l[i]);
+		if (strcmp(type, "WM_PROTOCOLS") == 0)
+			ep->data.l[0] = atom(ep->data.l[0]);
+		else if (strcmp(type, "_NET_WM_STATE") == 0) {
+			ep->data.l[1] = atom(ep->data.l[1]);
+			ep->data.l[2] = atom(ep->data.l[2]);
+		}
+	}
+	ep->send_event = True;
+	XSendEvent(display, root, False,
+	    SubstructureRedirectMask | SubstructureNotifyMask, (XEvent *)ep);
+	replayed++;
+}
+
+static void configure(XConfigureRequestEvent *ep, Window w)
+{
+	XWindowChanges wc;
+	unsigned mask = ep->value_mask;
+
+	wc.x = ep->x;
+	wc.y = ep->y;
+	wc.width = ep->width;
+	wc.height = ep->height;
+	wc.border_width = ep->border_width;
+	wc.stack_mode = ep->detail;
+	if ((mask & CWSibling) && (wc.sibling = window(ep->above)) == None)
+		mask &= ~(CWSibling | CWStackMode);
+	XConfigureWindow(display, w, mask, &wc);
+	replayed++;
+}
+
+static void input(XEvent *ep)
+{
+#if CONFIG_XTEST
+	switch (ep->type) {
+	case ButtonPress:
+	case ButtonRelease:
+		XTestFakeMotionEvent(display, -1, ep->xbutton.x_root,
+		    ep->xbutton.y_root, CurrentTime);
+		XTestFakeButtonEvent(display, ep->xbutton.button,
+		    ep->type == ButtonPress, CurrentTime);
+		break;
+	case MotionNotify:
+		XTestFakeMotionEvent(display, -1, ep->xmotion.x_root,
+		    ep->xmotion.y_root, CurrentTime);
+		break;
+	case KeyPress:
+	case KeyRelease:
+		XTestFakeKeyEvent(display, ep->xkey.keycode,
+		    ep->type == KeyPress, CurrentTime);
+		break;
+	}
+	replayed++;
+#else
+	skipped++;
+#endif
+}
+
+static void replay(XEvent *ep)
+{
+	Window w;
+
+	switch (ep->type) {
+	case CreateNotify:
+		if (ep->xcreatewindow.parent == recroot &&
+		    !ep->xcreatewindow.override_redirect &&
+		    findclient(ep->xcreatewindow.window) == NULL) {
+			mkclient(ep->xcreatewindow.window,
+			    ep->xcreatewindow.x, ep->xcreatewindow.y,
+			    ep->xcreatewindow.width, ep->xcreatewindow.height,
+			    ep->xcreatewindow.border_width, NULL, NULL);
+			replayed++;
+		} else
+			skipped++;
+		break;
+	case MapRequest:
+		if ((w = window(ep->xmaprequest.window)) != None) {
+			XMapWindow(display, w);
+			replayed++;
+		} else
+			skipped++;
+		break;
+	case ConfigureRequest:
+		if ((w = window(ep->xconfigurerequest.window)) != None)
+			configure(&ep->xconfigurerequest, w);
+		else
+			skipped++;
+		break;
+	case PropertyNotify:
+		if ((w = window(ep->xproperty.window)) == None || w == root)
+			skipped++;
+		else if (ep->xproperty.state == PropertyDelete) {
+			XDeleteProperty(display, w, atom(ep->xproperty.atom));
+			replayed++;
+		} else
+			touch(w, ep->xproperty.atom);
+		break;
+	case ClientMessage:
+		message(&ep->xclient);
+		break;
+	case UnmapNotify:
+		/* only a client withdrawing its window, see ICCCM 4.1.4 */
+		if (ep->xunmap.send_event &&
+		    (w = window(ep->xunmap.window)) != None && w != root) {
+			XWithdrawWindow(display, w, DefaultScreen(display));
+			replayed++;
+		} else
+			skipped++;
+		break;
+	case DestroyNotify:
+		if ((w = window(ep->xdestroywindow.window)) != None &&
+		    w != root) {
+			XDestroyWindow(display, w);
+			forget(ep->xdestroywindow.window);
+			replayed++;
+		} else
+			skipped++;
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+	case MotionNotify:
+	case KeyPress:
+	case KeyRelease:
+		input(ep);
+		break;
+	default:
+		/* a consequence of what karmen itself did */
+		skipped++;
+		break;
+	}
+}
+
+static void readheader(void)
+{
+	char magic[sizeof RECORD_MAGIC - 1];
+	unsigned long longsize, eventsize, width, height;
+
+	if (fread(magic, 1, sizeof magic, fp) != sizeof magic ||
+	    memcmp(magic, RECORD_MAGIC, sizeof magic) != 0) {
+		fprintf(stderr, "karmen-replay: not a karmen recording\n");
+		exit(1);
+	}
+	longsize = need();
+	eventsize = need();
+	if (longsize != sizeof (long) || eventsize != sizeof (XEvent)) {
+		fprintf(stderr, "karmen-replay: recorded on another kind "
+		    "of machine\n");
+		exit(1);
+	}
+	recroot = need();
+	width = need();
+	height = need();
+	(void)need();	/* when it was recorded */
+	if (width != DisplayWidth(display, DefaultScreen(display)) ||
+	    height != DisplayHeight(display, DefaultScreen(display)))
+		fprintf(stderr, "karmen-replay: recorded on a %lux%lu "
+		    "screen, input will not line up\n", width, height);
+}
+
+/*
+ * Wait until the window manager has framed every client made so far,
+ * then iconify those that were iconic.
+ */
+static void settle(void)
+{
+	XEvent e;
+	int i;
+
+	XFlush(display);
+	for (i = 0; i < nclients; i++)
+		waitfor(clients[i].window, ReparentNotify, &e);
+	for (i = 0; i < nclients; i++)
+		if (clients[i].iconic)
+			XIconifyWindow(display, clients[i].window,
+			    DefaultScreen(display));
+	XSync(display, False);
+	drain();
+}
+
+/*
+ * Wait until the window manager has caught up with everything sent
+ * so far: move a window of our own and wait for the notification.
+ */
+static void sync_wm(Window probe)
+{
+	XEvent e;
+
+	drain();
+	XMoveWindow(display, probe, 1, 0);
+	XFlush(display);
+	waitfor(probe, ConfigureNotify, &e);
+}
+
+static void usage(FILE *out)
+{
+	fprintf(out,
+"usage: karmen-replay [-display name] [-p pid] [-speed factor] file\n");
+}
+
+int main(int argc, char *argv[])
+{
+	union {
+		XEvent ev;
+		unsigned long word[RECORD_NWORDS];
+	} u;
+	char *dpyname = NULL;
+	double speed = 1, start, recorded = 0, t, wall, cpu;
+	unsigned long tag, dt, n, events = 0;
+	Window probe;
+	XEvent e;
+	int i, started = 0;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-display") == 0 && i + 1 < argc)
+			dpyname = argv[++i];
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			wmpid = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-speed") == 0 && i + 1 < argc)
+			speed = atof(argv[++i]);
+		else if (strcmp(argv[i], "-help") == 0) {
+			usage(stdout);
+			return 0;
+		} else {
+			usage(stderr);
+			return 2;
+		}
+	}
+	if (i != argc - 1 || speed < 0) {
+		usage(stderr);
+		return 2;
+	}
+
+	if ((fp = fopen(argv[i], "rb")) == NULL) {
+		perror(argv[i]);
+		return 1;
+	}
+	if ((display = XOpenDisplay(dpyname)) == NULL) {
+		fprintf(stderr, "karmen-replay: can't open display %s\n",
+		    XDisplayName(dpyname));
+		return 1;
+	}
+	root = DefaultRootWindow(display);
+#if CONFIG_XTEST
+	{
+		int d;
+
+		xtest = XTestQueryExtension(display, &d, &d, &d, &d);
+	}
+#endif
+	readheader();
+
+	probe = XCreateSimpleWindow(display, root, 0, 0, 1, 1, 0, 0, 0);
+	XSelectInput(display, probe, StructureNotifyMask);
+	XStoreName(display, probe, "karmen-replay");
+	XMapWindow(display, probe);
+	if (!waitfor(probe, ReparentNotify, &e)) {
+		fprintf(stderr, "karmen-replay: no window manager\n");
+		return 1;
+	}
+
+	start = now();
+	cpu = wmcpu();
+	while (getvarint(&tag)) {
+		switch (tag) {
+		case REC_WINDOW:
+			readwindow();
+			break;
+		case REC_ATOM:
+			readatom();
+			break;
+		case REC_EVENT:
+			dt = need();
+			n = need();
+			if (n > RECORD_NWORDS)
+				truncated();
+			memset(&u, 0, sizeof u);
+			for (i = 0; i < n; i++)
+				u.word[i] = need();
+
+			/* the initial windows come first */
+			if (!started) {
+				settle();
+				start = now();
+				cpu = wmcpu();
+				started = 1;
+			}
+			recorded += dt / 1e3;
+			if (speed > 0 && (t = start + recorded / speed - now())
+			    > 0) {
+				XFlush(display);
+				usleep(t * 1e3);
+			}
+			u.ev.xany.display = display;
+			replay(&u.ev);
+			if (++events % DRAINEVERY == 0)
+				drain();
+			break;
+		default:
+			fprintf(stderr, "karmen-replay: unknown record %lu\n",
+			    tag);
+			return 1;
+		}
+	}
+	if (!started)
+		settle();
+	sync_wm(probe);
+	wall = now() - start;
+
+	printf("{\"replay\": \"%s\", \"events\": %lu, \"replayed\": %lu, "
+	    "\"skipped\": %lu, \"xtest\": %d, \"speed\": %g, "
+	    "\"recorded_ms\": %.1f, \"wall_ms\": %.1f, \"wm_cpu_ms\": %.1f, "
+	    "\"timeouts\": %d}\n",
+	    argv[argc - 1], events, replayed, skipped, xtest, speed,
+	    recorded, wall, wmpid != 0 ? wmcpu() - cpu : 0, timeouts);
+	XCloseDisplay(display);
+	return 0;
+}
@@ -36,6 +36,7 @@
 #include "global.h"
 #include "menu.h"
 #include "resizer.h"
+#include "stats.h"
 #include "window.h"
 
 #define PADDING		MAX(1, (xftfont->ascent + xftfont->descent) / 4)
@@ -95,6 +96,7 @@ static struct sizewin *create_sizewin(struct window *win, int xdim, int ydim)
 	gcval.graphics_exposures = False;
 	sizewin->gc = XCreateGC(display, WIDGET_XWINDOW(sizewin),
 	    GCGraphicsExposures, &gcval);
+	XRES_HOLD(XRES_GC);
 	sizewin->window = win;
 	update_sizewin(sizewin, xdim, ydim);
 	return sizewin;
@@ -103,6 +105,7 @@ static struct sizewin *create_sizewin(struct window *win, int xdim, int ydim)
 static void destroy_sizewin(struct sizewin *sizewin)
 {
 	XFreeGC(display, sizewin->gc);
+	XRES_DROP(XRES_GC);
 	destroy_widget(&sizewin->widget);
 	FREE(sizewin);
 }
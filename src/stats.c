@@ -0,0 +1,295 @@
+/*
+ * stats.c - live statistics over a Unix domain socket
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Every client that connects to the statistics socket is sent one
+ * snapshot, as lines of "name value", and is then disconnected.
+ * Nothing is read from clients and nothing is ever waited for: the
+ * snapshot goes out in one non-blocking write, and whatever does
+ * not fit in the socket buffer is dropped.  Names that end in
+ * "_total" are counters; all others are current values.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "global.h"
+#include "hist.h"
+#include "icon.h"
+#include "latency.h"
+#include "stats.h"
+#include "throttle.h"
+#include "widget.h"
+#include "window.h"
+#include "xcount.h"
+#if CONFIG_XRES
+#include "xres.h"
+#endif
+
+/* Most clients served per call to stats_serve() */
+#define MAXSERVE	16
+
+long xresources[NXRES];
+
+static const char *xresnames[NXRES] = {
+	[XRES_PIXMAP] = "pixmaps",
+	[XRES_PICTURE] = "pictures",
+	[XRES_GC] = "gcs",
+	[XRES_COLORMAP] = "colormaps",
+};
+
+static int listenfd = -1;
+static char *sockpath = NULL;
+static const struct loadstats *load = NULL;
+static long started;
+
+/*
+ * Return the default socket path for the display, which the caller
+ * must free: $XDG_RUNTIME_DIR/karmen-uid-display, or under /tmp.
+ */
+char *stats_path(const char *displayname)
+{
+	const char *dir;
+	char *path, *p;
+	size_t len;
+
+	if ((dir = getenv("XDG_RUNTIME_DIR")) == NULL || *dir == '\0')
+		dir = "/tmp";
+	len = strlen(dir) + strlen(displayname) + 32;
+	path = MALLOC(len);
+	snprintf(path, len, "%s/karmen-%d-", dir, (int)getuid());
+	for (p = path + strlen(path); *displayname != '\0'; displayname++)
+		*p++ = *displayname == '/' ? '_' : *displayname;
+	*p = '\0';
+	return path;
+}
+
+/*
+ * Listen on the given path.  Failure is not fatal, there will just be
+ * no statistics.
+ */
+void stats_init(const char *path, const struct loadstats *lp)
+{
+	struct sockaddr_un addr;
+	mode_t mask;
+
+	load = lp;
+	started = now_ms();
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof addr.sun_path) {
+		error("statistics socket path too long: %s", path);
+		return;
+	}
+	strcpy(addr.sun_path, path);
+
+	if ((listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		error("socket: %s", strerror(errno));
+		return;
+	}
+	fcntl(listenfd, F_SETFL, O_NONBLOCK);
+	fcntl(listenfd, F_SETFD, FD_CLOEXEC);
+
+	/* only the owner may connect */
+	unlink(path);
+	mask = umask(077);
+	if (bind(listenfd, (struct sockaddr *)&addr, sizeof addr) == -1 ||
+	    listen(listenfd, MAXSERVE) == -1) {
+		umask(mask);
+		error("%s: %s", path, strerror(errno));
+		close(listenfd);
+		listenfd = -1;
+		return;
+	}
+	umask(mask);
+	sockpath = STRDUP(path);
+	debug("statistics on %s", sockpath);
+}
+
+void stats_fini(void)
+{
+	if (listenfd != -1) {
+		close(listenfd);
+		listenfd = -1;
+		unlink(sockpath);
+	}
+	FREE(sockpath);
+	sockpath = NULL;
+}
+
+int stats_fd(void)
+{
+	return listenfd;
+}
+
+static void puthist(FILE *fp, const char *prefix, const char *name,
+    const struct hist *hp)
+{
+	fprintf(fp, "%s.%s_total %lu\n", prefix, name, hp->count);
+	fprintf(fp, "%s.%s.p50 %lu\n", prefix, name, hist_percentile(hp, .50));
+	fprintf(fp, "%s.%s.p99 %lu\n", prefix, name, hist_percentile(hp, .99));
+	fprintf(fp, "%s.%s.max %lu\n", prefix, name, hp->max);
+}
+
+static void putcache(FILE *fp, const char *name, const struct cachestats *cp)
+{
+	fprintf(fp, "cache.%s.hits_total %lu\n", name, cp->hits);
+	fprintf(fp, "cache.%s.misses_total %lu\n", name, cp->misses);
+	fprintf(fp, "cache.%s.entries %ld\n", name, cp->entries);
+}
+
+static long rsskb(void)
+{
+	FILE *fp;
+	long size, resident;
+
+	if ((fp = fopen("/proc/self/statm", "r")) == NULL)
+		return -1;
+	if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+		resident = -1;
+	fclose(fp);
+	return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void collect(FILE *fp)
+{
+	const struct repaintstats *rp = repaint_stats();
+	const struct heapstats *mp = heap_stats();
+	const struct hist *hp;
+	const char *name;
+	unsigned long allowed, throttled;
+	long rss;
+	int i;
+
+	fprintf(fp, "uptime_ms %ld\n", now_ms() - started);
+	fprintf(fp, "windows %d\n", window_count());
+	fprintf(fp, "widgets %d\n", widget_count());
+	for (i = 0; i < NXRES; i++)
+		fprintf(fp, "xres.%s %ld\n", xresnames[i], xresources[i]);
+	if ((rss = rsskb()) != -1)
+		fprintf(fp, "rss_kb %ld\n", rss);
+	fprintf(fp, "heap.blocks %ld\n", mp->blocks);
+	fprintf(fp, "heap.bytes %ld\n", mp->bytes);
+	fprintf(fp, "heap.allocs_total %lu\n", mp->allocs);
+	fprintf(fp, "heap.frees_total %lu\n", mp->frees);
+#if CONFIG_XRES
+	xres_collect(fp);
+#endif
+
+	fprintf(fp, "repaint.depth %u\n", rp->depth);
+	fprintf(fp, "repaint.maxdepth %u\n", rp->maxdepth);
+	fprintf(fp, "repaint.passes_total %lu\n", rp->passes);
+	fprintf(fp, "repaint.painted_total %lu\n", rp->painted);
+	fprintf(fp, "repaint.merged_total %lu\n", rp->merged);
+	fprintf(fp, "repaint.yields_total %lu\n", rp->yields);
+	fprintf(fp, "repaint.us_total %lld\n", rp->totalus);
+	fprintf(fp, "repaint.maxus %ld\n", rp->maxus);
+
+	fprintf(fp, "load.overloaded %d\n", overloaded);
+	if (load != NULL) {
+		fprintf(fp, "load.episodes_total %lu\n", load->episodes);
+		fprintf(fp, "load.ms_total %ld\n", load->totalms);
+		fprintf(fp, "load.maxms %ld\n", load->maxms);
+		fprintf(fp, "load.deepest %d\n", load->deepest);
+	}
+
+	putcache(fp, "text", text_cache_stats());
+	putcache(fp, "icon", icon_cache_stats());
+	putcache(fp, "property", property_stats());
+
+	for (i = 0; i < NTHROTTLE; i++) {
+		throttle_totals(i, &allowed, &throttled);
+		fprintf(fp, "throttle.%s.allowed_total %lu\n",
+		    throttle_name(i), allowed);
+		fprintf(fp, "throttle.%s.throttled_total %lu\n",
+		    throttle_name(i), throttled);
+	}
+
+#if CONFIG_XCOUNT
+	for (i = 0; i < NXSUBSYS; i++) {
+		const struct xcount *cp = xcount_get(i);
+
+		name = xcount_name(i);
+		fprintf(fp, "x.%s.calls_total %lu\n", name, cp->calls);
+		fprintf(fp, "x.%s.requests_total %lu\n", name, cp->requests);
+		fprintf(fp, "x.%s.flushes_total %lu\n", name, cp->flushes);
+		fprintf(fp, "x.%s.bytes_total %lu\n", name, cp->bytes);
+		fprintf(fp, "x.%s.roundtrips_total %lu\n", name,
+		    cp->roundtrips);
+		fprintf(fp, "x.%s.grabs_total %lu\n", name, cp->grabs);
+	}
+#endif
+
+	/* latencies in us; only what has been seen */
+	for (i = 0; (hp = latency_by_event(i, &name)) != NULL; i++)
+		if (hp->count > 0)
+			puthist(fp, "event", name, hp);
+	for (i = 0; (hp = latency_by_handler(i, &name)) != NULL; i++)
+		if (hp->count > 0)
+			puthist(fp, "handler", name, hp);
+	puthist(fp, "loop", "iterations", latency_iterations());
+	fprintf(fp, "loop.stalls_total %lu\n", latency_stalls());
+}
+
+/*
+ * Send a snapshot to every client waiting to be accepted.
+ */
+void stats_serve(void)
+{
+	FILE *fp;
+	char *buf = NULL;
+	size_t len = 0;
+	int fd, i;
+
+	if (listenfd == -1)
+		return;
+	for (i = 0; i < MAXSERVE; i++) {
+		if ((fd = accept(listenfd, NULL, NULL)) == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+			    errno != EINTR && errno != ECONNABORTED)
+				error("accept: %s", strerror(errno));
+			break;
+		}
+		/* one snapshot for everybody served now */
+		if (buf == NULL && (fp = open_memstream(&buf, &len)) != NULL) {
+			collect(fp);
+			fclose(fp);
+		}
+		if (len > 0 && send(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL)
+		    < (ssize_t)len)
+			debug("statistics client too slow, snapshot cut short");
+		close(fd);
+	}
+	free(buf);
+}
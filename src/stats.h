@@ -0,0 +1,69 @@
+#if !defined(STATS_H)
+#define STATS_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* X resources that karmen creates and frees itself */
+enum {
+	XRES_PIXMAP,
+	XRES_PICTURE,
+	XRES_GC,
+	XRES_COLORMAP,
+
+	NXRES
+};
+
+extern long xresources[NXRES];
+
+#define XRES_HOLD(kind)		(xresources[(kind)]++)
+#define XRES_DROP(kind)		(xresources[(kind)]--)
+
+struct cachestats {
+	unsigned long hits;
+	unsigned long misses;
+	long entries;
+};
+
+/* Memory allocated through MALLOC and friends, see lib.c */
+struct heapstats {
+	long blocks;
+	long bytes;		/* 0 where the size is unknown */
+	unsigned long allocs;
+	unsigned long frees;
+};
+
+struct loadstats {
+	unsigned long episodes;
+	int deepest;		/* longest backlog seen */
+	long since;		/* when the current episode began (ms) */
+	long totalms;
+	long maxms;
+};
+
+void stats_init(const char *, const struct loadstats *);
+void stats_fini(void);
+int stats_fd(void);
+void stats_serve(void);
+char *stats_path(const char *);
+
+#endif /* !defined(STATS_H) */
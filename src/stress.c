@@ -0,0 +1,759 @@
+/*
+ * stress.c - synthetic client load for benchmarking karmen
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Each scenario drives the window manager the way a misbehaving or
+ * very busy client would and prints one JSON object per line with
+ * latency percentiles in milliseconds.  If the pid of the window
+ * manager is given, the CPU time it used during the scenario is
+ * included, so that builds can be compared on both counts.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#if CONFIG_XTEST
+#include <X11/extensions/XTest.h>
+#endif
+
+/* How long to wait for the window manager before giving up (ms) */
+#define TIMEOUT		5000
+
+#define ICONSIZE	64
+
+struct samples {
+	double *v;
+	int len;
+	int lim;
+};
+
+static Display *display;
+static Window root;
+static Atom NET_ACTIVE_WINDOW;
+static Atom NET_CLIENT_LIST;
+static Atom NET_WM_ICON;
+static Atom STRESS_PING;
+
+static int wmpid = 0;
+static int timeouts;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*
+ * CPU time used by the window manager so far, in ms.
+ */
+static double wmcpu(void)
+{
+	unsigned long utime, stime;
+	char path[64];
+	FILE *fp;
+	int n;
+
+	if (wmpid == 0)
+		return 0;
+	snprintf(path, sizeof path, "/proc/%d/stat", wmpid);
+	if ((fp = fopen(path, "r")) == NULL)
+		return 0;
+	n = fscanf(fp, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+	    "%lu %lu", &utime, &stime);
+	fclose(fp);
+	if (n != 2)
+		return 0;
+	return (utime + stime) * 1e3 / sysconf(_SC_CLK_TCK);
+}
+
+static void *xmalloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		perror("karmen-stress");
+		exit(1);
+	}
+	return p;
+}
+
+static void add(struct samples *sp, double v)
+{
+	if (sp->len == sp->lim) {
+		sp->lim = sp->lim == 0 ? 64 : 2 * sp->lim;
+		sp->v = realloc(sp->v, sp->lim * sizeof sp->v[0]);
+		if (sp->v == NULL) {
+			perror("karmen-stress");
+			exit(1);
+		}
+	}
+	sp->v[sp->len++] = v;
+}
+
+static int cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(struct samples *sp, int p)
+{
+	if (sp->len == 0)
+		return 0;
+	return sp->v[(sp->len - 1) * p / 100];
+}
+
+/*
+ * Print the results of a scenario and reset the samples.
+ */
+static void report(const char *scenario, const char *metric, int n,
+    struct samples *sp, double wall, double cpu)
+{
+	qsort(sp->v, sp->len, sizeof sp->v[0], cmp);
+	printf("{\"scenario\": \"%s\", \"metric\": \"%s\", \"n\": %d, "
+	    "\"samples\": %d, \"timeouts\": %d, "
+	    "\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, "
+	    "\"wall_ms\": %.1f, \"wm_cpu_ms\": %.1f}\n",
+	    scenario, metric, n, sp->len, timeouts,
+	    percentile(sp, 50), percentile(sp, 90), percentile(sp, 99),
+	    percentile(sp, 100), wall, cpu);
+	fflush(stdout);
+	sp->len = 0;
+	timeouts = 0;
+}
+
+static void skip(const char *scenario, const char *why)
+{
+	printf("{\"scenario\": \"%s\", \"skipped\": \"%s\"}\n",
+	    scenario, why);
+	fflush(stdout);
+}
+
+/*
+ * Wait for an event of the given type on w.  Returns zero on timeout.
+ */
+static int waitfor(Window w, int type, XEvent *ep)
+{
+	struct pollfd pfd;
+	double deadline = now() + TIMEOUT;
+	int ms;
+
+	pfd.fd = ConnectionNumber(display);
+	pfd.events = POLLIN;
+	for (;;) {
+		if (XCheckTypedWindowEvent(display, w, type, ep))
+			return 1;
+		if ((ms = deadline - now()) <= 0) {
+			timeouts++;
+			return 0;
+		}
+		if (poll(&pfd, 1, ms) == -1 && errno != EINTR) {
+			perror("poll");
+			exit(1);
+		}
+		XEventsQueued(display, QueuedAfterReading);
+	}
+}
+
+static void drain(void)
+{
+	XEvent e;
+
+	XSync(display, False);
+	while (XPending(display))
+		XNextEvent(display, &e);
+}
+
+static Window mkwin(int i, const char *class)
+{
+	XClassHint ch;
+	char name[32];
+	Window w;
+
+	w = XCreateSimpleWindow(display, root,
+	    20 + (i * 23) % 600, 20 + (i * 17) % 400, 200, 150, 0,
+	    BlackPixel(display, DefaultScreen(display)),
+	    WhitePixel(display, DefaultScreen(display)));
+	XSelectInput(display, w, StructureNotifyMask | FocusChangeMask);
+	snprintf(name, sizeof name, "stress %d", i);
+	XStoreName(display, w, name);
+	ch.res_name = "karmen-stress";
+	ch.res_class = (char *)class;
+	XSetClassHint(display, w, &ch);
+	return w;
+}
+
+/*
+ * Give w the same icon as every other window of its class.
+ */
+static void seticon(Window w)
+{
+	static long *icon = NULL;
+	int i, n = 2 + ICONSIZE * ICONSIZE;
+
+	if (icon == NULL) {
+		icon = xmalloc(n * sizeof icon[0]);
+		icon[0] = icon[1] = ICONSIZE;
+		for (i = 2; i < n; i++)
+			icon[i] = 0xff000000 | (i * 2654435761u & 0xffffff);
+	}
+	XChangeProperty(display, w, NET_WM_ICON, XA_CARDINAL, 32,
+	    PropModeReplace, (unsigned char *)icon, n);
+}
+
+/*
+ * Map w and return the time until the window manager has framed
+ * and shown it.
+ */
+static double mapwin(Window w)
+{
+	double t = now();
+	XEvent e;
+
+	XMapWindow(display, w);
+	XFlush(display);
+	if (!waitfor(w, ReparentNotify, &e) || !waitfor(w, MapNotify, &e))
+		return -1;
+	return now() - t;
+}
+
+static int clientcount(void)
+{
+	unsigned long n = 0, after;
+	unsigned char *data;
+	Atom type;
+	int format;
+
+	if (XGetWindowProperty(display, root, NET_CLIENT_LIST, 0, 0,
+	    False, XA_WINDOW, &type, &format, &n, &after, &data) != Success)
+		return -1;
+	if (data != NULL)
+		XFree(data);
+	return after / 4;
+}
+
+/*
+ * Wait until the window manager lists at most n clients.
+ */
+static int waitclients(int n)
+{
+	double deadline = now() + TIMEOUT;
+
+	while (clientcount() > n) {
+		if (now() > deadline) {
+			timeouts++;
+			return 0;
+		}
+		usleep(1000);
+	}
+	return 1;
+}
+
+/*
+ * Time a request that the window manager has to act on: move w
+ * and wait for the ConfigureNotify it sends back.
+ */
+static double probe(Window w)
+{
+	static int dx = 1;
+	double t = now();
+	XEvent e;
+
+	dx = -dx;
+	XMoveWindow(display, w, 100 + dx, 100);
+	XFlush(display);
+	if (!waitfor(w, ConfigureNotify, &e))
+		return -1;
+	return now() - t;
+}
+
+static void sample(struct samples *sp, double v)
+{
+	if (v >= 0)
+		add(sp, v);
+}
+
+/*
+ * Map n windows one by one, then destroy them all at once.
+ */
+static void map(const char *scenario, int n, int icons)
+{
+	struct samples s = { NULL, 0, 0 };
+	Window *w = xmalloc(n * sizeof w[0]);
+	double t, cpu;
+	int i, base;
+
+	base = clientcount();
+	t = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++) {
+		w[i] = mkwin(i, icons ? "Icons" : "Stress");
+		if (icons)
+			seticon(w[i]);
+		sample(&s, mapwin(w[i]));
+	}
+	report(scenario, "map_to_frame", n, &s, now() - t, wmcpu() - cpu);
+
+	drain();
+	t = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++)
+		XDestroyWindow(display, w[i]);
+	XFlush(display);
+	waitclients(base);
+	sample(&s, now() - t);
+	report(scenario, "destroy_all", n, &s, now() - t, wmcpu() - cpu);
+	free(w);
+}
+
+/*
+ * Change the title n times in bursts and see how long the window
+ * manager takes to get back to us.
+ */
+static void title(int n)
+{
+	struct samples s = { NULL, 0, 0 };
+	char name[32];
+	double t, cpu;
+	Window w;
+	int i;
+
+	w = mkwin(0, "Stress");
+	mapwin(w);
+	drain();
+	t = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++) {
+		snprintf(name, sizeof name, "title %d", i);
+		XStoreName(display, w, name);
+		if (i % 50 == 49)
+			sample(&s, probe(w));
+	}
+	sample(&s, probe(w));
+	report("title", "probe", n, &s, now() - t, wmcpu() - cpu);
+	XDestroyWindow(display, w);
+	drain();
+}
+
+/*
+ * Send bursts of n ConfigureRequests and time until the last one
+ * has been applied.
+ */
+static void configure(int n)
+{
+	struct samples s = { NULL, 0, 0 };
+	double t, t0, cpu;
+	XEvent e;
+	Window w;
+	int i, j, width;
+
+	w = mkwin(0, "Stress");
+	mapwin(w);
+	drain();
+	t0 = now();
+	cpu = wmcpu();
+	for (j = 0; j < 20; j++) {
+		t = now();
+		for (i = 0; i < n; i++)
+			XMoveResizeWindow(display, w, 50 + i % 100, 50,
+			    200 + i % 200, 150);
+		width = 200 + (n - 1) % 200;
+		XFlush(display);
+		for (;;) {
+			if (!waitfor(w, ConfigureNotify, &e))
+				break;
+			if (e.xconfigure.width == width &&
+			    !e.xconfigure.send_event) {
+				sample(&s, now() - t);
+				break;
+			}
+		}
+		drain();
+	}
+	report("configure", "burst_applied", n, &s, now() - t0,
+	    wmcpu() - cpu);
+	XDestroyWindow(display, w);
+	drain();
+}
+
+/* What the noisy client of flood() sends */
+enum { FLOOD_NAME, FLOOD_ACTIVE, FLOOD_HINTS, FLOOD_FIGHT };
+
+/*
+ * One noisy client floods the window manager while a second one
+ * measures how responsive it stays.  The noisy client renames itself
+ * and pings, asks to be activated, rewrites its WM_NORMAL_HINTS once
+ * per ms, or fights the window manager over its geometry by asking
+ * again for its own each time it is configured.
+ */
+static void flood(const char *scenario, int n, int kind)
+{
+	struct samples s = { NULL, 0, 0 };
+	XClientMessageEvent cm;
+	XSizeHints hints;
+	char name[32];
+	double t, cpu;
+	Window noisy, quiet;
+	XEvent e;
+	int i;
+
+	noisy = mkwin(0, "Noisy");
+	quiet = mkwin(1, "Quiet");
+	mapwin(noisy);
+	mapwin(quiet);
+	drain();
+
+	memset(&cm, 0, sizeof cm);
+	cm.type = ClientMessage;
+	cm.window = noisy;
+	cm.message_type = kind == FLOOD_ACTIVE ?
+	    NET_ACTIVE_WINDOW : STRESS_PING;
+	cm.format = 32;
+	cm.data.l[0] = 1;	/* from an application */
+
+	memset(&hints, 0, sizeof hints);
+	hints.flags = PMinSize | PResizeInc;
+
+	t = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++) {
+		switch (kind) {
+		case FLOOD_NAME:
+			snprintf(name, sizeof name, "flood %d", i);
+			XStoreName(display, noisy, name);
+			/* FALLTHROUGH */
+		case FLOOD_ACTIVE:
+			XSendEvent(display, root, False,
+			    SubstructureRedirectMask | SubstructureNotifyMask,
+			    (XEvent *)&cm);
+			break;
+		case FLOOD_HINTS:
+			hints.min_width = 50 + i % 50;
+			hints.min_height = 50 + i % 30;
+			hints.width_inc = hints.height_inc = 1 + i % 8;
+			XSetWMNormalHints(display, noisy, &hints);
+			XFlush(display);
+			while (now() - t < i)
+				usleep(100);
+			break;
+		case FLOOD_FIGHT:
+			XMoveResizeWindow(display, noisy, 0, 0, 200 + i % 2, 150);
+			if (XCheckTypedWindowEvent(display, noisy,
+			    ConfigureNotify, &e))
+				XMoveResizeWindow(display, noisy, 0, 0, 200, 150);
+			break;
+		}
+		if (i % 100 == 99)
+			sample(&s, probe(quiet));
+	}
+	sample(&s, probe(quiet));
+	report(scenario, "neighbour_probe", n, &s, now() - t,
+	    wmcpu() - cpu);
+	XDestroyWindow(display, noisy);
+	XDestroyWindow(display, quiet);
+	drain();
+}
+
+/*
+ * Ask for activation of one of k windows in turn and time until it
+ * has the focus.
+ */
+static void activate(int n)
+{
+	struct samples s = { NULL, 0, 0 };
+	XClientMessageEvent cm;
+	Window w[8];
+	double t, t0, cpu;
+	XEvent e;
+	int i, k = 8;
+
+	for (i = 0; i < k; i++) {
+		w[i] = mkwin(i, "Stress");
+		mapwin(w[i]);
+	}
+	drain();
+
+	memset(&cm, 0, sizeof cm);
+	cm.type = ClientMessage;
+	cm.message_type = NET_ACTIVE_WINDOW;
+	cm.format = 32;
+	cm.data.l[0] = 2;	/* from a pager */
+
+	t0 = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++) {
+		cm.window = w[i % k];
+		t = now();
+		XSendEvent(display, root, False,
+		    SubstructureRedirectMask | SubstructureNotifyMask,
+		    (XEvent *)&cm);
+		XFlush(display);
+		if (waitfor(w[i % k], FocusIn, &e))
+			sample(&s, now() - t);
+		drain();
+	}
+	report("activate", "request_to_focus", n, &s, now() - t0,
+	    wmcpu() - cpu);
+	for (i = 0; i < k; i++)
+		XDestroyWindow(display, w[i]);
+	drain();
+}
+
+#if CONFIG_XTEST
+/*
+ * The root coordinates of the middle of w.
+ */
+static void center(Window w, int *x, int *y)
+{
+	Window dummy;
+
+	XTranslateCoordinates(display, w, root, 100, 75, x, y, &dummy);
+}
+
+/*
+ * Click into one of k windows in turn and time until it has the
+ * focus.
+ */
+static void click(int n)
+{
+	struct samples s = { NULL, 0, 0 };
+	Window w[8];
+	double t, t0, cpu;
+	XEvent e;
+	int i, k = 8, x, y;
+
+	for (i = 0; i < k; i++) {
+		w[i] = mkwin(i, "Stress");
+		mapwin(w[i]);
+	}
+	drain();
+
+	t0 = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++) {
+		center(w[i % k], &x, &y);
+		XTestFakeMotionEvent(display, -1, x, y, 0);
+		t = now();
+		XTestFakeButtonEvent(display, Button1, True, 0);
+		XTestFakeButtonEvent(display, Button1, False, 0);
+		XFlush(display);
+		if (waitfor(w[i % k], FocusIn, &e))
+			sample(&s, now() - t);
+		drain();
+	}
+	report("click", "click_to_focus", n, &s, now() - t0, wmcpu() - cpu);
+	for (i = 0; i < k; i++)
+		XDestroyWindow(display, w[i]);
+	drain();
+}
+
+/*
+ * Drag a window with Meta held down, n steps, timing each step.
+ */
+static void drag(int n)
+{
+	struct samples s = { NULL, 0, 0 };
+	KeyCode meta = XKeysymToKeycode(display, XK_Alt_L);
+	double t, t0, cpu;
+	XEvent e;
+	Window w;
+	int i, x, y;
+
+	w = mkwin(0, "Stress");
+	mapwin(w);
+	drain();
+	center(w, &x, &y);
+
+	t0 = now();
+	cpu = wmcpu();
+	XTestFakeMotionEvent(display, -1, x, y, 0);
+	XTestFakeKeyEvent(display, meta, True, 0);
+	XTestFakeButtonEvent(display, Button1, True, 0);
+	for (i = 0; i < n; i++) {
+		t = now();
+		XTestFakeMotionEvent(display, -1, x + i % 200, y + i % 100, 0);
+		XFlush(display);
+		if (waitfor(w, ConfigureNotify, &e))
+			sample(&s, now() - t);
+	}
+	XTestFakeButtonEvent(display, Button1, False, 0);
+	XTestFakeKeyEvent(display, meta, False, 0);
+	report("drag", "drag_step", n, &s, now() - t0, wmcpu() - cpu);
+	XDestroyWindow(display, w);
+	drain();
+}
+
+/*
+ * Meta-Tab between k windows n times, timing each switch.
+ */
+static void cycle(int n)
+{
+	struct samples s = { NULL, 0, 0 };
+	KeyCode meta = XKeysymToKeycode(display, XK_Alt_L);
+	KeyCode tab = XKeysymToKeycode(display, XK_Tab);
+	Window w[8];
+	double t, t0, cpu;
+	XEvent e;
+	int i, j, k = 8;
+
+	for (i = 0; i < k; i++) {
+		w[i] = mkwin(i, "Stress");
+		mapwin(w[i]);
+	}
+	drain();
+
+	t0 = now();
+	cpu = wmcpu();
+	for (i = 0; i < n; i++) {
+		t = now();
+		XTestFakeKeyEvent(display, meta, True, 0);
+		XTestFakeKeyEvent(display, tab, True, 0);
+		XTestFakeKeyEvent(display, tab, False, 0);
+		XTestFakeKeyEvent(display, meta, False, 0);
+		XFlush(display);
+		/* whichever window comes up next gets the focus */
+		for (j = 0; j < TIMEOUT; j++) {
+			if (XCheckTypedEvent(display, FocusIn, &e)) {
+				sample(&s, now() - t);
+				break;
+			}
+			usleep(1000);
+		}
+		drain();
+	}
+	report("cycle", "switch_to_focus", n, &s, now() - t0, wmcpu() - cpu);
+	for (i = 0; i < k; i++)
+		XDestroyWindow(display, w[i]);
+	drain();
+}
+#endif
+
+static void usage(FILE *fp)
+{
+	fprintf(fp,
+"usage: karmen-stress [-display name] [-p pid] [-n count] scenario...\n"
+"scenarios: map icons title configure flood spam hints fight activate\n"
+"           click drag cycle\n");
+}
+
+int main(int argc, char *argv[])
+{
+	char *dpyname = NULL;
+	int i, n = 100;
+	int xtest = 0;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-display") == 0 && i + 1 < argc)
+			dpyname = argv[++i];
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			wmpid = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			n = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-help") == 0) {
+			usage(stdout);
+			return 0;
+		} else {
+			usage(stderr);
+			return 2;
+		}
+	}
+	if (i == argc || n <= 0) {
+		usage(stderr);
+		return 2;
+	}
+
+	if ((display = XOpenDisplay(dpyname)) == NULL) {
+		fprintf(stderr, "karmen-stress: can't open display %s\n",
+		    XDisplayName(dpyname));
+		return 1;
+	}
+	root = DefaultRootWindow(display);
+	NET_ACTIVE_WINDOW = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+	NET_CLIENT_LIST = XInternAtom(display, "_NET_CLIENT_LIST", False);
+	NET_WM_ICON = XInternAtom(display, "_NET_WM_ICON", False);
+	STRESS_PING = XInternAtom(display, "_KARMEN_STRESS_PING", False);
+#if CONFIG_XTEST
+	{
+		int d;
+
+		xtest = XTestQueryExtension(display, &d, &d, &d, &d);
+	}
+#endif
+
+	for (; i < argc; i++) {
+		if (strcmp(argv[i], "map") == 0)
+			map("map", n, 0);
+		else if (strcmp(argv[i], "icons") == 0)
+			map("icons", n, 1);
+		else if (strcmp(argv[i], "title") == 0)
+			title(n);
+		else if (strcmp(argv[i], "configure") == 0)
+			configure(n);
+		else if (strcmp(argv[i], "flood") == 0)
+			flood("flood", n, FLOOD_NAME);
+		else if (strcmp(argv[i], "spam") == 0)
+			flood("spam", n, FLOOD_ACTIVE);
+		else if (strcmp(argv[i], "hints") == 0)
+			flood("hints", n, FLOOD_HINTS);
+		else if (strcmp(argv[i], "fight") == 0)
+			flood("fight", n, FLOOD_FIGHT);
+		else if (strcmp(argv[i], "activate") == 0)
+			activate(n);
+		else if (strcmp(argv[i], "click") == 0 ||
+		    strcmp(argv[i], "drag") == 0 ||
+		    strcmp(argv[i], "cycle") == 0) {
+			if (!xtest)
+				skip(argv[i], "no XTest");
+#if CONFIG_XTEST
+			else if (argv[i][0] == 'c' && argv[i][1] == 'l')
+				click(n);
+			else if (argv[i][0] == 'd')
+				drag(n);
+			else
+				cycle(n);
+#endif
+		} else {
+			fprintf(stderr, "karmen-stress: unknown scenario %s\n",
+			    argv[i]);
+			return 2;
+		}
+	}
+
+	XCloseDisplay(display);
+	return 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * text.c - UTF-8 text measuring and drawing
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+#include <fontconfig/fontconfig.h>
+
+#include "global.h"
+#include "list.h"
+#include "stats.h"
+#include "text.h"
+
+/*
+ * Strings are shaped once into runs of glyphs, each glyph from the
+ * first font that has it, and the runs are cached.  Measuring,
+ * truncating and drawing a string that was seen recently then costs
+ * a hash lookup.
+ */
+
+#define NBUCKET		256
+#define MAXRUNS		1024
+#define MAXFALLBACK	16
+#define NMISSING	128	/* a power of two */
+
+struct run {
+	unsigned long hash;
+	char *str;
+	XftGlyphFontSpec *glyphs;	/* positioned at origin 0, 0 */
+	int *offset;			/* byte offset of each glyph in str */
+	int nglyphs;
+	int width;
+	LIST hashlink;
+	LIST lrulink;
+};
+
+static LIST bucket[NBUCKET];
+static int initialized = 0;
+
+/* Runs, most recently used first */
+static LIST_DEFINE(lru);
+static int nruns = 0;
+
+static struct cachestats stats;
+
+/* Fonts opened for characters missing from xftfont */
+static XftFont *fallback[MAXFALLBACK];
+static int nfallback = 0;
+
+/*
+ * Characters no font was found for, so that fontconfig is asked once
+ * rather than for every string they show up in.  Open addressing,
+ * emptied when it is half full or when the fonts change.
+ */
+static FcChar32 missing[NMISSING];
+static int nmissing = 0;
+
+/* For drawing, with the glyphs moved to their final position */
+static XftGlyphFontSpec *drawbuf = NULL;
+static int drawlim = 0;
+
+static unsigned long hashstring(const char *s)
+{
+	unsigned long h = 2166136261UL;
+
+	for (; *s != '\0'; s++) {
+		h ^= (unsigned char)*s;
+		h = (h * 16777619UL) & 0xffffffffUL;
+	}
+	return h;
+}
+
+static void flushmissing(void)
+{
+	memset(missing, 0, sizeof missing);
+	nmissing = 0;
+}
+
+/*
+ * Look ch up in missing, adding it if add is set.  Strings are
+ * NUL-terminated, so 0 is never looked up and marks an empty slot.
+ */
+static int findmissing(FcChar32 ch, int add)
+{
+	unsigned i;
+
+	if (add && nmissing == NMISSING / 2)
+		flushmissing();
+	i = (ch * 2654435761U) & (NMISSING - 1);
+	while (missing[i] != 0) {
+		if (missing[i] == ch)
+			return 1;
+		i = (i + 1) & (NMISSING - 1);
+	}
+	if (add) {
+		missing[i] = ch;
+		nmissing++;
+	}
+	return 0;
+}
+
+/*
+ * Find a font for the character, asking fontconfig for one that
+ * covers it if neither the main font nor a previous fallback does.
+ * If none does, the main font draws its missing glyph box.
+ */
+static XftFont *fontfor(FcChar32 ch)
+{
+	FcCharSet *charset;
+	FcPattern *pattern, *match;
+	FcResult result;
+	XftFont *font;
+	int i;
+
+	if (XftCharExists(display, xftfont, ch))
+		return xftfont;
+	if (findmissing(ch, False))
+		return xftfont;
+	for (i = 0; i < nfallback; i++)
+		if (XftCharExists(display, fallback[i], ch))
+			return fallback[i];
+	if (nfallback == MAXFALLBACK) {
+		findmissing(ch, True);
+		return xftfont;
+	}
+
+	/* the same font, but with this character, from any file */
+	pattern = FcPatternDuplicate(xftfont->pattern);
+	FcPatternDel(pattern, FC_FILE);
+	FcPatternDel(pattern, FC_INDEX);
+	FcPatternDel(pattern, FC_CHARSET);
+	charset = FcCharSetCreate();
+	FcCharSetAddChar(charset, ch);
+	FcPatternAddCharSet(pattern, FC_CHARSET, charset);
+	match = XftFontMatch(display, screen, pattern, &result);
+	FcCharSetDestroy(charset);
+	FcPatternDestroy(pattern);
+	if (match == NULL) {
+		findmissing(ch, True);
+		return xftfont;
+	}
+
+	if ((font = XftFontOpenPattern(display, match)) == NULL) {
+		FcPatternDestroy(match);
+		findmissing(ch, True);
+		return xftfont;
+	}
+	if (!XftCharExists(display, font, ch)) {
+		XftFontClose(display, font);
+		findmissing(ch, True);
+		return xftfont;
+	}
+	debug("fallback font %d for U+%04X", nfallback, (unsigned)ch);
+	fallback[nfallback++] = font;
+	/* it may cover some of what was missing */
+	flushmissing();
+	return font;
+}
+
+static void freerun(struct run *run)
+{
+	LIST_REMOVE(&run->hashlink);
+	LIST_REMOVE(&run->lrulink);
+	FREE(run->str);
+	FREE(run->glyphs);
+	FREE(run->offset);
+	FREE(run);
+	nruns--;
+}
+
+/*
+ * Shape a string.  Bytes that are not valid UTF-8 are taken as
+ * Latin-1, which is what legacy clients send.
+ */
+static struct run *shape(const char *str, unsigned long hash)
+{
+	struct run *run;
+	XGlyphInfo extents;
+	FcChar32 ch;
+	FT_UInt glyph;
+	XftFont *font;
+	int i, k, n, x, len;
+
+	len = strlen(str);
+	run = MALLOC(sizeof (struct run));
+	run->hash = hash;
+	run->str = STRDUP(str);
+	run->glyphs = MALLOC(MAX(1, len) * sizeof run->glyphs[0]);
+	run->offset = MALLOC((len + 1) * sizeof run->offset[0]);
+
+	x = 0;
+	n = 0;
+	for (i = 0; i < len; i += k) {
+		k = FcUtf8ToUcs4((FcChar8 *)str + i, &ch, len - i);
+		if (k <= 0) {
+			ch = (unsigned char)str[i];
+			k = 1;
+		}
+		font = fontfor(ch);
+		glyph = XftCharIndex(display, font, ch);
+		XftGlyphExtents(display, font, &glyph, 1, &extents);
+		run->glyphs[n].font = font;
+		run->glyphs[n].glyph = glyph;
+		run->glyphs[n].x = x;
+		run->glyphs[n].y = 0;
+		run->offset[n] = i;
+		x += extents.xOff;
+		n++;
+	}
+	run->offset[n] = len;
+	run->nglyphs = n;
+	run->width = x;
+	return run;
+}
+
+static struct run *lookup(const char *str)
+{
+	struct run *run;
+	unsigned long hash;
+	LIST *lp;
+	int i;
+
+	if (!initialized) {
+		for (i = 0; i < NBUCKET; i++)
+			LIST_INIT(&bucket[i]);
+		initialized = 1;
+	}
+
+	hash = hashstring(str);
+	LIST_FOREACH(lp, &bucket[hash % NBUCKET]) {
+		run = LIST_ITEM(lp, struct run, hashlink);
+		if (run->hash == hash && strcmp(run->str, str) == 0) {
+			LIST_REMOVE(&run->lrulink);
+			LIST_INSERT_HEAD(&lru, &run->lrulink);
+			stats.hits++;
+			return run;
+		}
+	}
+	stats.misses++;
+
+	while (nruns >= MAXRUNS)
+		freerun(LIST_ITEM(LIST_TAIL(&lru), struct run, lrulink));
+
+	run = shape(str, hash);
+	LIST_INSERT_HEAD(&bucket[hash % NBUCKET], &run->hashlink);
+	LIST_INSERT_HEAD(&lru, &run->lrulink);
+	nruns++;
+	return run;
+}
+
+int stringwidth(const char *str)
+{
+	return lookup(str)->width;
+}
+
+/*
+ * Truncate str in place with "..." so that it fits in width pixels,
+ * never cutting a character in half.
+ */
+char *stringfit(char *str, int width)
+{
+	struct run *run;
+	int dotswidth, len, n;
+
+	run = lookup(str);
+	if (run->width <= width)
+		return str;
+
+	dotswidth = lookup("...")->width;
+	run = lookup(str);
+	len = strlen(str);
+	n = run->nglyphs - 1;
+	while (n > 0 && (run->glyphs[n].x + dotswidth > width ||
+	    run->offset[n] + 3 > len))
+		n--;
+	if (n == 0 && (dotswidth > width || len < 3))
+		str[0] = '\0';
+	else
+		strcpy(str + run->offset[n], "...");
+	return str;
+}
+
+/*
+ * Draw str with its baseline origin at (x, y).
+ */
+void drawstring(XftDraw *draw, XftColor *color, int x, int y,
+    const char *str)
+{
+	struct run *run;
+	int i;
+
+	run = lookup(str);
+	if (run->nglyphs == 0)
+		return;
+	if (run->nglyphs > drawlim) {
+		drawlim = run->nglyphs;
+		drawbuf = REALLOC(drawbuf, drawlim * sizeof drawbuf[0]);
+	}
+	for (i = 0; i < run->nglyphs; i++) {
+		drawbuf[i] = run->glyphs[i];
+		drawbuf[i].x += x;
+		drawbuf[i].y += y;
+	}
+	XftDrawGlyphFontSpec(draw, color, drawbuf, run->nglyphs);
+}
+
+const struct cachestats *text_cache_stats(void)
+{
+	stats.entries = nruns;
+	return &stats;
+}
+
+void text_fini(void)
+{
+	LIST *lp;
+
+	while ((lp = LIST_HEAD(&lru)) != NULL)
+		freerun(LIST_ITEM(lp, struct run, lrulink));
+	while (nfallback > 0)
+		XftFontClose(display, fallback[--nfallback]);
+	flushmissing();
+	FREE(drawbuf);
+	drawbuf = NULL;
+	drawlim = 0;
+}
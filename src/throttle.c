@@ -0,0 +1,118 @@
+/*
+ * throttle.c - per-client rate limiting
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "global.h"
+#include "stats.h"
+#include "throttle.h"
+
+/*
+ * Sustained requests per second and burst size for each class.
+ * The rates are far above what a well-behaved client needs.
+ */
+static const struct {
+	const char *name;
+	long rate;
+	long burst;
+} limits[NTHROTTLE] = {
+	[THROTTLE_CONFIGURE] = { "configure", 100, 50 },
+	[THROTTLE_PROPERTY] = { "property", 50, 50 },
+	[THROTTLE_MESSAGE] = { "message", 20, 10 },
+};
+
+/* Totals over all clients, past and present */
+static unsigned long allowed[NTHROTTLE];
+static unsigned long throttled[NTHROTTLE];
+
+void init_throttle(struct throttle *tp)
+{
+	long now = now_ms();
+	int i;
+
+	for (i = 0; i < NTHROTTLE; i++) {
+		tp->bucket[i].tokens = limits[i].burst * 1000;
+		tp->bucket[i].last = now;
+		tp->bucket[i].allowed = 0;
+		tp->bucket[i].throttled = 0;
+	}
+}
+
+static void refill(struct bucket *bp, int class)
+{
+	long now = now_ms();
+
+	/* rate per second is rate thousandths per ms */
+	bp->tokens += (now - bp->last) * limits[class].rate;
+	bp->tokens = MIN(bp->tokens, limits[class].burst * 1000);
+	bp->last = now;
+}
+
+/*
+ * Take a token for a request of the given class.  Returns nonzero if
+ * the client is over its budget, in which case the request should be
+ * deferred, merged or dropped.
+ */
+int throttle(struct throttle *tp, int class)
+{
+	struct bucket *bp = &tp->bucket[class];
+
+	refill(bp, class);
+	if (bp->tokens < 1000) {
+		bp->throttled++;
+		throttled[class]++;
+		return 1;
+	}
+	bp->tokens -= 1000;
+	bp->allowed++;
+	allowed[class]++;
+	return 0;
+}
+
+/*
+ * Return the number of ms until a request of the class is allowed.
+ */
+long throttle_wait(struct throttle *tp, int class)
+{
+	struct bucket *bp = &tp->bucket[class];
+
+	refill(bp, class);
+	if (bp->tokens >= 1000)
+		return 0;
+	return (1000 - bp->tokens + limits[class].rate - 1) /
+	    limits[class].rate;
+}
+
+void throttle_totals(int class, unsigned long *allowedp,
+    unsigned long *throttledp)
+{
+	*allowedp = allowed[class];
+	*throttledp = throttled[class];
+}
+
+const char *throttle_name(int class)
+{
+	return limits[class].name;
+}
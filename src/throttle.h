@@ -0,0 +1,56 @@
+#if !defined(THROTTLE_H)
+#define THROTTLE_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Token buckets limiting how much of the window manager's time one
+ * client can take, per class of expensive request.
+ */
+
+enum {
+	THROTTLE_CONFIGURE,	/* ConfigureRequest */
+	THROTTLE_PROPERTY,	/* property fetches */
+	THROTTLE_MESSAGE,	/* ClientMessage */
+
+	NTHROTTLE
+};
+
+struct bucket {
+	long tokens;		/* in thousandths of a request */
+	long last;		/* time of last refill, in ms */
+	unsigned long allowed;
+	unsigned long throttled;
+};
+
+struct throttle {
+	struct bucket bucket[NTHROTTLE];
+};
+
+void init_throttle(struct throttle *);
+int throttle(struct throttle *, int);
+long throttle_wait(struct throttle *, int);
+void throttle_totals(int, unsigned long *, unsigned long *);
+const char *throttle_name(int);
+
+#endif /* !defined(THROTTLE_H) */
@@ -0,0 +1,366 @@
+/*
+ * thumb.c - window previews for the window switcher
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xrender.h>
+
+#include "global.h"
+#include "list.h"
+#include "stats.h"
+#include "thumb.h"
+#include "widget.h"
+#include "window.h"
+
+/* Longest side of a thumbnail in pixels */
+#define THUMBSIZE	256
+
+struct thumb {
+	struct window *window;
+	Damage damage;		/* on the frame, reports once until rendered */
+	Pixmap pixmap;		/* None when evicted */
+	Picture picture;
+	int width;
+	int height;
+	int dirty;		/* damaged since rendered */
+	LIST lrulink;		/* in lru if pixmap != None */
+};
+
+static struct {
+	struct widget widget;
+	struct thumb *shown;
+	GC gc;
+} *preview = NULL;
+
+static int enabled = 0;
+static int damage_event_base;
+static XContext thumbcontext;
+
+/* Rendered thumbnails, most recently shown first */
+static LIST_DEFINE(lru);
+static long budget;
+static long used;
+
+static void freepixmap(struct thumb *t)
+{
+	if (t->pixmap == None)
+		return;
+	XRenderFreePicture(display, t->picture);
+	XFreePixmap(display, t->pixmap);
+	XRES_DROP(XRES_PICTURE);
+	XRES_DROP(XRES_PIXMAP);
+	t->pixmap = None;
+	t->picture = None;
+	used -= 4L * t->width * t->height;
+	LIST_REMOVE(&t->lrulink);
+}
+
+/*
+ * Drop the least recently shown thumbnails until within the budget.
+ * The one on screen is kept.
+ */
+static void evict(void)
+{
+	struct thumb *t;
+	LIST *lp;
+
+	while (used > budget && (lp = LIST_TAIL(&lru)) != NULL) {
+		t = LIST_ITEM(lp, struct thumb, lrulink);
+		if (preview != NULL && t == preview->shown)
+			break;
+		freepixmap(t);
+		t->dirty = 1;
+	}
+}
+
+/*
+ * Scale the window's current contents into its thumbnail.
+ */
+static int render(struct thumb *t)
+{
+	struct window *win = t->window;
+	XRenderPictFormat *format;
+	XTransform xform;
+	Picture src;
+	Pixmap contents;
+	double scale;
+	int width, height;
+
+	if (!WIDGET_MAPPED(win))
+		return t->pixmap != None;
+
+	scale = MIN(1.0, MIN((double)THUMBSIZE / WIDGET_WIDTH(win),
+	    (double)THUMBSIZE / WIDGET_HEIGHT(win)));
+	width = MAX(1, (int)(WIDGET_WIDTH(win) * scale));
+	height = MAX(1, (int)(WIDGET_HEIGHT(win) * scale));
+
+	if (t->pixmap != None && (t->width != width || t->height != height))
+		freepixmap(t);
+	if (t->pixmap == None) {
+		t->width = width;
+		t->height = height;
+		t->pixmap = XCreatePixmap(display, root, width, height,
+		    preview->widget.depth);
+		format = XRenderFindVisualFormat(display,
+		    preview->widget.visual);
+		t->picture = XRenderCreatePicture(display, t->pixmap,
+		    format, 0, NULL);
+		XRES_HOLD(XRES_PIXMAP);
+		XRES_HOLD(XRES_PICTURE);
+		used += 4L * width * height;
+		LIST_INSERT_HEAD(&lru, &t->lrulink);
+	}
+
+	clerr();
+	/* what is drawn from here on is damage to the new rendering */
+	XDamageSubtract(display, t->damage, None, None);
+	contents = XCompositeNameWindowPixmap(display, WIDGET_XWINDOW(win));
+	format = XRenderFindVisualFormat(display, win->widget.visual);
+	src = XRenderCreatePicture(display, contents, format, 0, NULL);
+
+	memset(&xform, 0, sizeof xform);
+	xform.matrix[0][0] = XDoubleToFixed(1.0 / scale);
+	xform.matrix[1][1] = XDoubleToFixed(1.0 / scale);
+	xform.matrix[2][2] = XDoubleToFixed(1.0);
+	XRenderSetPictureTransform(display, src, &xform);
+	XRenderSetPictureFilter(display, src, FilterGood, NULL, 0);
+
+	XRenderComposite(display, PictOpSrc, src, None, t->picture,
+	    0, 0, 0, 0, 0, 0, width, height);
+
+	XRenderFreePicture(display, src);
+	XFreePixmap(display, contents);
+	sterr();
+
+	t->dirty = 0;
+	return 1;
+}
+
+static void repaint(struct widget *widget)
+{
+	struct thumb *t = preview->shown;
+
+	if (t != NULL && t->pixmap != None)
+		XCopyArea(display, t->pixmap, WIDGET_XWINDOW(preview),
+		    preview->gc, 0, 0, t->width, t->height, 0, 0);
+}
+
+static void previewevent(struct widget *widget, XEvent *ep)
+{
+	if (ep->type == Expose && ep->xexpose.count == 0)
+		REPAINT(preview);
+}
+
+static void create_preview(void)
+{
+	XGCValues gcval;
+
+	preview = MALLOC(sizeof *preview);
+	create_widget(&preview->widget, WIDGET_PREVIEW, root, InputOutput,
+	    0, 0, 1, 1, False);
+	preview->widget.event = previewevent;
+	preview->widget.repaint = repaint;
+	preview->shown = NULL;
+	gcval.graphics_exposures = False;
+	preview->gc = XCreateGC(display, WIDGET_XWINDOW(preview),
+	    GCGraphicsExposures, &gcval);
+	XRES_HOLD(XRES_GC);
+	XSelectInput(display, WIDGET_XWINDOW(preview), ExposureMask);
+}
+
+static struct thumb *getthumb(struct window *win)
+{
+	struct thumb *t;
+
+	if (XFindContext(display, WIDGET_XWINDOW(win), thumbcontext,
+	    (XPointer *)&t) == 0)
+		return t;
+	t = MALLOC(sizeof *t);
+	t->window = win;
+	t->damage = XDamageCreate(display, WIDGET_XWINDOW(win),
+	    XDamageReportNonEmpty);
+	t->pixmap = None;
+	t->picture = None;
+	t->width = 0;
+	t->height = 0;
+	t->dirty = 1;
+	LIST_INIT(&t->lrulink);
+	XSaveContext(display, WIDGET_XWINDOW(win), thumbcontext,
+	    (XPointer)t);
+	return t;
+}
+
+/*
+ * Show a preview of the window next to the given widget, normally
+ * the switcher menu.  A thumbnail is only rendered again if its
+ * window was damaged since, so cycling through the switcher mostly
+ * copies cached pixmaps.  The one shown is kept up to date.
+ */
+void show_thumbnail(struct window *win, struct widget *near)
+{
+	struct thumb *t;
+	int x, y;
+
+	if (!enabled || win == NULL) {
+		hide_thumbnail();
+		return;
+	}
+
+	if (preview == NULL)
+		create_preview();
+
+	t = getthumb(win);
+	if ((t->dirty || t->pixmap == None) && !render(t)) {
+		hide_thumbnail();
+		return;
+	}
+
+	LIST_REMOVE(&t->lrulink);
+	LIST_INSERT_HEAD(&lru, &t->lrulink);
+	preview->shown = t;
+	evict();
+
+	x = WIDGET_X(near) + WIDGET_WIDTH(near) / 2 - t->width / 2;
+	y = WIDGET_Y(near) - t->height - border_width;
+	if (y < 0)
+		y = WIDGET_Y(near) + WIDGET_HEIGHT(near) + border_width;
+	moveresize_widget(&preview->widget, x, y, t->width, t->height);
+	if (!WIDGET_MAPPED(preview)) {
+		map_widget(&preview->widget);
+		XRaiseWindow(display, WIDGET_XWINDOW(preview));
+	}
+	REPAINT(preview);
+}
+
+void hide_thumbnail(void)
+{
+	if (preview != NULL && WIDGET_MAPPED(preview))
+		unmap_widget(&preview->widget);
+	if (preview != NULL)
+		preview->shown = NULL;
+	evict();
+}
+
+/*
+ * Handle Damage events.  A thumbnail that is not on screen is only
+ * marked; its damage is left unsubtracted, so its window sends
+ * nothing more until the thumbnail is rendered again.
+ */
+int thumbnail_event(XEvent *ep)
+{
+	XDamageNotifyEvent *dp = (XDamageNotifyEvent *)ep;
+	struct thumb *t;
+
+	if (!enabled || ep->type != damage_event_base + XDamageNotify)
+		return 0;
+
+	/* late ones for a window already gone are dropped */
+	if (XFindContext(display, dp->drawable, thumbcontext,
+	    (XPointer *)&t) != 0)
+		return 1;
+	t->dirty = 1;
+	if (preview != NULL && t == preview->shown) {
+		render(t);
+		REPAINT(preview);
+	}
+	return 1;
+}
+
+void destroy_thumbnail(struct window *win)
+{
+	struct thumb *t;
+
+	if (!enabled || XFindContext(display, WIDGET_XWINDOW(win),
+	    thumbcontext, (XPointer *)&t) != 0)
+		return;
+
+	if (preview != NULL && t == preview->shown)
+		hide_thumbnail();
+	freepixmap(t);
+	XDamageDestroy(display, t->damage);
+	XDeleteContext(display, WIDGET_XWINDOW(win), thumbcontext);
+	FREE(t);
+}
+
+/*
+ * Enable thumbnails if the server can provide them.  The budget is
+ * the most memory, in bytes, that the thumbnails may use.  Window
+ * contents are kept off screen for as long as thumbnails are enabled,
+ * so that a thumbnail is there at once when the switcher opens.
+ */
+void thumbnail_init(long bytes)
+{
+	int major = 0, minor = 2;
+	int event_base, error_base;
+
+	if (bytes <= 0)
+		return;
+
+	if (!XCompositeQueryExtension(display, &event_base, &error_base) ||
+	    !XCompositeQueryVersion(display, &major, &minor) ||
+	    (major == 0 && minor < 2)) {
+		debug("no Composite 0.2, not using thumbnails");
+		return;
+	}
+	if (!XDamageQueryExtension(display, &damage_event_base,
+	    &error_base)) {
+		debug("no Damage, not using thumbnails");
+		return;
+	}
+	if (!XRenderQueryExtension(display, &event_base, &error_base)) {
+		debug("no Render, not using thumbnails");
+		return;
+	}
+
+	budget = bytes;
+	used = 0;
+	thumbcontext = XUniqueContext();
+	XCompositeRedirectSubwindows(display, root,
+	    CompositeRedirectAutomatic);
+	enabled = 1;
+}
+
+void thumbnail_fini(void)
+{
+	if (!enabled)
+		return;
+
+	if (preview != NULL) {
+		hide_thumbnail();
+		XFreeGC(display, preview->gc);
+		XRES_DROP(XRES_GC);
+		destroy_widget(&preview->widget);
+		FREE(preview);
+		preview = NULL;
+	}
+	XCompositeUnredirectSubwindows(display, root,
+	    CompositeRedirectAutomatic);
+	enabled = 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * timer.c - timers
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+#include <sys/timerfd.h>
+
+#include "global.h"
+#include "timer.h"
+#include "trace.h"
+
+/* Deadlines are in us of now_us() */
+#define SEC	1000000LL
+#define MSEC	1000LL
+
+/* Running timers, earliest deadline first */
+static LIST_DEFINE(timers);
+
+static int fd = -1;
+
+/* The deadline the timerfd is armed for, 0 if disarmed */
+static long long armed = 0;
+
+/*
+ * Arm the timerfd for the earliest deadline, or disarm it.
+ */
+static void rearm(void)
+{
+	struct itimerspec its;
+	struct timer *tp;
+	LIST *lp;
+
+	if (fd == -1)
+		return;
+
+	memset(&its, 0, sizeof its);
+	if ((lp = LIST_HEAD(&timers)) != NULL) {
+		tp = LIST_ITEM(lp, struct timer, link);
+		if (tp->deadline == armed)
+			return;
+		its.it_value.tv_sec = tp->deadline / SEC;
+		its.it_value.tv_nsec = tp->deadline % SEC * 1000;
+		armed = tp->deadline;
+	} else {
+		if (armed == 0)
+			return;
+		armed = 0;
+	}
+	if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL) == -1)
+		error("timerfd_settime: %s", strerror(errno));
+}
+
+static void insert(struct timer *tp)
+{
+	struct timer *t;
+	LIST *lp;
+
+	LIST_FOREACH(lp, &timers) {
+		t = LIST_ITEM(lp, struct timer, link);
+		if (t->deadline > tp->deadline) {
+			LIST_INSERT_BEFORE(lp, &tp->link);
+			return;
+		}
+	}
+	LIST_INSERT_TAIL(&timers, &tp->link);
+}
+
+/*
+ * The next deadline of a periodic timer.  Aligned timers fire on
+ * multiples of their period in wall clock time, so that a clock
+ * ticks when the second changes rather than some time during it.
+ */
+static long long nextperiod(struct timer *tp)
+{
+	long long period = tp->period * MSEC;
+	long long t = now_us();
+	struct timeval tv;
+
+	if (tp->aligned) {
+		gettimeofday(&tv, NULL);
+		return t + period - (tv.tv_sec * SEC + tv.tv_usec) % period;
+	}
+	return t + period;
+}
+
+void init_timer(struct timer *tp, void (*fn)(void *), void *arg)
+{
+	tp->deadline = 0;
+	tp->period = 0;
+	tp->aligned = 0;
+	tp->fn = fn;
+	tp->arg = arg;
+	LIST_INIT(&tp->link);
+}
+
+/*
+ * Run the timer once, ms milliseconds from now.
+ */
+void start_timer(struct timer *tp, long ms)
+{
+	LIST_REMOVE(&tp->link);
+	tp->period = 0;
+	tp->deadline = now_us() + ms * MSEC;
+	insert(tp);
+	rearm();
+}
+
+/*
+ * Run the timer every ms milliseconds.  If it is already running
+ * with the same period, it is left alone.
+ */
+void start_periodic_timer(struct timer *tp, long ms, int aligned)
+{
+	if (timer_running(tp) && tp->period == ms && tp->aligned == aligned)
+		return;
+	LIST_REMOVE(&tp->link);
+	tp->period = ms;
+	tp->aligned = aligned;
+	tp->deadline = nextperiod(tp);
+	insert(tp);
+	rearm();
+}
+
+void stop_timer(struct timer *tp)
+{
+	if (!timer_running(tp))
+		return;
+	LIST_REMOVE(&tp->link);
+	rearm();
+}
+
+int timer_running(struct timer *tp)
+{
+	return LIST_MEMBER(&tp->link);
+}
+
+/*
+ * The descriptor to poll for timer expiry, or -1.
+ */
+int timer_fd(void)
+{
+	return fd;
+}
+
+/*
+ * Run the timers that are due.  Timers that became due while
+ * others ran are run too, so close deadlines are coalesced into
+ * one wakeup.
+ */
+void run_timers(void)
+{
+	struct timer *tp;
+	uint64_t expirations;
+	long long t;
+	LIST *lp;
+
+	if (fd != -1)
+		(void)read(fd, &expirations, sizeof expirations);
+	armed = 0;
+
+	t = now_us();
+	while ((lp = LIST_HEAD(&timers)) != NULL) {
+		tp = LIST_ITEM(lp, struct timer, link);
+		if (tp->deadline > t)
+			break;
+		LIST_REMOVE(&tp->link);
+		if (tp->period != 0) {
+			tp->deadline = nextperiod(tp);
+			insert(tp);
+		}
+		TRACE_BEGIN(TR_TIMER, tp->period);
+		tp->fn(tp->arg);
+		TRACE_END(TR_TIMER);
+	}
+	rearm();
+}
+
+void timer_init(void)
+{
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd == -1)
+		error("timerfd_create: %s", strerror(errno));
+	else
+		rearm();
+}
+
+void timer_fini(void)
+{
+	LIST *lp;
+
+	while ((lp = LIST_HEAD(&timers)) != NULL)
+		LIST_REMOVE(lp);
+	if (fd != -1)
+		close(fd);
+	fd = -1;
+	armed = 0;
+}
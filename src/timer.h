@@ -0,0 +1,53 @@
+#if !defined(TIMER_H)
+#define TIMER_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "list.h"
+
+/*
+ * One-shot and periodic timers on CLOCK_MONOTONIC.  All timers share
+ * a single timerfd, armed for the earliest deadline, so the process
+ * only wakes up when a timer is actually due and never when none is
+ * running.
+ */
+struct timer {
+	long long deadline;	/* ns on CLOCK_MONOTONIC */
+	long period;		/* ms, 0 for one-shot */
+	int aligned;		/* periods start on wall clock boundaries */
+	void (*fn)(void *);
+	void *arg;
+	LIST link;		/* in the list of running timers */
+};
+
+void init_timer(struct timer *, void (*)(void *), void *);
+void start_timer(struct timer *, long);
+void start_periodic_timer(struct timer *, long, int);
+void stop_timer(struct timer *);
+int timer_running(struct timer *);
+int timer_fd(void);
+void run_timers(void);
+void timer_init(void);
+void timer_fini(void);
+
+#endif /* !defined(TIMER_H) */
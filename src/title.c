@@ -24,7 +24,6 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include <assert.h>
 #include <string.h>
 #include <time.h>
 #include <X11/Xlib.h>
@@ -32,12 +31,89 @@
 #include <X11/Xft/Xft.h>
 
 #include "global.h"
+#include "icon.h"
 #include "menu.h"
 #include "lib.h"
+#include "stats.h"
+#include "timer.h"
 #include "title.h"
 #include "window.h"
 
+/*
+ * All titles are rendered through one shared scratch surface and then
+ * copied to their window, so the server holds a single title-sized
+ * pixmap instead of one per managed window.  The scratch grows to fit
+ * the largest title painted so far and is released with the last title.
+ */
+static struct {
+	Pixmap pixmap;
+	XftDraw *xftdraw;
+	GC gc;
+	int width;
+	int height;
+	int depth;
+	int users;
+} scratch = { None, NULL, None, 0, 0, 0, 0 };
+
+/*
+ * The clock in the active title ticks on a timer that only runs
+ * while the clock is actually visible.
+ */
+static struct timer clocktimer;
+static int clockpaused = 0;
+
+static void free_scratch(void)
+{
+	if (scratch.pixmap == None)
+		return;
+	XftDrawDestroy(scratch.xftdraw);
+	XFreeGC(display, scratch.gc);
+	XFreePixmap(display, scratch.pixmap);
+	XRES_DROP(XRES_GC);
+	XRES_DROP(XRES_PIXMAP);
+	scratch.pixmap = None;
+	scratch.xftdraw = NULL;
+	scratch.gc = None;
+	scratch.width = 0;
+	scratch.height = 0;
+}
+
+static void fit_scratch(struct title *tp)
+{
+	XGCValues gcval;
+	int width, height;
+
+	/* the visual changes with the compositor */
+	if (scratch.pixmap != None && tp->widget.depth != scratch.depth)
+		free_scratch();
+
+	if (scratch.pixmap != None
+	    && WIDGET_WIDTH(tp) <= scratch.width
+	    && WIDGET_HEIGHT(tp) <= scratch.height)
+		return;
 
+	width = scratch.width;
+	height = scratch.height;
+	if (WIDGET_WIDTH(tp) > width)
+		width = MAX(LARGER(width), WIDGET_WIDTH(tp));
+	if (WIDGET_HEIGHT(tp) > height)
+		height = MAX(height, WIDGET_HEIGHT(tp));
+	free_scratch();
+
+	debug("increasing title scratch size (%dx%d)", width, height);
+	scratch.width = width;
+	scratch.height = height;
+	scratch.depth = tp->widget.depth;
+	scratch.pixmap = XCreatePixmap(display, WIDGET_XWINDOW(tp),
+	    width, height, tp->widget.depth);
+	scratch.xftdraw = XftDrawCreate(display, scratch.pixmap,
+	    tp->widget.visual, tp->widget.colormap);
+	gcval.graphics_exposures = False;
+	scratch.gc = XCreateGC(display, scratch.pixmap,
+	    GCGraphicsExposures, &gcval);
+	XRES_HOLD(XRES_PIXMAP);
+	XRES_HOLD(XRES_GC);
+}
 
 static void prepare_repaint(struct widget *widget)
 {
@@ -66,28 +142,42 @@ static void repaint(struct widget *widget)
 	    WIDGET_WIDTH(title) - 2 * xpad;
 	int off;
 
+	/* nothing to show, an Expose will bring us back */
+	if (!WIDGET_MAPPED(title))
+		return;
+
+	fit_scratch(title);
+
 	/* clear */
-	XftDrawRect(title->xftdraw, &xftBg, 0, 0, WIDGET_WIDTH(title), WIDGET_HEIGHT(title));
+	fillrect(scratch.xftdraw, &xftBg, 0, 0, WIDGET_WIDTH(title), WIDGET_HEIGHT(title));
 	/* repaint */
 
+	if (win->icon != NULL) {
+		draw_icon(win->icon, scratch.xftdraw, xpad, title_pad);
+		xpad += win->icon->size + title_pad;
+		maxwidth -= win->icon->size + title_pad;
+	}
 	if (win->name != NULL && strlen(win->name) > 0) {
 		buf = STRDUP(win->name);
 		stringfit(buf, maxwidth);
-		XftDrawString8(title->xftdraw, &xftFg, xftfont, xpad, title_pad+xftfont->ascent, (XftChar8 *) (buf), strlen(buf));
+		drawstring(scratch.xftdraw, &xftFg, xpad, title_pad+xftfont->ascent, buf);
 	}
-	if (window_family_is_active(title->window)) {
+	if (window_is_active(win)) {
+		/* only the active title has room reserved for it */
 		time_t t = time(NULL);
-    		struct tm *tm = localtime(&t);
-    		char s[64];
-    		assert(strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S %A", tm));
-		XftDrawString8(title->xftdraw, &xftFg, xftfont, WIDGET_WIDTH(title) - button_size - stringwidth(s), title_pad+xftfont->ascent, (XftChar8 *) (s), strlen(s));
-	 }
+		struct tm *tm = localtime(&t);
+		char s[64];
+
+		if (strftime(s, sizeof s, "%Y-%m-%d %H:%M:%S %A", tm) > 0)
+			drawstring(scratch.xftdraw, &xftFg,
+			    WIDGET_WIDTH(title) - button_size - stringwidth(s),
+			    title_pad + xftfont->ascent, s);
+	}
 
 	/* display */
-	if (WIDGET_MAPPED(title))
-		XCopyArea(display,
-		    title->pixmap, WIDGET_XWINDOW(title), title->gc,
-		    0, 0, WIDGET_WIDTH(title), WIDGET_HEIGHT(title), 0, 0);
+	XCopyArea(display,
+	    scratch.pixmap, WIDGET_XWINDOW(title), scratch.gc,
+	    0, 0, WIDGET_WIDTH(title), WIDGET_HEIGHT(title), 0, 0);
 
 	FREE(buf);
 }
@@ -143,10 +233,9 @@ static void titleevent(struct widget *widget, XEvent *ep)
 		}
 		break;
 	case Expose:
-		XCopyArea(display, title->pixmap, WIDGET_XWINDOW(title),
-		    title->gc, ep->xexpose.x, ep->xexpose.y,
-		    ep->xexpose.width, ep->xexpose.height,
-		    ep->xexpose.x, ep->xexpose.y);
+		/* the scratch is shared, so repaint instead of copying */
+		if (ep->xexpose.count == 0)
+			REPAINT(title);
 		break;
 	}
 }
@@ -154,19 +243,13 @@ static void titleevent(struct widget *widget, XEvent *ep)
 struct title *create_title(struct window *window, int x, int y,
     int width, int height)
 {
-	XGCValues gcval;
 	struct title *tp;
 
 	tp = MALLOC(sizeof (struct title));
 	create_widget(&tp->widget, WIDGET_TITLE, WIDGET_XWINDOW(window),
 	    InputOutput, x, y, width, height, False);
-	tp->pixmap = XCreatePixmap(display, WIDGET_XWINDOW(tp),
-	    tp->pixmapwidth = width, tp->pixmapheight = height,
-	    tp->widget.depth);
 	tp->xwindow = tp->widget.xwindow;
-	tp->xftdraw = XftDrawCreate(display, tp->pixmap, tp->widget.visual,tp->widget.colormap);
-	gcval.graphics_exposures = False;
-	tp->gc = XCreateGC(display, tp->pixmap,GCGraphicsExposures, &gcval);
+	scratch.users++;
 	tp->window = window;
 	tp->widget.event = titleevent;
 	tp->widget.prepare_repaint = prepare_repaint;
@@ -183,27 +266,6 @@ struct title *create_title(struct window *window, int x, int y,
 
 void resize_title(struct title *tp, int width, int height)
 {
-	if (width > tp->pixmapwidth || height > tp->pixmapheight) {
-		XFreePixmap(display, tp->pixmap);
-		if (width > tp->pixmapwidth)
-			tp->pixmapwidth = MAX(LARGER(tp->pixmapwidth),
-			                      width);
-		if (height > tp->pixmapheight)
-			tp->pixmapheight = MAX(LARGER(tp->pixmapheight),
-			                       height);
-		debug("increasing title pixmap size (%dx%d)",
-		    tp->pixmapwidth, tp->pixmapheight);
-		tp->pixmap = XCreatePixmap(display, WIDGET_XWINDOW(tp),
-		    tp->pixmapwidth, tp->pixmapheight,
-		    tp->widget.depth);
-		XftDrawDestroy(tp->xftdraw);
-		XFreeGC(display, tp->gc);
-		XGCValues gcval;
-		gcval.graphics_exposures = False;
-		tp->gc =XCreateGC(display, tp->pixmap, GCGraphicsExposures, &gcval);
-		tp->xftdraw = XftDrawCreate(display, tp->pixmap, tp->widget.visual,tp->widget.colormap);
-	}
-
 	resize_widget(&tp->widget, width, height);
 	REPAINT(tp);
 }
@@ -211,8 +273,38 @@ void resize_title(struct title *tp, int width, int height)
 void destroy_title(struct title *title)
 {
 	destroy_widget(&title->widget);
-	XftDrawDestroy(title->xftdraw);
-	XFreePixmap(display, title->pixmap);
-	XFreeGC(display, title->gc);
+	if (--scratch.users == 0)
+		free_scratch();
 	FREE(title);
 }
+
+static void tick(void *arg)
+{
+	if (active != NULL && active->title != NULL && !overloaded)
+		REPAINT(active->title);
+}
+
+/*
+ * Run the clock if there is a title showing it, stop it otherwise.
+ */
+void update_clock(void)
+{
+	if (clocktimer.fn == NULL)
+		init_timer(&clocktimer, tick, NULL);
+	if (!clockpaused && active != NULL && !active->undecorated
+	    && active->title != NULL && WIDGET_MAPPED(active)) {
+		if (!timer_running(&clocktimer))
+			REPAINT(active->title);
+		start_periodic_timer(&clocktimer, 1000, 1);
+	} else
+		stop_timer(&clocktimer);
+}
+
+/*
+ * Stop the clock while the screen is blanked.
+ */
+void pause_clock(int paused)
+{
+	clockpaused = paused;
+	update_clock();
+}
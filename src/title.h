@@ -32,17 +32,12 @@ struct window;
 struct title { struct widget widget;
 	struct window *window;
 	Window xwindow;
-	Pixmap pixmap;
         XftColor xftBg;
 	XftColor xftFg;
-	int pixmapwidth;
-	int pixmapheight;
-	GC gc;
 	int xoff;
 	int yoff;
 	int moving;
 	Time lastclick;
-	XftDraw *xftdraw;
 };
 
 
@@ -50,5 +45,7 @@ struct title *create_title(struct window *, int, int, int, int);
 void resize_title(struct title *, int, int);
 void destroy_title(struct title *);
 void repaint_title(struct title *);
+void update_clock(void);
+void pause_clock(int);
 
 #endif /* !defined(TITLE_H) */
@@ -0,0 +1,170 @@
+/*
+ * trace.c - event trace ring buffer
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Trace points write a fixed size record into a ring buffer that
+ * always holds the most recent TRACESIZE of them; nothing is
+ * formatted until the buffer is dumped.  Dumps are in the Chrome
+ * trace event format, which chrome://tracing and Perfetto load.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "global.h"
+#include "trace.h"
+
+#define TRACESIZE	65536	/* records, a power of two */
+
+/* Least time between two dumps caused by stalls (us) */
+#define STALLDUMPGAP	(10 * 1000000LL)
+
+struct record {
+	long long us;
+	long arg;
+	unsigned short id;
+	char phase;		/* 'B'egin, 'E'nd or 'i'nstant */
+};
+
+static const char *names[NTRACE] = {
+	[TR_DISPATCH] = "dispatch",
+	[TR_REPAINT] = "repaint",
+	[TR_RESTACK] = "restack",
+	[TR_MANAGE] = "manage",
+	[TR_UNMANAGE] = "unmanage",
+	[TR_HINT] = "hint",
+	[TR_PROPERTY] = "property",
+	[TR_TIMER] = "timer",
+	[TR_STALL] = "stall",
+};
+
+static struct record ring[TRACESIZE];
+static unsigned long next = 0;
+
+/* Main loop iterations longer than this are stalls (us), 0 for none */
+static long long stall = 0;
+
+/* When the current iteration began, 0 while idle */
+static long long iterstart = 0;
+
+static long long lastdump = 0;
+
+/*
+ * Dump the buffer when an iteration of the main loop takes longer
+ * than stallms milliseconds, or never if 0.
+ */
+void trace_init(long stallms)
+{
+	stall = stallms * 1000LL;
+}
+
+void trace_record(int id, int phase, long arg)
+{
+	struct record *rp = &ring[next++ & (TRACESIZE - 1)];
+
+	rp->us = now_us();
+	rp->arg = arg;
+	rp->id = id;
+	rp->phase = phase;
+}
+
+static void checkstall(long long t)
+{
+	char path[64];
+
+	if (stall == 0 || iterstart == 0 || t - iterstart < stall)
+		return;
+	trace_record(TR_STALL, 'i', (t - iterstart) / 1000);
+	if (lastdump != 0 && t - lastdump < STALLDUMPGAP)
+		return;
+	snprintf(path, sizeof path, "karmen-stall-%lld.json", t / 1000);
+	trace_dump(path);
+}
+
+/*
+ * Called at the top of each iteration of the main loop.
+ */
+void trace_iteration(void)
+{
+	long long t = now_us();
+
+	checkstall(t);
+	iterstart = t;
+}
+
+/*
+ * Called before the main loop blocks; waiting is not a stall.
+ */
+void trace_idle(void)
+{
+	checkstall(now_us());
+	iterstart = 0;
+}
+
+/*
+ * Write the buffer to name in $TMPDIR (or /tmp), oldest record first.
+ */
+void trace_dump(const char *name)
+{
+	struct record *rp;
+	unsigned long i, first;
+	char path[1024];
+	const char *dir;
+	FILE *fp;
+	int pid = getpid();
+
+	if ((dir = getenv("TMPDIR")) == NULL)
+		dir = "/tmp";
+	snprintf(path, sizeof path, "%s/%s", dir, name);
+	if ((fp = fopen(path, "w")) == NULL) {
+		error("%s: %s", path, strerror(errno));
+		return;
+	}
+
+	first = next > TRACESIZE ? next - TRACESIZE : 0;
+	fprintf(fp, "{\"traceEvents\": [\n");
+	for (i = first; i < next; i++) {
+		rp = &ring[i & (TRACESIZE - 1)];
+		fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"%c\", "
+		    "\"ts\": %lld, \"pid\": %d, \"tid\": 1",
+		    i == first ? "" : ",\n", names[rp->id], rp->phase,
+		    rp->us, pid);
+		if (rp->phase == 'i')
+			fprintf(fp, ", \"s\": \"p\"");
+		if (rp->phase != 'E')
+			fprintf(fp, ", \"args\": {\"arg\": %ld}", rp->arg);
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "\n]}\n");
+	if (fclose(fp) == EOF)
+		error("%s: %s", path, strerror(errno));
+	else
+		error("trace written to %s", path);
+	lastdump = now_us();
+}
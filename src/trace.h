@@ -0,0 +1,60 @@
+#if !defined(TRACE_H)
+#define TRACE_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Static trace points, see names[] in trace.c */
+enum trace_id {
+	TR_DISPATCH,
+	TR_REPAINT,
+	TR_RESTACK,
+	TR_MANAGE,
+	TR_UNMANAGE,
+	TR_HINT,
+	TR_PROPERTY,
+	TR_TIMER,
+	TR_STALL,
+	NTRACE
+};
+
+#if CONFIG_TRACE
+#define TRACE_BEGIN(id, arg)	trace_record((id), 'B', (arg))
+#define TRACE_END(id)		trace_record((id), 'E', 0)
+#define TRACE_MARK(id, arg)	trace_record((id), 'i', (arg))
+#define TRACE_ITERATION()	trace_iteration()
+#define TRACE_IDLE()		trace_idle()
+#else
+#define TRACE_BEGIN(id, arg)	do { } while (0)
+#define TRACE_END(id)		do { } while (0)
+#define TRACE_MARK(id, arg)	do { } while (0)
+#define TRACE_ITERATION()	do { } while (0)
+#define TRACE_IDLE()		do { } while (0)
+#endif
+
+void trace_init(long);
+void trace_record(int, int, long);
+void trace_iteration(void);
+void trace_idle(void);
+void trace_dump(const char *);
+
+#endif /* !defined(TRACE_H) */
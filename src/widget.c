@@ -24,47 +24,101 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+
 #include <X11/cursorfont.h>
 #include <X11/Xlib.h>
 #include <X11/Xresource.h>
 #include <X11/Xutil.h>
 
 #include "global.h"
+#include "stats.h"
+#include "trace.h"
 #include "widget.h"
+#include "xcount.h"
 
 static XContext wmcontext;
 
+/* Time a repaint pass may take before input gets a turn (us) */
+#define REPAINTBUDGET	4000
+
+/* Newly invalidated widgets, not ranked yet */
 static LIST_DEFINE(repaintlist);
 
+/* Invalidated widgets by rank, see repaint_rank() */
+static LIST ranked[NRANK];
+
+static struct repaintstats stats;
+
+/* Widgets in existence */
+static int nwidgets = 0;
+
+/* Nonzero if new widgets are created with the 32-bit ARGB visual */
+static int argb = 0;
+static XVisualInfo argbvinfo;
+static Colormap argbcolormap = None;
+
 void widget_init(void)
 {
+	int i;
+
 	wmcontext = XUniqueContext();
+	for (i = 0; i < NRANK; i++)
+		LIST_INIT(&ranked[i]);
 }
 
 void widget_fini(void)
 {
+	debug("%lu repaints in %lu passes, %lu merged, %lu yields, "
+	    "deepest queue %u, longest pass %ldus",
+	    stats.painted, stats.passes, stats.merged, stats.yields,
+	    stats.maxdepth, stats.maxus);
+
+	if (argbcolormap != None) {
+		XFreeColormap(display, argbcolormap);
+		XRES_DROP(XRES_COLORMAP);
+		argbcolormap = None;
+	}
 }
 
-void create_widget(struct widget *widget, enum widget_type type,
-    Window xparent, unsigned class, int x, int y, int width, int height, int isresize)
+/*
+ * Select the visual used for widgets created from now on.  The ARGB
+ * visual is only worth its cost when a compositor blends the result;
+ * without one, widgets use the default visual and core drawing.
+ * Existing widgets keep their visual.
+ */
+void set_widget_argb(int on)
+{
+	if (on && !XMatchVisualInfo(display, screen, 32, TrueColor,
+	    &argbvinfo))
+		on = 0;
+	if (on && argbcolormap == None) {
+		argbcolormap = XCreateColormap(display, root,
+		    argbvinfo.visual, AllocNone);
+		XRES_HOLD(XRES_COLORMAP);
+	}
+	argb = on;
+}
+
+int widget_argb(void)
+{
+	return argb;
+}
+
+/*
+ * Create the widget's X window, on the ARGB visual if that is in use.
+ */
+static void newxwindow(struct widget *widget, Window xparent,
+    unsigned class, int isresize)
 {
 	XSetWindowAttributes attr;
-	XVisualInfo vinfo;
 
-	widget->type = type;
-	widget->dim.x = x;
-	widget->dim.y = y;
-	widget->dim.width = width;
-	widget->dim.height = height;
-	widget->event = NULL;
-	widget->mapped = False;
 	attr.override_redirect = True;
 //	widget->xwindow = XCreateSimpleWindow(display, xparent, x, y, width, height, 1,
 //                           BlackPixel(display, screen), WhitePixel(display, screen));
-	if (!XMatchVisualInfo(display, XDefaultScreen(display), 32, TrueColor, &vinfo) || isresize)
-        {
+	if (!argb || isresize) {
 		widget->xwindow = XCreateWindow(display, xparent,
-	    		x, y, width, height, 0,
+	    		widget->dim.x, widget->dim.y,
+	    		widget->dim.width, widget->dim.height, 0,
 	    		CopyFromParent,
 	    		class,
 	    		CopyFromParent,
@@ -73,23 +127,56 @@ void create_widget(struct widget *widget, enum widget_type type,
 		widget->visual = DefaultVisual(display,screen);
 		widget->colormap = DefaultColormap(display,screen);
 	} else {
-		Visual *visual;
-		int depth;
-		visual = vinfo.visual;
-  		depth = vinfo.depth;
-		attr.colormap = XCreateColormap(display, xparent, visual, AllocNone);
+		attr.colormap = argbcolormap;
   		attr.background_pixel = 0;
   		attr.border_pixel = 0;
-		widget->xwindow = XCreateWindow(display, xparent, x, y, width, height, 0, depth, class,
-                visual, CWOverrideRedirect | CWColormap | CWBorderPixel | CWBackPixel , &attr);
-		widget->depth = depth;
-		widget->visual = visual;
-		widget->colormap = attr.colormap;
+		widget->xwindow = XCreateWindow(display, xparent,
+		    widget->dim.x, widget->dim.y,
+		    widget->dim.width, widget->dim.height, 0,
+		    argbvinfo.depth, class, argbvinfo.visual,
+		    CWOverrideRedirect | CWColormap | CWBorderPixel | CWBackPixel, &attr);
+		widget->depth = argbvinfo.depth;
+		widget->visual = argbvinfo.visual;
+		widget->colormap = argbcolormap;
 	}
 	XSaveContext(display, widget->xwindow, wmcontext, (XPointer)widget);
+}
+
+void create_widget(struct widget *widget, enum widget_type type,
+    Window xparent, unsigned class, int x, int y, int width, int height, int isresize)
+{
+	widget->type = type;
+	widget->dim.x = x;
+	widget->dim.y = y;
+	widget->dim.width = width;
+	widget->dim.height = height;
+	widget->event = NULL;
+	widget->mapped = False;
+	newxwindow(widget, xparent, class, isresize);
 	widget->prepare_repaint = NULL;
 	widget->repaint = NULL;
+	widget->frame = type == WIDGET_WINDOW ? widget :
+	    find_widget(xparent, WIDGET_WINDOW);
 	LIST_INIT(&widget->repaintlink);
+	nwidgets++;
+}
+
+/*
+ * Give the widget a new X window on the visual now in use, in the
+ * same place, and mapped if the widget is.  Everything else about the
+ * widget is kept.  The old window is returned for the caller to
+ * destroy once it has moved out what it wants to keep.
+ */
+Window replace_widget_window(struct widget *widget, Window xparent,
+    unsigned class)
+{
+	Window old = widget->xwindow;
+
+	XDeleteContext(display, old, wmcontext);
+	newxwindow(widget, xparent, class, False);
+	if (widget->mapped)
+		XMapWindow(display, widget->xwindow);
+	return old;
 }
 
 void save_widget_context(struct widget *widget, Window xwindow)
@@ -152,6 +239,7 @@ void destroy_widget(struct widget *widget)
 	LIST_REMOVE(&widget->repaintlink);
 	XDeleteContext(display, widget->xwindow, wmcontext);
 	XDestroyWindow(display, widget->xwindow);
+	nwidgets--;
 }
 
 void delete_widget_context(Window xwindow)
@@ -163,20 +251,94 @@ void schedule_widget_repaint(struct widget *wp)
 {
 	if (wp->prepare_repaint != NULL)
 		wp->prepare_repaint(wp);
-	if (!LIST_MEMBER(&wp->repaintlink))
+	if (LIST_MEMBER(&wp->repaintlink))
+		stats.merged++;
+	else
 		LIST_INSERT_TAIL(&repaintlist, &wp->repaintlink);
 }
 
-void repaint_widgets(void)
+/*
+ * Repaint invalidated widgets, most visible first, until they are
+ * all done, the budget is spent or inputwaiting, if given, says that
+ * input has arrived; other events can wait.  At least one widget is
+ * repainted per call so that a busy connection can't starve the
+ * decorations.  Widgets are ranked anew on every pass since
+ * activation may have changed in between.  While overloaded only
+ * overlays and the active family are repainted.
+ */
+void repaint_widgets(int (*inputwaiting)(void))
 {
 	struct widget *wp;
 	LIST *lp;
+	long start, t;
+	unsigned depth = 0;
+	int i;
 
-	while (!LIST_EMPTY(&repaintlist)) {
-		lp = LIST_HEAD(&repaintlist);
+	for (i = 0; i < NRANK; i++)
+		while ((lp = LIST_HEAD(&ranked[i])) != NULL) {
+			LIST_REMOVE(lp);
+			LIST_INSERT_TAIL(&repaintlist, lp);
+		}
+	while ((lp = LIST_HEAD(&repaintlist)) != NULL) {
 		LIST_REMOVE(lp);
 		wp = LIST_ITEM(lp, struct widget, repaintlink);
-		if (wp->repaint != NULL)
-			wp->repaint(wp);
+		LIST_INSERT_TAIL(&ranked[repaint_rank(wp)], lp);
+		depth++;
+	}
+	if (depth == 0)
+		return;
+
+	XC_ENTER(XC_REPAINT);
+	TRACE_BEGIN(TR_REPAINT, depth);
+	stats.passes++;
+	stats.depth = depth;
+	stats.maxdepth = MAX(stats.maxdepth, depth);
+	start = now_us();
+	for (i = 0; i < (overloaded ? RANK_ACTIVE + 1 : NRANK); i++) {
+		while ((lp = LIST_HEAD(&ranked[i])) != NULL) {
+			LIST_REMOVE(lp);
+			wp = LIST_ITEM(lp, struct widget, repaintlink);
+			if (wp->repaint != NULL)
+				wp->repaint(wp);
+			stats.painted++;
+			if (repaint_pending() && (now_us() - start >=
+			    REPAINTBUDGET ||
+			    (inputwaiting != NULL && inputwaiting()))) {
+				stats.yields++;
+				goto out;
+			}
+		}
 	}
+out:
+	t = now_us() - start;
+	stats.lastus = t;
+	stats.maxus = MAX(stats.maxus, t);
+	stats.totalus += t;
+	TRACE_END(TR_REPAINT);
+	XC_LEAVE();
+}
+
+/*
+ * Whether widgets are still waiting to be repainted.
+ */
+int repaint_pending(void)
+{
+	int i;
+
+	if (!LIST_EMPTY(&repaintlist))
+		return 1;
+	for (i = 0; i < NRANK; i++)
+		if (!LIST_EMPTY(&ranked[i]))
+			return 1;
+	return 0;
+}
+
+const struct repaintstats *repaint_stats(void)
+{
+	return &stats;
+}
+
+int widget_count(void)
+{
+	return nwidgets;
 }
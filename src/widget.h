@@ -34,7 +34,34 @@ enum widget_type {
 	WIDGET_BUTTON,
 	WIDGET_MENU,
 	WIDGET_RESIZER,
-	WIDGET_SIZEWIN
+	WIDGET_SIZEWIN,
+	WIDGET_PREVIEW
+};
+
+/*
+ * Repaint order: overlays first, then the focused family, then the
+ * rest of the visible frames by layer, hidden ones last.
+ */
+enum repaint_rank {
+	RANK_OVERLAY,
+	RANK_ACTIVE,
+	RANK_ONTOP,
+	RANK_MAPPED,
+	RANK_HIDDEN,
+	NRANK
+};
+
+/* Repaint scheduler counters, see repaint_widgets() */
+struct repaintstats {
+	unsigned long passes;		/* calls with work to do */
+	unsigned long painted;		/* widgets repainted */
+	unsigned long merged;		/* invalidations of queued widgets */
+	unsigned long yields;		/* passes cut short */
+	unsigned depth;			/* queue depth at the last pass */
+	unsigned maxdepth;
+	long lastus;			/* time spent in the last pass */
+	long maxus;
+	long long totalus;
 };
 
 struct dim {
@@ -55,6 +82,7 @@ struct widget {
 	void (*event)(struct widget *, XEvent *);
 	void (*prepare_repaint)(struct widget *);
 	void (*repaint)(struct widget *);
+	struct widget *frame;	/* the frame decorated, or NULL */
 	LIST repaintlink;
 };
 
@@ -69,8 +97,11 @@ struct widget {
 
 void widget_init(void);
 void widget_fini(void);
+void set_widget_argb(int);
+int widget_argb(void);
 void create_widget(struct widget *, enum widget_type,
     Window, unsigned, int, int, int, int, int );
+Window replace_widget_window(struct widget *, Window, unsigned);
 void resize_widget(struct widget *, int, int);
 void move_widget(struct widget *, int, int);
 void moveresize_widget(struct widget *, int, int, int, int);
@@ -81,6 +112,10 @@ struct widget *find_widget(Window, enum widget_type);
 void delete_widget_context(Window);
 void save_widget_context(struct widget *, Window);
 void schedule_widget_repaint(struct widget *);
-void repaint_widgets(void);
+void repaint_widgets(int (*)(void));
+int repaint_pending(void);
+const struct repaintstats *repaint_stats(void);
+int widget_count(void);
+int repaint_rank(struct widget *);
 
 #endif /* !defined(WIDGET_H) */
@@ -37,13 +37,22 @@
 #include <X11/Xutil.h>
 
 #include "button.h"
+#include "geom.h"
 #include "global.h"
 #include "hints.h"
+#include "icon.h"
 #include "lib.h"
 #include "menu.h"
 #include "resizer.h"
+#include "stats.h"
+#if CONFIG_THUMBNAILS
+#include "thumb.h"
+#endif
+#include "timer.h"
 #include "title.h"
+#include "trace.h"
 #include "window.h"
+#include "xcount.h"
 
 #define NBTN	2
 
@@ -60,23 +69,48 @@ static Window front;
 
 static LIST_DEFINE(normallayer);
 static LIST_DEFINE(toplayer);
+
+/* Windows with properties to fetch, see fetch_dirty_properties() */
+static LIST_DEFINE(dirtywindows);
+
+/* Property changes that were merged into a pending fetch, or not */
+static struct cachestats propstats;
+
+/* Windows with a ConfigureRequest held back by throttling */
+static LIST_DEFINE(deferredconf);
+
+/* Windows with ClientMessages held back by throttling */
+static LIST_DEFINE(deferredmsg);
+
+/* Wakes the main loop when held back work becomes due */
+static struct timer defertimer;
+
 static int needrestack = 0;
+
+/*
+ * Nesting depth of transactions, and the activation they put off:
+ * txwindow, or the topmost window if that is NULL.
+ */
+static int transaction = 0;
+static int txactivate = 0;
+static struct window *txwindow = NULL;
+static int stackingstale = 0;
 static int nwindows = 0;
 
 static int panelheight = 0;
 
 static Cursor movecurs;
 
-static void client_to_window_geom(XWindowAttributes *, XSizeHints *,
-    int *x, int *y, int *width, int *height, Bool undecorated);
-static void window_to_client_geom(struct window *,
-    int *x, int *y, int *width, int *height, Bool undecorated);
 static void confevent(struct window *, XConfigureRequestEvent *);
 static void windowevent(struct widget *, XEvent *);
 static void setgrav(Window, int);
 static void restack_transient_windows(struct window *);
 static void put_window_group_below(struct window *);
 static void selectfrommenu(void *ptr);
+static void update_menu_label(struct window *);
+static struct window *manage(Window, int);
+static void fetch_properties(struct window *);
+static void index_window(struct window *);
 static struct window *topmost_window(void);
 static void fitwin(struct window *);
 static void smartpos(int, int, int *, int *);
@@ -119,7 +153,8 @@ void window_init(void)
 	front = XCreateWindow(display, root, 0, 0, 1, 1, 0, 0, InputOnly,
 	    	CopyFromParent, CWOverrideRedirect, &attr);
 
-	movecurs = XCreateFontCursor(display, XC_fleur);
+	if (movecurs == None)
+		movecurs = XCreateFontCursor(display, XC_fleur);
 
 	UTF8_STRING = XInternAtom(display, "UTF8_STRING", False);
 	WM_STATE = XInternAtom(display, "WM_STATE", False);
@@ -130,10 +165,12 @@ void window_init(void)
 	MOTIF_WM_HINTS = XInternAtom(display, "_MOTIF_WM_HINTS", False);
 
 	if (XQueryTree(display, root, &d1, &d2, &winlist, &n)) {
+		begin_transaction();
 		for (i = 0; i < n; i++)
 			if (find_widget(winlist[i], WIDGET_ANY) == NULL
 			    && ismapped(winlist[i]))
 				manage_window(winlist[i], 1);
+		commit_transaction();
 		if (winlist != NULL)
 			XFree(winlist);
 	}
@@ -144,6 +181,7 @@ void window_fini(void)
 	struct window *win;
 	LIST *lp;
 
+	begin_transaction();
 	while (!LIST_EMPTY(&normallayer)) {
 		lp = LIST_TAIL(&normallayer);
 		win = LIST_ITEM(lp, struct window, layerlink);
@@ -154,15 +192,71 @@ void window_fini(void)
 		win = LIST_ITEM(lp, struct window, layerlink);
 		unmanage_window(win, 0);
 	}
+	commit_transaction();
 
 	XDestroyWindow(display, front);
 }
 
+/*
+ * A transaction groups a burst of manages and unmanages.  Each
+ * window is set up or torn down right away, under its own grabs,
+ * but activation, the restack, the EWMH client list and the final
+ * XSync happen once, when the outermost transaction is committed.
+ */
+void begin_transaction(void)
+{
+	transaction++;
+}
+
+void commit_transaction(void)
+{
+	struct window *win;
+
+	assert(transaction > 0);
+	if (--transaction > 0)
+		return;
+
+	if (txactivate) {
+		win = txwindow;
+		txactivate = 0;
+		txwindow = NULL;
+		if (win != NULL)
+			set_active_window(win);
+		else if (active == NULL)
+			set_active_window(topmost_window());
+	}
+	restack_all_windows();
+	hints_commit();
+	XSync(display, False);
+}
+
+/*
+ * Activate win, or the topmost window if NULL, when the current
+ * transaction is committed.
+ */
+static void activate_later(struct window *win)
+{
+	txactivate = 1;
+	if (win != NULL)
+		txwindow = win;
+}
+
+/*
+ * Note that the window must be restacked.  Windows that didn't move
+ * keep their order relative to each other, so only the moved ones
+ * need a request; see restack_all_windows().
+ */
+static void stackmoved(struct window *win)
+{
+	win->restack = 1;
+	needrestack = 1;
+}
+
 void raise_window(struct window *win)
 {
 	LIST_REMOVE(&win->layerlink);
 	LIST_INSERT_HEAD(win->layer, &win->layerlink);
-	needrestack = 1;
+	stackmoved(win);
 }
 
 void lower_window(struct window *win)
@@ -170,7 +264,7 @@ void lower_window(struct window *win)
 	LIST_REMOVE(&win->layerlink);
 	win->layer = &normallayer;
 	LIST_INSERT_TAIL(win->layer, &win->layerlink);
-	needrestack = 1;
+	stackmoved(win);
 	repaint_window(win);	/* might have changed layer */
 }
 
@@ -178,7 +272,7 @@ static void lower_window_within_layer(struct window *win)
 {
 	LIST_REMOVE(&win->layerlink);
 	LIST_INSERT_TAIL(win->layer, &win->layerlink);
-	needrestack = 1;
+	stackmoved(win);
 }
 
 void put_window_above(struct window *win, struct window *ref)
@@ -186,7 +280,7 @@ void put_window_above(struct window *win, struct window *ref)
 	LIST_REMOVE(&win->layerlink);
 	win->layer = ref->layer;
 	LIST_INSERT_BEFORE(&ref->layerlink, &win->layerlink);
-	needrestack = 1;
+	stackmoved(win);
 	repaint_window(win);	/* might have changed layer */
 }
 
@@ -195,7 +289,7 @@ void put_window_below(struct window *win, struct window *ref)
 	LIST_REMOVE(&win->layerlink);
 	win->layer = ref->layer;
 	LIST_INSERT_AFTER(&ref->layerlink, &win->layerlink);
-	needrestack = 1;
+	stackmoved(win);
 	repaint_window(win);	/* might have changed layer */
 }
 
@@ -204,7 +298,7 @@ void toggle_window_ontop(struct window *win)
 	win->layer = win->layer == &toplayer ? &normallayer : &toplayer;
 	LIST_REMOVE(&win->layerlink);
 	LIST_INSERT_HEAD(win->layer, &win->layerlink);
-	needrestack = 1;
+	stackmoved(win);
 
 	restack_transient_windows(win);
 
@@ -216,6 +310,25 @@ int window_is_ontop(struct window *win)
 	return win->layer == &toplayer;
 }
 
+/*
+ * Where a widget goes in the repaint order, see repaint_widgets().
+ */
+int repaint_rank(struct widget *wp)
+{
+	struct window *win = (struct window *)wp->frame;
+
+	if (win == NULL)
+		return RANK_OVERLAY;
+	else if (window_family_is_active(win))
+		return RANK_ACTIVE;
+	else if (!WIDGET_MAPPED(win))
+		return RANK_HIDDEN;
+	else if (window_is_ontop(win))
+		return RANK_ONTOP;
+	else
+		return RANK_MAPPED;
+}
+
 void get_window_stack(struct window ***wins_return, int *nwins_return)
 {
 	LIST *lp;
@@ -259,33 +372,71 @@ void get_client_stack(Window **clients_return, int *nclients_return)
 
 void restack_all_windows(void)
 {
-	Window *xwins;
+	XWindowChanges wc;
 	struct window *win;
+	Window above;
 	LIST *lp;
 	int i;
 
 	if (!needrestack)
 		return;
 
-	xwins = MALLOC((nwindows + 1) * sizeof (Window));
-	xwins[0] = front;
-	i = 1;
+	XC_ENTER(XC_RESTACK);
+	TRACE_BEGIN(TR_RESTACK, nwindows);
+	/*
+	 * Walking down from the top, put each moved window right below
+	 * the one that is to be above it.  Those that didn't move are
+	 * already in order among themselves, so this yields the whole
+	 * order with one request per moved window.
+	 */
+	above = front;
+	wc.stack_mode = Below;
+	for (i = 0; i < 2; i++) {
+		LIST_FOREACH(lp, i == 0 ? &toplayer : &normallayer) {
+			win = LIST_ITEM(lp, struct window, layerlink);
+			if (win->restack) {
+				wc.sibling = above;
+				XConfigureWindow(display, WIDGET_XWINDOW(win),
+				    CWSibling | CWStackMode, &wc);
+				win->restack = 0;
+			}
+			above = WIDGET_XWINDOW(win);
+		}
+	}
+	needrestack = 0;
+
+	/* the EWMH stacking list is cosmetic, see catch_up_windows() */
+	if (overloaded)
+		stackingstale = 1;
+	else
+		hints_restack();
+	TRACE_END(TR_RESTACK);
+	XC_LEAVE();
+}
+
+/*
+ * Bring the decorations and the stacking list up to date after
+ * an overload, see checkload() in main.c.
+ */
+void catch_up_windows(void)
+{
+	struct window *win;
+	LIST *lp;
+
 	LIST_FOREACH(lp, &toplayer) {
-		assert(i < nwindows + 1);
 		win = LIST_ITEM(lp, struct window, layerlink);
-		xwins[i++] = WIDGET_XWINDOW(win);
+		if (WIDGET_MAPPED(win))
+			repaint_window(win);
 	}
 	LIST_FOREACH(lp, &normallayer) {
-		assert(i < nwindows + 1);
 		win = LIST_ITEM(lp, struct window, layerlink);
-		xwins[i++] = WIDGET_XWINDOW(win);
+		if (WIDGET_MAPPED(win))
+			repaint_window(win);
+	}
+	if (stackingstale) {
+		stackingstale = 0;
+		hints_restack();
 	}
-	assert(i == nwindows + 1);
-	XRestackWindows(display, xwins, nwindows + 1);
-	FREE(xwins);
-	needrestack = 0;
-
-	hints_restack();
 }
 
 static struct window *topmost_window(void)
@@ -400,6 +551,8 @@ void *getprop(Window xwindow, Atom prop, Atom type, int fmt, unsigned long *rcou
       return NULL;
     } else if (rtype != type || rfmt != fmt) {
       // Does not exist (type=None), or wrong type/format
+      if (ptr != NULL)
+        XFree(ptr);
       return NULL;
     } else if (rafter > 0) {
       XFree(ptr);
@@ -412,221 +565,175 @@ void *getprop(Window xwindow, Atom prop, Atom type, int fmt, unsigned long *rcou
 }
 
 
-static void client_to_window_geom(XWindowAttributes *attr, XSizeHints *sz,
-    int *x, int *y, int *width, int *height, Bool undecorated)
+void delete_window(struct window *win)
 {
-	int buttonSize = button_size;
-	if(undecorated) {
-	   buttonSize = 0;
-	}
-	int north, south, east, west, stat, center;
-
-	north = south = east = west = stat = center = 0;
-
-	if (sz->flags & PWinGravity) {
-		switch (sz->win_gravity) {
-		case SouthGravity:
-			south = 1;
-			break;
-		case SouthWestGravity:
-			south = 1;
-			west = 1;
-			break;
-		case SouthEastGravity:
-			south = 1;
-			east = 1;
-			break;
-		case NorthGravity:
-			north = 1;
-			break;
-		case NorthWestGravity:
-			north = 1;
-			west = 1;
-			break;
-		case NorthEastGravity:
-			north = 1;
-			east = 1;
-			break;
-		case CenterGravity:
-			center = 1;
-			break;
-		case StaticGravity:
-			stat = 1;
-			break;
-		default:
-			north = 1;
-			west = 1;
-			break;
-		}
-	} else {
-		north = 1;
-		west = 1;
-	}
-
-	if (north)
-		*y = attr->y;
-	else if (south)
-		*y = attr->y + 2 * attr->border_width
-		    - 2 * border_width - buttonSize;
-	else if (center)
-		*y = attr->y + attr->border_width
-		    + attr->height / 2
-		    - (attr->height + 2 * border_width + buttonSize) / 2;
-	else if (stat)
-		*y = attr->y + attr->border_width - border_width - buttonSize;
-	else
-		*y = attr->y;
-
-	if (west)
-		*x = attr->x;
-	else if (east)
-		*x = attr->x + 2 * attr->border_width
-		    - 2 * border_width;
-	else if (center)
-		*x = attr->x + attr->border_width
-		    + attr->width / 2
-		    - (attr->width + 2 * border_width) / 2;
-	else if (stat)
-		*x = attr->x + attr->border_width - border_width;
-	else
-		*x = attr->x;
-
-	*width = attr->width + 2 * border_width;
-	if(undecorated) {
-		*height = attr->height + 2 * border_width + buttonSize;
-	} else {
-		*height = attr->height + 2 * border_width + buttonSize;
+	if (!hints_delete(win)) {
+		clerr();
+		XKillClient(display, win->client);
+		sterr();
 	}
 }
 
-static void window_to_client_geom(struct window *win,
-    int *x, int *y, int *width, int *height, Bool undecorated)
+static void throttled(struct window *win, int class)
 {
-	int buttonSize = button_size;
-	if(undecorated) {
-	   buttonSize = 0;
-	}
-	int north, south, east, west, stat, center;
-
-	north = south = east = west = stat = center = 0;
-
-	if (win->wmnormalhints->flags & PWinGravity) {
-		switch (win->wmnormalhints->win_gravity) {
-		case SouthGravity:
-			south = 1;
-			break;
-		case SouthWestGravity:
-			south = 1;
-			west = 1;
-			break;
-		case SouthEastGravity:
-			south = 1;
-			east = 1;
-			break;
-		case NorthGravity:
-			north = 1;
-			break;
-		case NorthWestGravity:
-			north = 1;
-			west = 1;
-			break;
-		case NorthEastGravity:
-			north = 1;
-			east = 1;
-			break;
-		case CenterGravity:
-			center = 1;
-			break;
-		case StaticGravity:
-			stat = 1;
-			break;
-		default:
-			north = 1;
-			west = 1;
-			break;
-		}
-	} else {
-		north = 1;
-		west = 1;
-	}
-
-	if (north)
-		*y = WIDGET_Y(win);
-	else if (south)
-		*y = WIDGET_Y(win) - 2*win->cborder
-		    + 2*border_width + buttonSize;
-	else if (center)
-		*y = WIDGET_Y(win) + WIDGET_HEIGHT(win) / 2
-		    - (WIDGET_HEIGHT(win) - 2*border_width - buttonSize) / 2
-		    - win->cborder;
-	else if (stat)
-		*y = WIDGET_Y(win) - win->cborder + border_width + buttonSize;
-	else
-		*y = WIDGET_Y(win);
-
-	if (west)
-		*x = WIDGET_X(win);
-	else if (east)
-		*x = WIDGET_X(win) - 2*win->cborder + 2*border_width;
-	else if (center)
-		*x = WIDGET_X(win) + WIDGET_WIDTH(win) / 2
-		    - (WIDGET_WIDTH(win) - 2*border_width) / 2 - win->cborder;
-	else if (stat)
-		*x = WIDGET_X(win) - win->cborder + border_width;
-	else
-		*x = WIDGET_X(win);
+	if (win->throttle.bucket[class].throttled == 1)
+		debug("throttling %s requests from \"%s\"",
+		    throttle_name(class), win->name);
+}
 
-	*width = WIDGET_WIDTH(win) - 2*border_width;
-	if(undecorated) {
-		*height = WIDGET_HEIGHT(win) - 2 * border_width - buttonSize;
-	} else {
-		*height = WIDGET_HEIGHT(win) - 2 * border_width - buttonSize;
+/*
+ * Merge a ConfigureRequest into the one held back for the window.
+ */
+static void mergeconf(struct window *win, XConfigureRequestEvent *ep)
+{
+	XConfigureRequestEvent *pp = &win->pendingconf;
+
+	if (pp->value_mask == 0)
+		*pp = *ep;
+	else {
+		if (ep->value_mask & CWX)
+			pp->x = ep->x;
+		if (ep->value_mask & CWY)
+			pp->y = ep->y;
+		if (ep->value_mask & CWWidth)
+			pp->width = ep->width;
+		if (ep->value_mask & CWHeight)
+			pp->height = ep->height;
+		if (ep->value_mask & CWBorderWidth)
+			pp->border_width = ep->border_width;
+		if (ep->value_mask & CWSibling)
+			pp->above = ep->above;
+		if (ep->value_mask & CWStackMode)
+			pp->detail = ep->detail;
+		pp->value_mask |= ep->value_mask;
 	}
+	if (!LIST_MEMBER(&win->deferlink))
+		LIST_INSERT_TAIL(&deferredconf, &win->deferlink);
 }
 
-void delete_window(struct window *win)
+static void applyconf(struct window *, XConfigureRequestEvent *);
+
+/*
+ * Handle a ConfigureRequest.  Over the client's budget, requests are
+ * merged and the result applied once the budget allows.
+ */
+static void confevent(struct window *win, XConfigureRequestEvent *ep)
 {
-	if (!hints_delete(win)) {
-		clerr();
-		XKillClient(display, win->client);
-		sterr();
-	}
+	if (throttle(&win->throttle, THROTTLE_CONFIGURE)) {
+		throttled(win, THROTTLE_CONFIGURE);
+		mergeconf(win, ep);
+	} else if (win->pendingconf.value_mask != 0) {
+		mergeconf(win, ep);
+		LIST_REMOVE(&win->deferlink);
+		applyconf(win, &win->pendingconf);
+		win->pendingconf.value_mask = 0;
+	} else
+		applyconf(win, ep);
 }
 
 /*
  * See ICCCM 4.1.5 and EWMH "Implementation notes".
  */
-static void confevent(struct window *win, XConfigureRequestEvent *ep)
+static void applyconf(struct window *win, XConfigureRequestEvent *ep)
 {
-	XWindowAttributes attr;
-	int x;
-	int y;
-	int width;
-	int height;
+	struct extents e;
+	struct dim client;
+	struct dim frame;
+	int grav;
+
+	/*
+	 * The size hints must be current, but the fetch is charged like
+	 * any other; over budget, the hints on hand will do.
+	 */
+	if (win->dirtyprops != 0) {
+		if (throttle(&win->throttle, THROTTLE_PROPERTY))
+			throttled(win, THROTTLE_PROPERTY);
+		else
+			fetch_properties(win);
+	}
 
 	if (ep->value_mask & CWBorderWidth)
 		win->cborder = ep->border_width;
 
-	window_to_client_geom(win, &attr.x, &attr.y,
-	    &attr.width, &attr.height, win->undecorated);
-	attr.border_width = win->cborder;
+	window_extents(win, &e);
+	grav = hint_gravity(win->wmnormalhints);
+	frame_to_client(&e, grav, win->cborder, &win->widget.dim, &client);
 
 	if (ep->value_mask & CWX)
-		attr.x = ep->x;
+		client.x = ep->x;
 	if (ep->value_mask & CWY)
-		attr.y = ep->y;
+		client.y = ep->y;
 	if (ep->value_mask & CWWidth)
-		attr.width = ep->width;
+		client.width = ep->width;
 	if (ep->value_mask & CWHeight)
-		attr.height = ep->height;
+		client.height = ep->height;
 
 	/*
 	 * FIXME: handle stacking order
 	 */
 
-	client_to_window_geom(&attr, win->wmnormalhints,
-	    &x, &y, &width, &height, win->undecorated);
-	moveresize_window(win, x, y, width, height);
+	client_to_frame(&e, grav, win->cborder, &client, &frame);
+	moveresize_window(win, frame.x, frame.y, frame.width, frame.height);
+}
+
+/*
+ * Hold back a ClientMessage, replacing an earlier one of the same
+ * type.  Only the latest request of each kind matters.
+ */
+static void holdmsg(struct window *win, XClientMessageEvent *ep)
+{
+	int i;
+
+	for (i = 0; i < win->npendingmsg; i++)
+		if (win->pendingmsg[i].message_type == ep->message_type)
+			break;
+	if (i == win->npendingmsg) {
+		if (win->npendingmsg == NPENDINGMSG) {
+			/* out of room; the oldest type gives way */
+			memmove(&win->pendingmsg[0], &win->pendingmsg[1],
+			    (NPENDINGMSG - 1) * sizeof win->pendingmsg[0]);
+			i = NPENDINGMSG - 1;
+		} else
+			win->npendingmsg++;
+	}
+	win->pendingmsg[i] = *ep;
+	if (!LIST_MEMBER(&win->msglink))
+		LIST_INSERT_TAIL(&deferredmsg, &win->msglink);
+}
+
+/*
+ * Handle a ClientMessage.  Over the client's budget, messages wait
+ * in arrival order behind those already held back.
+ */
+static void msgevent(struct window *win, XClientMessageEvent *ep)
+{
+	if (win->npendingmsg == 0 &&
+	    !throttle(&win->throttle, THROTTLE_MESSAGE)) {
+		hints_clientmessage(win, ep);
+		return;
+	}
+	throttled(win, THROTTLE_MESSAGE);
+	holdmsg(win, ep);
+}
+
+/*
+ * Apply held back ClientMessages while the budget allows.
+ */
+static void runmsgs(struct window *win)
+{
+	XClientMessageEvent msg;
+
+	while (win->npendingmsg > 0 &&
+	    throttle_wait(&win->throttle, THROTTLE_MESSAGE) == 0) {
+		throttle(&win->throttle, THROTTLE_MESSAGE);
+		msg = win->pendingmsg[0];
+		win->npendingmsg--;
+		memmove(&win->pendingmsg[0], &win->pendingmsg[1],
+		    win->npendingmsg * sizeof win->pendingmsg[0]);
+		hints_clientmessage(win, &msg);
+	}
+	if (win->npendingmsg == 0)
+		LIST_REMOVE(&win->msglink);
 }
 
 static void prepare_repaint(struct widget *widget)
@@ -646,7 +753,7 @@ static void repaint(struct widget *widget)
 	int bw = border_width;
 	XftDraw *xftdraw;
 	xftdraw =  XftDrawCreate(display, WIDGET_XWINDOW(win), win->widget.visual,win->widget.colormap);
-	XftDrawRect(xftdraw,&xftColor,0,0, WIDGET_WIDTH(win),WIDGET_HEIGHT(win));
+	fillrect(xftdraw, &xftColor, 0, 0, WIDGET_WIDTH(win), WIDGET_HEIGHT(win));
 	XftDrawDestroy(xftdraw);
    //}
 }
@@ -700,7 +807,7 @@ static void windowevent(struct widget *widget, XEvent *ep)
 		confevent(win, &ep->xconfigurerequest);
 		break;
 	case ClientMessage:
-		hints_clientmessage(win, &ep->xclient);
+		msgevent(win, &ep->xclient);
 		break;
 	case PropertyNotify:
 		hints_propertynotify(win, &ep->xproperty);
@@ -727,30 +834,40 @@ static void windowevent(struct widget *widget, XEvent *ep)
 	}
 }
 
-void *xmalloc(size_t size)
+/*
+ * Read a UTF8_STRING property such as _NET_WM_NAME, or NULL if the
+ * client did not set one.  The result is freed with FREE().
+ */
+static char *getutf8property(Window w, Atom property)
 {
-	void *p;
-	while ((p = malloc(size)) == NULL && size != 0) {
-		printf("out of memory");
-		sleep(1);
-	}
-	return p;
-}
+	Atom type;
+	int format;
+	unsigned long n, after;
+	unsigned char *p = NULL;
+	char *s = NULL;
 
-char *xstrdup(const char *s)
-{
-	size_t n = strlen(s) + 1;
-	return memcpy(xmalloc(n), s, n);
+	if (XGetWindowProperty(display, w, property, 0, 1024, False,
+	    UTF8_STRING, &type, &format, &n, &after, &p) != Success)
+		return NULL;
+	if (type == UTF8_STRING && format == 8 && n > 0)
+		s = STRDUP((char *)p);
+	if (p != NULL)
+		XFree(p);
+	return s;
 }
 
+/*
+ * Convert a text property of any encoding to UTF-8.  The result is
+ * freed with FREE().
+ */
 char *decodetextproperty(XTextProperty *p)
 {
 	char *s = NULL;
 	char **v = NULL;
 	int n = 0;
-	XmbTextPropertyToTextList(display, p, &v, &n);
+	Xutf8TextPropertyToTextList(display, p, &v, &n);
 	if (n > 0)
-		s = xstrdup(v[0]);
+		s = STRDUP(v[0]);
 	if (v != NULL)
 		XFreeStringList(v);
 	return s;
@@ -759,170 +876,59 @@ char *decodetextproperty(XTextProperty *p)
 
 
 
-void low_limit_size(int *width, int *height, int undecorated)
+/*
+ * The one place that decides what the decoration of a frame is.
+ */
+static void decoration(int undecorated, struct extents *ep)
 {
-	*width = MAX(*width, 2 * border_width + 1);
-	if(undecorated) {
-		*height = MAX(*height, 2 * border_width + 1);
-	} else {
-		*height = MAX(*height, 2 * border_width + button_size + 1);
-	}
+	get_extents(ep, border_width, undecorated ? 0 : button_size);
 }
 
-static int top_panel_height(Window window)
+void window_extents(struct window *win, struct extents *ep)
 {
-    int height = 0;     // maximum height
-    Window w;
-    Window* children;
-    unsigned int n_children;
-
-    XQueryTree(display, window, &w, &w, &children, &n_children);
-
-    // looks for each one of the children
-    int i;
-    for(i=0; i<n_children; i++)
-    {
-
-        // this is the property we're looking for
-        Atom strut = XInternAtom(display, "_NET_WM_STRUT_PARTIAL", 
-                False);
-        Atom type_return;
-        int actual_type;
-        unsigned long nitems, bytes;
-        unsigned char* data = NULL;
-
-        // load window attributes (we only want to know about the
-        //                         windows where y = 0)
-        XWindowAttributes xwa;
-        XGetWindowAttributes(display, window, &xwa);
-
-        // load the property _NET_WM_STRUT_PARTIAL
-        int s = XGetWindowProperty(display, window, strut, 0, LONG_MAX, 
-                False, 
-                XA_CARDINAL, &type_return, &actual_type,
-                &nitems, &bytes, (unsigned char**)&data);
-        if(s == Success)
-        {
-            Atom *state = (Atom *) data;
-            // state[2] contains the "dock height"
-            if(nitems > 0 && state[3])
-                if(state[3] > height)
-                    height = state[3];
-        }
-        // recursively, traverse the tree of all children of children
-        int children_max_height = top_panel_height(children[i]);
-        if(children_max_height > height)
-            height = children_max_height;
-    }
+	decoration(win->undecorated, ep);
+}
 
-    return height;
+/*
+ * The tallest top strut (_NET_WM_STRUT_PARTIAL) set on any window
+ * below the given one.
+ */
+static int top_panel_height(Window window)
+{
+	static Atom strut = None;
+	Window dummy, *children;
+	unsigned int i, n;
+	unsigned long *data;
+	unsigned long nitems;
+	int height = 0;
+
+	if (strut == None)
+		strut = XInternAtom(display, "_NET_WM_STRUT_PARTIAL", False);
+	if (!XQueryTree(display, window, &dummy, &dummy, &children, &n))
+		return 0;
+	for (i = 0; i < n; i++) {
+		/* left, right, top, bottom, ... */
+		data = getprop(children[i], strut, XA_CARDINAL, 32, &nitems);
+		if (data != NULL) {
+			if (nitems > 2)
+				height = MAX(height, (int)data[2]);
+			XFree(data);
+		}
+		height = MAX(height, top_panel_height(children[i]));
+	}
+	if (children != NULL)
+		XFree(children);
+	return height;
 }
 
 void window_calcsize(struct window *win, int width, int height,
     int *rwidth, int *rheight, int *rxdim, int *rydim)
 {
-	int decwidth = 2 * border_width;
-	int decheight = 2 * border_width + button_size;
-	if(win->undecorated) {
-		decheight = 2 * border_width;
-	}
-	int havemin = 0;
-	int minwidth = 0;
-	int minheight = 0;
-	int wmminwidth = 0;
-	int wmminheight = 0;
-
-	low_limit_size(&width, &height, win->undecorated);
-	low_limit_size(&wmminwidth, &wmminheight, win->undecorated);
-
-	width -= decwidth;
-	height -= decheight;
-
-	if (win->wmnormalhints->flags & PMaxSize) {
-		width = MIN(width, win->wmnormalhints->max_width);
-		height = MIN(height, win->wmnormalhints->max_height);
-	}
+	struct extents e;
 
-	havemin = 0;
-	if (win->wmnormalhints->flags & PMinSize) {
-		minwidth = win->wmnormalhints->min_width;
-		minheight = win->wmnormalhints->min_height;
-		havemin = 1;
-	} else if (win->wmnormalhints->flags & PBaseSize) {
-		minwidth = win->wmnormalhints->base_width;
-		minheight = win->wmnormalhints->base_height;
-		havemin = 1;
-	}
-	if (havemin) {
-		width = MAX(width, minwidth);
-		height = MAX(height, minheight);
-	}
-
-	if (win->wmnormalhints->flags & PResizeInc) {
-		if (win->wmnormalhints->width_inc != 0) {
-			int wb;
-			if (win->wmnormalhints->flags & PBaseSize)
-				wb = win->wmnormalhints->base_width;
-			else if (win->wmnormalhints->flags & PMinSize)
-				wb = win->wmnormalhints->min_width;
-			else
-				wb = 0;
-			width -= wb;
-			width -= width % win->wmnormalhints->width_inc;
-			if (havemin)
-				width = MAX(width, minwidth - wb);
-			while (wb + width + decwidth < wmminwidth)
-				width += win->wmnormalhints->width_inc;
-			if (rxdim != NULL)
-				*rxdim = width / win->wmnormalhints->width_inc;
-			width += wb;
-		} else if (rxdim != NULL)
-			*rxdim = width;
-		if (win->wmnormalhints->height_inc != 0) {
-			int hb;
-			if (win->wmnormalhints->flags & PBaseSize)
-				hb = win->wmnormalhints->base_height;
-			else if (win->wmnormalhints->flags & PMinSize)
-				hb = win->wmnormalhints->min_height;
-			else
-				hb = 0;
-			height -= hb;
-			height -= height % win->wmnormalhints->height_inc;
-			if (havemin)
-				height = MAX(height, minheight - hb);
-			while (hb + height + decheight < wmminheight)
-				height += win->wmnormalhints->height_inc;
-			if (rydim != NULL)
-				*rydim =
-				    height / win->wmnormalhints->height_inc;
-			height += hb;
-		} else if (rydim != NULL)
-			*rydim = height;
-	} else {
-		if (rxdim != NULL)
-			*rxdim = width;
-		if (rydim != NULL)
-			*rydim = height;
-	}
-
-	if(panelheight == 0) {
-             panelheight = top_panel_height(root);
-        }
-	error("panelheight : %d",panelheight);
-	width += 2 * border_width;
-
-	if(!win->undecorated) {
-		height += 2 * border_width + button_size;
-	} else {
-		height += 2 * border_width;
-	}
-
-	height -= panelheight;
-
-	if (rwidth != NULL)
-		*rwidth = width;
-	if (rheight != NULL)
-		*rheight = height;
+	window_extents(win, &e);
+	frame_calcsize(&e, win->wmnormalhints, width, height,
+	    rwidth, rheight, rxdim, rydim);
 }
 
 static void setgrav(Window xwin, int grav)
@@ -947,6 +953,9 @@ void maximize_window(struct window *win)
 		    DisplayWidth(display, screen),
 		    DisplayHeight(display, screen),
 		    &rwidth, &rheight, NULL, NULL);
+		if (panelheight == 0)
+			panelheight = top_panel_height(root);
+		rheight -= panelheight;
 		x = 0;//((DisplayWidth(display, screen) - rwidth) / 2);
 		y = 0;//((DisplayHeight(display, screen) - rheight) / 2);
 		moveresize_window(win, x, y, rwidth,rheight);
@@ -954,12 +963,156 @@ void maximize_window(struct window *win)
 	}
 }
 
+/*
+ * What the frame itself listens to, and the grabs for Meta-dragging.
+ */
+static void setupframe(struct window *win)
+{
+	grabbutton(display, Button1, Mod1Mask,
+	    WIDGET_XWINDOW(win), False,
+	    ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
+	    GrabModeAsync, GrabModeAsync, None, movecurs);
+	grabbutton(display, Button1, Mod1Mask | ControlMask,
+	    WIDGET_XWINDOW(win), False,
+	    ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
+	    GrabModeAsync, GrabModeAsync, None, movecurs);
+
+	XSelectInput(display, WIDGET_XWINDOW(win),
+	    ExposureMask | SubstructureRedirectMask | SubstructureNotifyMask);
+}
+
+/*
+ * The buttons and title, which go below the client in the frame.
+ */
+static void decorate(struct window *win)
+{
+	int width = WIDGET_WIDTH(win);
+
+	if (win->undecorated)
+		return;
+
+	win->deletebtn = create_button(win,
+	    width - border_width - button_size,
+	    border_width, button_size, button_size);
+	setgrav(WIDGET_XWINDOW(win->deletebtn), NorthEastGravity);
+	set_button_handler(win->deletebtn, delete_window);
+	set_draw_handler(win->deletebtn, closeDraw);
+
+	win->unmapbtn = create_button(win,
+	    border_width,
+	    border_width, button_size, button_size);
+	setgrav(WIDGET_XWINDOW(win->unmapbtn), NorthWestGravity);
+	set_button_handler(win->unmapbtn, user_unmap_window);
+	set_draw_handler(win->unmapbtn, unmapDraw);
+
+	win->title = create_title(win,
+	    border_width+button_size, border_width,
+	    width - 2 * border_width - NBTN * button_size, button_size);
+}
+
+/*
+ * The resize handles, which go above the client.
+ */
+static void addresizers(struct window *win)
+{
+	win->rsz_northwest = create_resizer(win, NORTHWEST);
+	win->rsz_north = create_resizer(win, NORTH);
+	win->rsz_northeast = create_resizer(win, NORTHEAST);
+	win->rsz_west = create_resizer(win, WEST);
+	win->rsz_east = create_resizer(win, EAST);
+	win->rsz_southwest = create_resizer(win, SOUTHWEST);
+	win->rsz_south = create_resizer(win, SOUTH);
+	win->rsz_southeast = create_resizer(win, SOUTHEAST);
+}
+
+static void undecorate(struct window *win)
+{
+	if (!win->undecorated) {
+		destroy_title(win->title);
+		destroy_button(win->deletebtn);
+		destroy_button(win->unmapbtn);
+		win->title = NULL;
+		win->deletebtn = NULL;
+		win->unmapbtn = NULL;
+	}
+
+	destroy_resizer(win->rsz_northwest);
+	destroy_resizer(win->rsz_north);
+	destroy_resizer(win->rsz_northeast);
+	destroy_resizer(win->rsz_west);
+	destroy_resizer(win->rsz_east);
+	destroy_resizer(win->rsz_southwest);
+	destroy_resizer(win->rsz_south);
+	destroy_resizer(win->rsz_southeast);
+}
+
+/*
+ * Move the client into a new frame on the visual now in use, as when
+ * a compositor starts or stops.  A window's visual can't be changed,
+ * but the client and everything we know about it stay as they are.
+ */
+static void redecorate_window(struct window *win)
+{
+	struct extents e;
+	Window old;
+
+#if CONFIG_THUMBNAILS
+	destroy_thumbnail(win);
+#endif
+	undecorate(win);
+
+	/* no UnmapNotify for the reparent, and no MapRequest after it */
+	XSelectInput(display, WIDGET_XWINDOW(win), NoEventMask);
+	old = replace_widget_window(&win->widget, root, InputOutput);
+	decorate(win);
+	window_extents(win, &e);
+	clerr();
+	XReparentWindow(display, win->client, WIDGET_XWINDOW(win),
+	    e.left, e.top);
+	XLowerWindow(display, win->client);
+	sterr();
+	addresizers(win);
+	setupframe(win);
+	XDestroyWindow(display, old);
+
+	stackmoved(win);
+	repaint_window(win);
+}
+
+void redecorate_all_windows(void)
+{
+	struct window **wins;
+	int i, n;
+
+	get_window_stack(&wins, &n);
+	begin_transaction();
+	for (i = 0; i < n; i++)
+		redecorate_window(wins[i]);
+	commit_transaction();
+	FREE(wins);
+}
+
 struct window *manage_window(Window client, int wmstart)
+{
+	struct window *win;
+
+	XC_ENTER(XC_MANAGE);
+	TRACE_BEGIN(TR_MANAGE, client);
+	win = manage(client, wmstart);
+	TRACE_END(TR_MANAGE);
+	XC_LEAVE();
+	return win;
+}
+
+static struct window *manage(Window client, int wmstart)
 {
 	struct window *win;
 	XWindowAttributes attr;
 	XSizeHints *sz;
 	XWMHints *wmhints;
+	struct extents e;
+	struct dim cdim;
+	struct dim fdim;
 	long state;
 	long dummy;
 	int x, y, width, height;
@@ -1037,12 +1190,24 @@ struct window *manage_window(Window client, int wmstart)
      XFree(h);
    }
 
-	client_to_window_geom(&attr, sz, &x, &y, &width, &height, undecorated);
-	low_limit_size(&width, &height, undecorated);
+	decoration(undecorated, &e);
+	cdim.x = attr.x;
+	cdim.y = attr.y;
+	cdim.width = attr.width;
+	cdim.height = attr.height;
+	client_to_frame(&e, hint_gravity(sz), attr.border_width,
+	    &cdim, &fdim);
+	limit_frame_size(&e, &fdim.width, &fdim.height);
+	x = fdim.x;
+	y = fdim.y;
+	width = fdim.width;
+	height = fdim.height;
 	if (!wmstart && ~sz->flags & USPosition && ~sz->flags & PPosition)
 		smartpos(width, height, &x, &y);
 	XFree(sz);
 
+	begin_transaction();
+
 	win = MALLOC(sizeof (struct window));
 	create_widget(&win->widget, WIDGET_WINDOW,
 	    root, InputOutput, x, y, width, height, False);
@@ -1053,6 +1218,15 @@ struct window *manage_window(Window client, int wmstart)
 
 	win->name = NULL;
 	win->iconname = NULL;
+	win->wmclass = NULL;
+	win->icon = NULL;
+	win->dirtyprops = 0;
+	LIST_INIT(&win->dirtylink);
+	init_throttle(&win->throttle);
+	win->pendingconf.value_mask = 0;
+	LIST_INIT(&win->deferlink);
+	win->npendingmsg = 0;
+	LIST_INIT(&win->msglink);
 	win->title = NULL;
 	win->deletebtn = NULL;
 	win->unmapbtn = NULL;
@@ -1092,55 +1266,20 @@ struct window *manage_window(Window client, int wmstart)
 
 	LIST_INSERT_HEAD(win->layer, &win->layerlink);
 	nwindows++;
-	needrestack = 1;
+	stackmoved(win);
 
 	save_widget_context(&win->widget, client);
-
-	grabbutton(display, Button1, Mod1Mask,
-	    WIDGET_XWINDOW(win), False,
-	    ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-	    GrabModeAsync, GrabModeAsync, None, movecurs);
-	grabbutton(display, Button1, Mod1Mask | ControlMask,
-	    WIDGET_XWINDOW(win), False,
-	    ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
-	    GrabModeAsync, GrabModeAsync, None, movecurs);
-
-	XSelectInput(display, WIDGET_XWINDOW(win),
-	    ExposureMask | SubstructureRedirectMask | SubstructureNotifyMask);
+	setupframe(win);
 
 	win->widget.event = windowevent;
 	win->widget.prepare_repaint = prepare_repaint;
 	win->widget.repaint = repaint;
 
-if(!win->undecorated){
-	win->deletebtn = create_button(win,
-	    width - border_width - button_size,
-	    border_width, button_size, button_size);
-	setgrav(WIDGET_XWINDOW(win->deletebtn), NorthEastGravity);
-	set_button_handler(win->deletebtn, delete_window);
-	set_draw_handler(win->deletebtn, closeDraw);
-
-	win->unmapbtn = create_button(win,
-	    border_width,
-	    border_width, button_size, button_size);
-	setgrav(WIDGET_XWINDOW(win->unmapbtn), NorthWestGravity);
-	set_button_handler(win->unmapbtn, user_unmap_window);
-	set_draw_handler(win->unmapbtn, unmapDraw);
-
-	win->title = create_title(win,
-	    border_width+button_size, border_width,
-	    width - 2 * border_width - NBTN * button_size, button_size);
-}
+	decorate(win);
 	clerr();
 	XAddToSaveSet(display, client);
 	XSetWindowBorderWidth(display, client, 0);
-	if(!win->undecorated) {
-	   XReparentWindow(display, client, WIDGET_XWINDOW(win),
-	      border_width, border_width + button_size);
-	} else {
-	   XReparentWindow(display, client, WIDGET_XWINDOW(win),
-	      border_width,border_width);
-	}
+	XReparentWindow(display, client, WIDGET_XWINDOW(win), e.left, e.top);
 	XLowerWindow(display, client);
 	XSelectInput(display, client, PropertyChangeMask);
 	setgrav(client, NorthWestGravity);
@@ -1148,17 +1287,11 @@ if(!win->undecorated){
 	    ButtonPressMask, GrabModeSync, GrabModeSync, None, None);
 	sterr();
 
-	win->rsz_northwest = create_resizer(win, NORTHWEST);
-	win->rsz_north = create_resizer(win, NORTH);
-	win->rsz_northeast = create_resizer(win, NORTHEAST);
-	win->rsz_west = create_resizer(win, WEST);
-	win->rsz_east = create_resizer(win, EAST);
-	win->rsz_southwest = create_resizer(win, SOUTHWEST);
-	win->rsz_south = create_resizer(win, SOUTH);
-	win->rsz_southeast = create_resizer(win, SOUTHEAST);
+	addresizers(win);
 
 	fetch_window_name(win);
 	fetch_icon_name(win);
+	fetch_wm_class(win);
 	fetch_wm_hints(win);
 	fetch_wm_normal_hints(win);
 	fetch_wm_transient_for_hint(win);
@@ -1184,9 +1317,7 @@ if(!win->undecorated){
 	if (state == IconicState)
 		unmap_window(win);
 	else
-		set_active_window(win);
-
-	XSync(display, False);
+		activate_later(win);
 
 	debug("manage \"%s\" (Window=0x%x)", win->name, (int)win->client);
 
@@ -1195,6 +1326,7 @@ if(!win->undecorated){
 		sterr();
 		debug("Oops, client window disappeared in manage_window()");
 		unmanage_window(win, 1);
+		commit_transaction();
 		return NULL;
 	}
 	sterr();
@@ -1205,9 +1337,11 @@ if(!win->undecorated){
     put_window_group_below(win);
     if(win->dock) {
     	unmanage_window(win, 0);
+	win = NULL;
     }
   }
 
+	commit_transaction();
 	return win;
 }
 
@@ -1303,14 +1437,15 @@ void fetch_wm_hints(struct window *win)
 void fetch_window_name(struct window *win)
 {
 	if (win->name != NULL) {
-		XFree(win->name);
+		FREE(win->name);
 		win->name = NULL;
 	}
 	clerr();
   // NOTE: https://github.com/herbstluftwm/herbstluftwm/issues/64
 	/* XFetchName(display, win->client, &win->name); */
   XTextProperty p;
-  if (XGetWMName(display, win->client, &p) != 0) {
+  win->name = getutf8property(win->client, NET_WM_NAME);
+  if (win->name == NULL && XGetWMName(display, win->client, &p) != 0) {
     win->name = decodetextproperty(&p);
     if (p.value != NULL)
       XFree(p.value);
@@ -1322,13 +1457,274 @@ void fetch_window_name(struct window *win)
      	REPAINT(win->title);
     }
   }
+  if (win->menuitem != NULL)
+    update_menu_label(win);
 }
 
-void fetch_icon_name(struct window *win)
+/*
+ * Label the window's menu item with its icon name, or with its
+ * title if it has none.  The label is only updated on property
+ * changes, so showing the menu needs no round trips.
+ */
+static void update_menu_label(struct window *win)
 {
+	const char *label;
+
+	if (win->iconname != NULL && win->iconname[0] != '\0')
+		label = win->iconname;
+	else if (win->name != NULL)
+		label = win->name;
+	else
+		label = "";
+
 	if (win->menuitem == NULL)
-		win->menuitem = create_menuitem(winmenu, "",
+		win->menuitem = create_menuitem(winmenu, label,
 		    selectfrommenu, win);
+	else
+		rename_menuitem(win->menuitem, label);
+	index_window(win);
+}
+
+/*
+ * Let the window menu filter on the title, icon name and class.
+ */
+static void index_window(struct window *win)
+{
+	char *text;
+
+	if (win->menuitem == NULL)
+		return;
+
+	text = MALLOC(strlen(win->name != NULL ? win->name : "") +
+	    strlen(win->iconname != NULL ? win->iconname : "") +
+	    strlen(win->wmclass != NULL ? win->wmclass : "") + 3);
+	sprintf(text, "%s\n%s\n%s",
+	    win->name != NULL ? win->name : "",
+	    win->iconname != NULL ? win->iconname : "",
+	    win->wmclass != NULL ? win->wmclass : "");
+	index_menuitem(win->menuitem, text);
+	FREE(text);
+}
+
+void fetch_icon_name(struct window *win)
+{
+	XTextProperty p;
+
+	if (win->iconname != NULL) {
+		FREE(win->iconname);
+		win->iconname = NULL;
+	}
+	clerr();
+	win->iconname = getutf8property(win->client, NET_WM_ICON_NAME);
+	if (win->iconname == NULL &&
+	    XGetWMIconName(display, win->client, &p) != 0) {
+		win->iconname = decodetextproperty(&p);
+		if (p.value != NULL)
+			XFree(p.value);
+	}
+	sterr();
+	update_menu_label(win);
+}
+
+void fetch_wm_class(struct window *win)
+{
+	XClassHint ch;
+
+	if (win->wmclass != NULL) {
+		FREE(win->wmclass);
+		win->wmclass = NULL;
+	}
+	ch.res_name = NULL;
+	ch.res_class = NULL;
+	clerr();
+	if (XGetClassHint(display, win->client, &ch)) {
+		win->wmclass = MALLOC(strlen(ch.res_name) +
+		    strlen(ch.res_class) + 2);
+		sprintf(win->wmclass, "%s %s", ch.res_name, ch.res_class);
+		XFree(ch.res_name);
+		XFree(ch.res_class);
+	}
+	sterr();
+	index_window(win);
+}
+
+/*
+ * Fetch the icon at the size it is drawn at in titles and menus.
+ * The new icon is looked up before the old one is released, so an
+ * unchanged icon stays cached.
+ */
+void fetch_wm_icon(struct window *win)
+{
+	struct icon *icon;
+
+	icon = fetch_icon(win->client, xftfont->ascent + xftfont->descent);
+	release_icon(win->icon);
+	win->icon = icon;
+	if (win->menuitem != NULL)
+		set_menuitem_icon(win->menuitem, icon);
+	if (!win->undecorated && win->title != NULL)
+		REPAINT(win->title);
+}
+
+/*
+ * Note that a property changed.  It is fetched with the others in
+ * fetch_dirty_properties(), so a property that a client rewrites many
+ * times within one batch of events is only fetched once.
+ */
+void mark_property_dirty(struct window *win, unsigned props)
+{
+	if ((win->dirtyprops & props) == props)
+		propstats.hits++;
+	else
+		propstats.misses++;
+	win->dirtyprops |= props;
+	if (!LIST_MEMBER(&win->dirtylink))
+		LIST_INSERT_TAIL(&dirtywindows, &win->dirtylink);
+}
+
+/*
+ * Return how often property fetches were saved by merging changes;
+ * entries is the number of windows with fetches pending.
+ */
+const struct cachestats *property_stats(void)
+{
+	LIST *lp;
+
+	propstats.entries = 0;
+	LIST_FOREACH(lp, &dirtywindows)
+		propstats.entries++;
+	return &propstats;
+}
+
+int window_count(void)
+{
+	return nwindows;
+}
+
+static void fetch_properties(struct window *win)
+{
+	unsigned props = win->dirtyprops;
+	XC_ENTER(XC_PROPERTY);
+	TRACE_BEGIN(TR_PROPERTY, props);
+
+	win->dirtyprops = 0;
+	LIST_REMOVE(&win->dirtylink);
+
+	if (props & PROP_NAME)
+		fetch_window_name(win);
+	if (props & PROP_ICONNAME)
+		fetch_icon_name(win);
+	if (props & PROP_CLASS)
+		fetch_wm_class(win);
+	if (props & PROP_HINTS)
+		fetch_wm_hints(win);
+	if (props & PROP_NORMALHINTS)
+		fetch_wm_normal_hints(win);
+	if (props & PROP_TRANSIENTFOR)
+		fetch_wm_transient_for_hint(win);
+	if (props & PROP_ICON)
+		fetch_wm_icon(win);
+	TRACE_END(TR_PROPERTY);
+	XC_LEAVE();
+}
+
+/*
+ * Fetch all dirty properties.  Each fetch takes its own short grab,
+ * so the server is never held across the batch, and icons are scaled
+ * with it released.  Windows over their budget are left for a later
+ * batch.
+ */
+void fetch_dirty_properties(void)
+{
+	struct window *win;
+	LIST skipped;
+	LIST *lp;
+
+	LIST_INIT(&skipped);
+	while ((lp = LIST_HEAD(&dirtywindows)) != NULL) {
+		win = LIST_ITEM(lp, struct window, dirtylink);
+		LIST_REMOVE(lp);
+		if (throttle(&win->throttle, THROTTLE_PROPERTY)) {
+			throttled(win, THROTTLE_PROPERTY);
+			LIST_INSERT_TAIL(&skipped, lp);
+			continue;
+		}
+		fetch_properties(win);
+	}
+
+	while ((lp = LIST_HEAD(&skipped)) != NULL) {
+		LIST_REMOVE(lp);
+		LIST_INSERT_TAIL(&dirtywindows, lp);
+	}
+}
+
+static void wakeup(void *arg)
+{
+}
+
+/*
+ * Return the number of ms until throttled work is allowed to run,
+ * or -1 if there is none.
+ */
+static int deferred_timeout(void)
+{
+	struct window *win;
+	long t, timeout = -1;
+	LIST *lp;
+
+	LIST_FOREACH(lp, &deferredconf) {
+		win = LIST_ITEM(lp, struct window, deferlink);
+		t = throttle_wait(&win->throttle, THROTTLE_CONFIGURE);
+		if (timeout == -1 || t < timeout)
+			timeout = t;
+	}
+	LIST_FOREACH(lp, &deferredmsg) {
+		win = LIST_ITEM(lp, struct window, msglink);
+		t = throttle_wait(&win->throttle, THROTTLE_MESSAGE);
+		if (timeout == -1 || t < timeout)
+			timeout = t;
+	}
+	LIST_FOREACH(lp, &dirtywindows) {
+		win = LIST_ITEM(lp, struct window, dirtylink);
+		t = throttle_wait(&win->throttle, THROTTLE_PROPERTY);
+		if (timeout == -1 || t < timeout)
+			timeout = t;
+	}
+	return timeout;
+}
+
+/*
+ * Apply held back ConfigureRequests and ClientMessages that the
+ * budget now allows.
+ */
+void run_deferred(void)
+{
+	struct window *win;
+	LIST *lp, *next;
+	int timeout;
+
+	for (lp = LIST_HEAD(&deferredconf); lp != NULL; lp = next) {
+		next = lp->ln_next == &deferredconf ? NULL : lp->ln_next;
+		win = LIST_ITEM(lp, struct window, deferlink);
+		if (throttle_wait(&win->throttle, THROTTLE_CONFIGURE) > 0)
+			continue;
+		throttle(&win->throttle, THROTTLE_CONFIGURE);
+		LIST_REMOVE(&win->deferlink);
+		applyconf(win, &win->pendingconf);
+		win->pendingconf.value_mask = 0;
+	}
+	for (lp = LIST_HEAD(&deferredmsg); lp != NULL; lp = next) {
+		next = lp->ln_next == &deferredmsg ? NULL : lp->ln_next;
+		runmsgs(LIST_ITEM(lp, struct window, msglink));
+	}
+
+	/* wake up when the rest is due; the main loop does the work */
+	if (defertimer.fn == NULL)
+		init_timer(&defertimer, wakeup, NULL);
+	if ((timeout = deferred_timeout()) >= 0)
+		start_timer(&defertimer, timeout);
+	else
+		stop_timer(&defertimer);
 }
 
 static void selectfrommenu(void *ptr)
@@ -1375,25 +1771,21 @@ static void fitwin(struct window *win)
 
 void moveresize_window(struct window *win, int x, int y, int width, int height)
 {
+	struct extents e;
 	int move;
 	int resize;
+	XC_ENTER(XC_MOVERESIZE);
 	//error("x %d; y %d; w %d; h %d; ",x,y,width,height);
-	low_limit_size(&width, &height, win->undecorated);
+	window_extents(win, &e);
+	limit_frame_size(&e, &width, &height);
 
 	move = x != WIDGET_X(win) || y != WIDGET_Y(win);
 	resize = width != WIDGET_WIDTH(win) || height != WIDGET_HEIGHT(win);
 
 	if (resize) {
 		clerr();
-		if(!win->undecorated) {
-		   XResizeWindow(display, win->client,
-		      width - 2 * border_width,
-		      height - 2 * border_width - button_size);
-		} else {
-		   XResizeWindow(display, win->client,
-		      width - 2 * border_width,
-		      height - 2 * border_width);
-		}
+		XResizeWindow(display, win->client,
+		    width - EXTENTS_WIDTH(&e), height - EXTENTS_HEIGHT(&e));
 		sterr();
 	}
 
@@ -1418,6 +1810,7 @@ void moveresize_window(struct window *win, int x, int y, int width, int height)
 		hints_resize(win);
 	else if (move && resize)
 		hints_moveresize(win);
+	XC_LEAVE();
 	//error("move resize end");
 }
 
@@ -1454,15 +1847,23 @@ void resize_window(struct window *win, int width, int height)
 
 void unmanage_window(struct window *win, int clientquit)
 {
-	int x, y, width, height;
+	struct extents e;
+	struct dim cdim;
 	int wasactive;
+	int i;
 
+	XC_ENTER(XC_UNMANAGE);
+	TRACE_BEGIN(TR_UNMANAGE, win->client);
 	debug("unmanage \"%s\" (Window=0x%x)",win->name, (int)win->client);
 
+	begin_transaction();
+
 	wasactive = win == active;
 
 	if (wasactive)
 		set_active_window(NULL);
+	if (win == txwindow)
+		txwindow = NULL;
 
 	if (WIDGET_MAPPED(win))
 		unmap_widget(&win->widget);
@@ -1476,14 +1877,28 @@ void unmanage_window(struct window *win, int clientquit)
 
 	if (win->menuitem != NULL)
 		destroy_menuitem(win->menuitem);
+	release_icon(win->icon);
+	LIST_REMOVE(&win->dirtylink);
+	LIST_REMOVE(&win->deferlink);
+	LIST_REMOVE(&win->msglink);
+	for (i = 0; i < NTHROTTLE; i++)
+		if (win->throttle.bucket[i].throttled > 0)
+			debug("\"%s\" was throttled %lu times (%s)",
+			    win->name, win->throttle.bucket[i].throttled,
+			    throttle_name(i));
+#if CONFIG_THUMBNAILS
+	destroy_thumbnail(win);
+#endif
 	LIST_REMOVE(&win->layerlink);
 	nwindows--;
 
-	window_to_client_geom(win, &x, &y, &width, &height, win->undecorated);
+	window_extents(win, &e);
+	frame_to_client(&e, hint_gravity(win->wmnormalhints), win->cborder,
+	    &win->widget.dim, &cdim);
 	delete_widget_context(win->client);
 
 	clerr();
-	XReparentWindow(display, win->client, root, x, y);
+	XReparentWindow(display, win->client, root, cdim.x, cdim.y);
 	if (!clientquit)
 		XMapWindow(display, win->client);
 	ungrabbutton(display, AnyButton, AnyModifier, win->client);
@@ -1494,20 +1909,7 @@ void unmanage_window(struct window *win, int clientquit)
 	XRemoveFromSaveSet(display, win->client);
 	sterr();
 
-  if (!win->undecorated) {
-    destroy_title(win->title);
-    destroy_button(win->deletebtn);
-    destroy_button(win->unmapbtn);
-  }
-
-	destroy_resizer(win->rsz_northwest);
-	destroy_resizer(win->rsz_north);
-	destroy_resizer(win->rsz_northeast);
-	destroy_resizer(win->rsz_west);
-	destroy_resizer(win->rsz_east);
-	destroy_resizer(win->rsz_southwest);
-	destroy_resizer(win->rsz_south);
-	destroy_resizer(win->rsz_southeast);
+	undecorate(win);
 
 	if (win->wmhints != NULL)
 		XFree(win->wmhints);
@@ -1515,21 +1917,21 @@ void unmanage_window(struct window *win, int clientquit)
 	XFree(win->wmnormalhints);
 
 	destroy_widget(&win->widget);
-	if (win->name != NULL)
-		XFree(win->name);
-	if (win->iconname != NULL)
-		XFree(win->iconname);
+	FREE(win->name);
+	FREE(win->iconname);
+	if (win->wmclass != NULL)
+		FREE(win->wmclass);
 	FREE(win);
 
-	XSync(display, False);
-
 	/*
 	 * Teardown finished
 	 */
 
 	if (wasactive)
-		set_active_window(topmost_window());
-
+		activate_later(NULL);
+	commit_transaction();
+	TRACE_END(TR_UNMANAGE);
+	XC_LEAVE();
 }
 
 void repaint_window(struct window *win)
@@ -1701,6 +2103,7 @@ void set_active_window(struct window *win)
 	if (win == active)
 		return;
 
+	XC_ENTER(XC_ACTIVATE);
 	old = active;
 	active = win;
 
@@ -1733,6 +2136,8 @@ void set_active_window(struct window *win)
 	}
 
 	hints_activate(win);
+	update_clock();
+	XC_LEAVE();
 }
 
 static void make_window_visible(struct window *win)
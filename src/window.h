@@ -26,16 +26,32 @@
 #include <X11/Xlib.h>
 
 #include "list.h"
+#include "throttle.h"
 #include "widget.h"
 
 struct button;
+struct extents;
+struct icon;
 struct menuitem;
 struct resizer;
 struct title;
 
+/* Client properties, for mark_property_dirty() */
+#define PROP_NAME		(1 << 0)
+#define PROP_ICONNAME		(1 << 1)
+#define PROP_CLASS		(1 << 2)
+#define PROP_HINTS		(1 << 3)
+#define PROP_NORMALHINTS	(1 << 4)
+#define PROP_TRANSIENTFOR	(1 << 5)
+#define PROP_ICON		(1 << 6)
+
+/* Distinct message types held back per client over its budget */
+#define NPENDINGMSG		8
+
 struct window { struct widget widget;
 	char *name;
 	char *iconname;
+	char *wmclass;		/* "name class" from WM_CLASS */
 
 	struct title *title;
 
@@ -47,6 +63,8 @@ struct window { struct widget widget;
 
 	struct menuitem *menuitem;
 
+	struct icon *icon;	/* from _NET_WM_ICON */
+
 	struct color *color;
 
 	Window client;
@@ -74,6 +92,21 @@ struct window { struct widget widget;
 
 	LIST *layer;
 	LIST layerlink;
+	int restack;	/* moved in its layer since the last restack */
+
+	/* Properties changed but not yet fetched */
+	unsigned dirtyprops;
+	LIST dirtylink;
+
+	/* Rate limiting, and a merged ConfigureRequest over the limit */
+	struct throttle throttle;
+	XConfigureRequestEvent pendingconf;
+	LIST deferlink;
+
+	/* The latest ClientMessage of each type over the limit */
+	XClientMessageEvent pendingmsg[NPENDINGMSG];
+	int npendingmsg;
+	LIST msglink;
 
         Bool undecorated;
 	Bool dock;
@@ -90,9 +123,17 @@ int windows_are_related(struct window *, struct window *);
 int windows_are_transient_related(struct window *, struct window *);
 int windows_are_group_related(struct window *, struct window *);
 void window_calcsize(struct window *, int, int, int *, int *, int *, int *);
+void window_extents(struct window *, struct extents *);
 void delete_window(struct window *);
 void fetch_icon_name(struct window *);
 void fetch_window_name(struct window *);
+void fetch_wm_class(struct window *);
+void fetch_wm_icon(struct window *);
+void mark_property_dirty(struct window *, unsigned);
+void fetch_dirty_properties(void);
+const struct cachestats *property_stats(void);
+int window_count(void);
+void run_deferred(void);
 void fetch_wm_hints(struct window *);
 void fetch_wm_normal_hints(struct window *);
 void fetch_wm_transient_for_hint(struct window *);
@@ -112,6 +153,11 @@ void unmanage_window(struct window *, int);
 void unmap_window(struct window *);
 void user_unmap_window(struct window *);
 void restack_all_windows(void);
+void redecorate_all_windows(void);
+void begin_transaction(void);
+void commit_transaction(void);
+void catch_up_windows(void);
+void get_window_stack(struct window ***, int *);
 void get_client_stack(Window **, int *);
 char *decodetextproperty(XTextProperty *p);
 
@@ -0,0 +1,161 @@
+/*
+ * xcount.c - X protocol traffic accounting
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Requests are counted from sequence number deltas whenever the
+ * current subsystem changes, so counting costs nothing per request.
+ * Flushes are seen through a before-flush hook.  A round trip is
+ * assumed whenever an Xlib call returns with the server known to
+ * have processed our last request, which is what waiting for a
+ * reply or XSync() leaves behind.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+
+#include "global.h"
+#include "xcount.h"
+
+static const char *names[NXSUBSYS] = {
+	[XC_OTHER] = "other",
+	[XC_MANAGE] = "manage_window",
+	[XC_UNMANAGE] = "unmanage_window",
+	[XC_ACTIVATE] = "set_active_window",
+	[XC_MOVERESIZE] = "moveresize_window",
+	[XC_RESTACK] = "restack_all_windows",
+	[XC_PROPERTY] = "fetch_properties",
+	[XC_REPAINT] = "repaint_widgets",
+	[XC_MENU] = "show_menu",
+	[XC_ICCCM] = "icccm",
+	[XC_EWMH] = "ewmh",
+};
+
+static struct xcount counts[NXSUBSYS];
+static int current = XC_OTHER;
+
+/* NextRequest() when the subsystem last changed */
+static unsigned long lastseq;
+
+/* LastKnownRequestProcessed() after the last Xlib call */
+static unsigned long lastread;
+
+static int (*prevafter)(Display *);
+
+static void charge(void)
+{
+	unsigned long seq = NextRequest(display);
+
+	counts[current].requests += seq - lastseq;
+	lastseq = seq;
+}
+
+static int after(Display *dpy)
+{
+	unsigned long read = LastKnownRequestProcessed(dpy);
+
+	if (read != lastread && read == NextRequest(dpy) - 1)
+		counts[current].roundtrips++;
+	lastread = read;
+	return prevafter != NULL ? prevafter(dpy) : 0;
+}
+
+static void beforeflush(Display *dpy, XExtCodes *codes,
+    const char *data, long len)
+{
+	counts[current].flushes++;
+	counts[current].bytes += len;
+}
+
+void xcount_init(void)
+{
+	XExtCodes *codes;
+
+	lastseq = NextRequest(display);
+	lastread = LastKnownRequestProcessed(display);
+	prevafter = XSetAfterFunction(display, after);
+	if ((codes = XAddExtension(display)) != NULL)
+		XESetBeforeFlush(display, codes->extension, beforeflush);
+}
+
+/*
+ * Charge what follows to sub.  Returns the subsystem to go back to.
+ */
+int xcount_enter(int sub)
+{
+	int prev = current;
+
+	charge();
+	current = sub;
+	counts[sub].calls++;
+	return prev;
+}
+
+void xcount_leave(int prev)
+{
+	charge();
+	current = prev;
+}
+
+void xcount_grab(void)
+{
+	counts[current].grabs++;
+}
+
+const struct xcount *xcount_get(int sub)
+{
+	charge();
+	return &counts[sub];
+}
+
+const char *xcount_name(int sub)
+{
+	return names[sub];
+}
+
+void xcount_dump(FILE *fp)
+{
+	struct xcount *cp;
+	int i;
+
+	charge();
+	for (i = 0; i < NXSUBSYS; i++) {
+		cp = &counts[i];
+		fprintf(fp, "xcount %s calls=%lu requests=%lu flushes=%lu "
+		    "bytes=%lu roundtrips=%lu grabs=%lu\n", names[i],
+		    cp->calls, cp->requests, cp->flushes, cp->bytes,
+		    cp->roundtrips, cp->grabs);
+	}
+	fflush(fp);
+}
+
+void xcount_reset(void)
+{
+	charge();
+	memset(counts, 0, sizeof counts);
+}
@@ -0,0 +1,74 @@
+#if !defined(XCOUNT_H)
+#define XCOUNT_H
+
+/*
+ * Copyright 2006 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+
+/* Parts of karmen that X traffic is charged to */
+enum xsubsys {
+	XC_OTHER,
+	XC_MANAGE,
+	XC_UNMANAGE,
+	XC_ACTIVATE,
+	XC_MOVERESIZE,
+	XC_RESTACK,
+	XC_PROPERTY,
+	XC_REPAINT,
+	XC_MENU,
+	XC_ICCCM,
+	XC_EWMH,
+	NXSUBSYS
+};
+
+struct xcount {
+	unsigned long calls;		/* times the subsystem was entered */
+	unsigned long requests;
+	unsigned long flushes;
+	unsigned long bytes;		/* bytes flushed */
+	unsigned long roundtrips;
+	unsigned long grabs;
+};
+
+#if CONFIG_XCOUNT
+/*
+ * XC_ENTER() charges X traffic to a subsystem until the matching
+ * XC_LEAVE(), which must be in the same block.
+ */
+#define XC_ENTER(sub)	int xc_saved = xcount_enter(sub)
+#define XC_LEAVE()	xcount_leave(xc_saved)
+#else
+#define XC_ENTER(sub)	do { (void)(sub); } while (0)
+#define XC_LEAVE()	do { } while (0)
+#endif
+
+void xcount_init(void);
+int xcount_enter(int);
+void xcount_leave(int);
+void xcount_grab(void);
+const struct xcount *xcount_get(int);
+const char *xcount_name(int);
+void xcount_dump(FILE *);
+void xcount_reset(void);
+
+#endif /* !defined(XCOUNT_H) */
@@ -0,0 +1,165 @@
+/*
+ * xres.c - what the server holds for karmen and its clients
+ */
+
+/*
+ * Copyright 2006-2007 Johan Veenhuizen
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The X-Resource extension tells how many resources of each type a
+ * client holds in the server and how many bytes of pixmaps it is
+ * charged for.  Every question is a round trip, so it is only asked
+ * when somebody takes a statistics snapshot.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XRes.h>
+
+#include "global.h"
+#include "lib.h"
+#include "menu.h"
+#include "widget.h"
+#include "window.h"
+#include "xres.h"
+
+/* Most managed clients listed in one snapshot */
+#define MAXCLIENTS	32
+
+static int available = -1;
+
+static int xres_available(void)
+{
+	int evbase, errbase, major, minor;
+
+	if (available == -1) {
+		available = XResQueryExtension(display, &evbase, &errbase)
+		    && XResQueryVersion(display, &major, &minor);
+		if (!available)
+			debug("no X-Resource extension");
+	}
+	return available;
+}
+
+/*
+ * Karmen's own resources by type, as "server.window 12" and so on,
+ * named after the type's atom.
+ */
+static void puttypes(FILE *fp, XID xid)
+{
+	XResType *types;
+	Atom *atoms;
+	char **names;
+	char *p;
+	int i, n;
+
+	if (!XResQueryClientResources(display, xid, &n, &types))
+		return;
+	if (n > 0) {
+		atoms = MALLOC(n * sizeof (Atom));
+		names = MALLOC(n * sizeof (char *));
+		for (i = 0; i < n; i++) {
+			atoms[i] = types[i].resource_type;
+			names[i] = NULL;
+		}
+		XGetAtomNames(display, atoms, n, names);
+		for (i = 0; i < n; i++) {
+			if (names[i] == NULL)
+				continue;
+			for (p = names[i]; *p != '\0'; p++)
+				*p = isalnum((unsigned char)*p) ?
+				    tolower((unsigned char)*p) : '_';
+			fprintf(fp, "server.%s %u\n", names[i], types[i].count);
+			XFree(names[i]);
+		}
+		FREE(names);
+		FREE(atoms);
+	}
+	XFree(types);
+}
+
+static int totals(XID xid, unsigned long *count, unsigned long *bytes)
+{
+	XResType *types;
+	int i, n;
+
+	if (!XResQueryClientResources(display, xid, &n, &types))
+		return 0;
+	*count = 0;
+	for (i = 0; i < n; i++)
+		*count += types[i].count;
+	XFree(types);
+	return XResQueryClientPixmapBytes(display, xid, bytes);
+}
+
+/*
+ * Write what the server holds for karmen, then the totals of each
+ * client with a managed window, topmost first.  A client is matched
+ * to its windows by the range of ids it allocates from, so one with
+ * many windows is listed once, under the topmost of them.
+ */
+void xres_collect(FILE *fp)
+{
+	struct window **wins;
+	XResClient *clients;
+	XID self, seen[MAXCLIENTS];
+	unsigned long count, bytes;
+	int i, j, k, n, nclients, nseen;
+
+	if (!xres_available() || winmenu == NULL)
+		return;
+
+	/* any window we created names us */
+	self = WIDGET_XWINDOW(winmenu);
+	puttypes(fp, self);
+	if (XResQueryClientPixmapBytes(display, self, &bytes))
+		fprintf(fp, "server.pixmap_bytes %lu\n", bytes);
+
+	if (!XResQueryClients(display, &nclients, &clients))
+		return;
+	fprintf(fp, "server.clients %d\n", nclients);
+	get_window_stack(&wins, &n);
+	nseen = 0;
+	for (i = 0; i < n && nseen < MAXCLIENTS; i++) {
+		for (j = 0; j < nclients; j++)
+			if ((wins[i]->client & ~clients[j].resource_mask)
+			    == clients[j].resource_base)
+				break;
+		if (j == nclients)
+			continue;
+		for (k = 0; k < nseen; k++)
+			if (seen[k] == clients[j].resource_base)
+				break;
+		if (k < nseen)
+			continue;
+		seen[nseen++] = clients[j].resource_base;
+		if (totals(wins[i]->client, &count, &bytes)) {
+			fprintf(fp, "client.0x%lx.resources %lu\n",
+			    wins[i]->client, count);
+			fprintf(fp, "client.0x%lx.pixmap_bytes %lu\n",
+			    wins[i]->client, bytes);
+		}
+	}
+	FREE(wins);
+	XFree(clients);
+}